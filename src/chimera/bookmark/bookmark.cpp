@@ -14,6 +14,7 @@
 #include "../halo_data/script.hpp"
 #include "../halo_data/resolution.hpp"
 #include "../localization/localization.hpp"
+#include "../map_loading/map_prefetch.hpp"
 #include <mutex>
 #include <thread>
 
@@ -249,6 +250,9 @@ namespace Chimera {
 
             // = std::vector<char>(data, data + data_received);
             finished_packet.error = QueryPacketDone::Error::NONE;
+
+            // If we don't have the map, we might be able to download it before we join
+            prefetch_map(finished_packet.get_data_for_key("mapname"));
         }
         else {
             finished_packet.error = QueryPacketDone::Error::TIMED_OUT;
@@ -55,6 +55,7 @@ add_library(chimera STATIC
     src/chimera/event/rcon_message.cpp
     src/chimera/event/tick.cpp
     src/chimera/map_loading/crc32.c
+    src/chimera/map_loading/crc32_cache.cpp
     src/chimera/map_loading/fast_load.cpp
     src/chimera/map_loading/fast_load.S
     src/chimera/map_loading/laa.cpp
@@ -167,8 +168,20 @@ add_library(chimera STATIC
     src/chimera/lua/lua_variables.cpp
     src/chimera/lua/scripting.cpp
     src/chimera/map_loading/compression.cpp
+    src/chimera/map_loading/download_decompression.cpp
+    src/chimera/map_loading/map_buffer.cpp
+    src/chimera/map_loading/map_cache.cpp
+    src/chimera/map_loading/map_crc32.cpp
+    src/chimera/map_loading/map_load_timings.cpp
     src/chimera/map_loading/map_loading.cpp
     src/chimera/map_loading/map_loading.S
+    src/chimera/map_loading/map_prefetch.cpp
+    src/chimera/map_loading/mapped_file.cpp
+    src/chimera/map_loading/preload_priority.cpp
+    src/chimera/map_loading/resource_index.cpp
+    src/chimera/map_loading/resource_map_tag_data.cpp
+    src/chimera/map_loading/resource_path_index.cpp
+    src/chimera/map_loading/seekable_map.cpp
     src/chimera/master_server/master_server.cpp
     src/chimera/math_trig/math_trig.cpp
     src/chimera/miscellaneous/controller.cpp
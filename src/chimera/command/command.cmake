@@ -12,6 +12,7 @@ set(COMMAND_FILES
     ${COMMAND_DIR}/core/debug/block_damage.cpp
     ${COMMAND_DIR}/core/debug/devmode.cpp
     ${COMMAND_DIR}/core/debug/map_info.cpp
+    ${COMMAND_DIR}/core/debug/map_load_times.cpp
     ${COMMAND_DIR}/core/debug/player_info.cpp
     ${COMMAND_DIR}/core/debug/teleport.cpp
     ${COMMAND_DIR}/core/debug/tps.cpp
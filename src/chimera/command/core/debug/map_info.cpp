@@ -119,7 +119,7 @@ namespace Chimera {
             OUTPUT_WITH_COLOR("%s: %.2f MiB", localize("chimera_map_info_command_map_size"), SIZE_IN_MIB(map_size));
         }
 
-        if(get_chimera().get_ini()->get_value_bool("memory.enable_map_memory_buffer").value_or(false)) {
+        if(get_chimera().get_ini()->get_value_bool("memory.enable_map_memory_buffer").value_or(false) && loaded_map->memory_location.has_value()) {
             std::size_t buffer_used = loaded_map->loaded_size;
             std::size_t buffer_size = loaded_map->buffer_size;
             
@@ -127,6 +127,16 @@ namespace Chimera {
 
             const char *key_string = localize("chimera_map_info_command_ram_buffer");
             OUTPUT_WITH_COLOR("%s: %.2f MiB / %.2f MiB (%.2f%%)", key_string, SIZE_IN_MIB(buffer_used), SIZE_IN_MIB(buffer_size), buffer_used_percentage);
+
+            auto &map_buffer = get_map_buffer();
+            auto &statistics = map_buffer.statistics();
+            OUTPUT_WITH_COLOR("%s: %zu", localize("chimera_map_info_command_ram_buffer_maps"), map_buffer.regions().size());
+            OUTPUT_WITH_COLOR("%s: %zu / %zu", localize("chimera_map_info_command_ram_buffer_hits"), statistics.hits, statistics.misses);
+        }
+
+        if(loaded_map->seekable) {
+            auto statistics = loaded_map->seekable->statistics();
+            OUTPUT_WITH_COLOR("%s: %zu / %zu", localize("chimera_map_info_command_seekable_frames"), statistics.frames_decompressed, statistics.frame_cache_hits);
         }
 
         OUTPUT_WITH_COLOR("%s: %d / %d", localize("chimera_map_info_command_map_tag_count"), tag_count, MAX_TAG_COUNT);
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <string>
+#include "../../../map_loading/map_load_timings.hpp"
+#include "../../../localization/localization.hpp"
+#include "../../../output/output.hpp"
+
+namespace Chimera {
+    bool map_load_times_command(int argc, const char **argv) {
+        auto &history = get_map_load_timings_history();
+
+        // Export it if a path was given
+        if(argc) {
+            if(!write_map_load_timings_csv(*argv, history, false)) {
+                console_error(localize("chimera_map_load_times_command_export_failed"), *argv);
+                return false;
+            }
+            console_output(localize("chimera_map_load_times_command_exported"), history.size(), *argv);
+            return true;
+        }
+
+        if(history.empty()) {
+            console_output(localize("chimera_map_load_times_command_no_loads"));
+            return true;
+        }
+
+        auto header_color = ConsoleColor::header_color();
+        auto body_color = ConsoleColor::body_color();
+        console_output(header_color, "%s", localize("chimera_map_load_times_command_recent_loads"));
+
+        for(auto &i : history) {
+            std::string stages;
+            for(std::size_t s = 0; s < MAP_LOAD_STAGE_COUNT; s++) {
+                char stage[64];
+                std::snprintf(stage, sizeof(stage), "%s%s %.0f", s ? ", " : "", map_load_stage_name(static_cast<MapLoadStage>(s)), i.milliseconds[s]);
+                stages += stage;
+            }
+            console_output(body_color, "%s (%s): %.0f ms (%s)", i.map_name.c_str(), i.source.c_str(), i.total_milliseconds(), stages.c_str());
+        }
+
+        return true;
+    }
+}
@@ -34,6 +34,7 @@ namespace Chimera {
     struct MapHeader {
         static const std::uint32_t HEAD_LITERAL = 0x68656164;
         static const std::uint32_t FOOT_LITERAL = 0x666F6F74;
+        static const std::uint32_t COMPRESSION_DICTIONARY_LITERAL = 0x64696374;
 
         /** Must be equal to 0x68656164 */
         std::uint32_t head;
@@ -68,7 +69,13 @@ namespace Chimera {
         /** Calculated with CRC32 of BSPs, models, and tag data */
         std::uint32_t crc32;
 
-        PAD(0x2B0);
+        /** ID of the zstd dictionary a compressed map was compressed with; only set if compression_dictionary_literal is set. Unused by Halo */
+        std::uint32_t compression_dictionary;
+
+        /** Equal to 0x64696374 if compression_dictionary is set; this was padding, so maps made by other tools can have anything here */
+        std::uint32_t compression_dictionary_literal;
+
+        PAD(0x2A8);
 
         PAD(0x4E4);
 
@@ -76,6 +83,14 @@ namespace Chimera {
         std::uint32_t foot;
         
         bool is_valid() const noexcept;
+
+        /**
+         * Get the zstd dictionary a compressed map was compressed with
+         * @return ID of the dictionary, or 0 if none
+         */
+        std::uint32_t get_compression_dictionary() const noexcept {
+            return this->compression_dictionary_literal == COMPRESSION_DICTIONARY_LITERAL ? this->compression_dictionary : 0;
+        }
     };
     static_assert(sizeof(MapHeader) == 0x800);
 
@@ -144,7 +159,8 @@ namespace Chimera {
         /** Map name index; 13 = Unknown Level, first 13 maps must be the stock maps in order */
         std::uint32_t map_name_index;
     };
-    static_assert(sizeof(MapIndex) == 0x8);
+    // Halo's pointers are 32-bit, but the map headers above are also used by the map toolkit, which can be built natively
+    static_assert(sizeof(void *) != 4 || sizeof(MapIndex) == 0x8);
 
     struct MapIndexRetail : MapIndex {
         /** 1 if loaded and valid */
@@ -152,14 +168,14 @@ namespace Chimera {
 
         PAD(0x3);
     };
-    static_assert(sizeof(MapIndexRetail) == 0xC);
+    static_assert(sizeof(void *) != 4 || sizeof(MapIndexRetail) == 0xC);
 
     /** This is an individual map index */
     struct MapIndexCustomEdition : MapIndexRetail {
         /** CRC32 checksum for joining/hosting servers */
         std::uint32_t crc32;
     };
-    static_assert(sizeof(MapIndexCustomEdition) == 0x10);
+    static_assert(sizeof(void *) != 4 || sizeof(MapIndexCustomEdition) == 0x10);
 
     struct MapList {
         MapIndex *map_list;
@@ -4,13 +4,102 @@
 #include <cstdio>
 #include <filesystem>
 #include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <zstd.h>
+#include <zstd_errors.h>
 
 #include "../halo_data/map.hpp"
 #include "compression.hpp"
+#include "crc32.hpp"
+#include "map_crc32.hpp"
+#include "seekable_map.hpp"
 
 namespace Chimera {
-    static void decompress_header(const std::byte *header_input, std::byte *header_output) {
+    struct MapCompressionDictionary {
+        std::vector<std::byte> data;
+        std::unique_ptr<ZSTD_DDict, std::size_t (*)(ZSTD_DDict *)> ddict = { nullptr, ZSTD_freeDDict };
+    };
+
+    static std::mutex dictionaries_mutex;
+    static std::map<std::uint32_t, std::shared_ptr<const MapCompressionDictionary>> dictionaries;
+
+    static std::shared_ptr<const MapCompressionDictionary> find_dictionary(std::uint32_t id) {
+        std::scoped_lock<std::mutex> lock(dictionaries_mutex);
+        auto dictionary = dictionaries.find(id);
+        if(dictionary == dictionaries.end()) {
+            return nullptr;
+        }
+        return dictionary->second;
+    }
+
+    std::uint32_t add_map_compression_dictionary(const std::byte *data, std::size_t size) {
+        std::uint32_t id = ZSTD_getDictID_fromDict(data, size);
+        if(id == 0) {
+            return 0;
+        }
+
+        // Digest it now so every map that uses it can skip that
+        auto dictionary = std::make_shared<MapCompressionDictionary>();
+        dictionary->data.assign(data, data + size);
+        dictionary->ddict.reset(ZSTD_createDDict(dictionary->data.data(), dictionary->data.size()));
+        if(!dictionary->ddict) {
+            return 0;
+        }
+
+        std::scoped_lock<std::mutex> lock(dictionaries_mutex);
+        dictionaries[id] = std::move(dictionary);
+        return id;
+    }
+
+    std::uint32_t load_map_compression_dictionary(const std::filesystem::path &path) {
+        std::error_code ec;
+        auto size = std::filesystem::file_size(path, ec);
+        std::FILE *f = ec ? nullptr : std::fopen(path.string().c_str(), "rb");
+        if(!f) {
+            return 0;
+        }
+        std::vector<std::byte> data(size);
+        bool read = std::fread(data.data(), data.size(), 1, f) == 1;
+        std::fclose(f);
+        return read ? add_map_compression_dictionary(data.data(), data.size()) : 0;
+    }
+
+    std::size_t load_map_compression_dictionaries(const std::filesystem::path &directory) noexcept {
+        std::size_t count = 0;
+        std::error_code ec;
+        for(auto &entry : std::filesystem::directory_iterator(directory, ec)) {
+            try {
+                if(entry.is_regular_file() && entry.path().extension() == ".dict" && load_map_compression_dictionary(entry.path()) != 0) {
+                    count++;
+                }
+            }
+            catch (std::exception &) {
+                continue;
+            }
+        }
+        return count;
+    }
+
+    bool has_map_compression_dictionary(std::uint32_t id) noexcept {
+        std::scoped_lock<std::mutex> lock(dictionaries_mutex);
+        return id == 0 || dictionaries.find(id) != dictionaries.end();
+    }
+
+    std::size_t decompress_map_frame(ZSTD_DCtx *context, std::uint32_t dictionary_id, std::byte *output, std::size_t output_size, const std::byte *input, std::size_t input_size) noexcept {
+        std::shared_ptr<const MapCompressionDictionary> dictionary;
+        if(dictionary_id != 0 && !(dictionary = find_dictionary(dictionary_id))) {
+            return 0;
+        }
+        auto result = dictionary ? ZSTD_decompress_usingDDict(context, output, output_size, input, input_size, dictionary->ddict.get()) : ZSTD_decompressDCtx(context, output, output_size, input, input_size);
+        return ZSTD_isError(result) ? 0 : result;
+    }
+
+    CacheFileEngine decompress_map_header(const std::byte *header_input, std::byte *header_output) {
         // Check to see if we can't even fit the header
         auto header_copy = *reinterpret_cast<const MapHeader *>(header_input);
 
@@ -46,6 +135,8 @@ namespace Chimera {
         // Set the file size to either the original decompressed size or 0 (if needed) and the engine to the new thing
         header_copy.file_size = stores_uncompressed_size ? header_copy.file_size : 0;
         header_copy.engine_type = new_engine_version;
+        header_copy.compression_dictionary = 0;
+        header_copy.compression_dictionary_literal = 0;
 
         // if demo, convert the header, otherwise copy the header
         if(new_engine_version == CacheFileEngine::CACHE_FILE_DEMO) {
@@ -64,10 +155,216 @@ namespace Chimera {
         else {
             *reinterpret_cast<MapHeader *>(header_output) = header_copy;
         }
+
+        return new_engine_version;
+    }
+
+    static void compress_header(const std::byte *header_input, std::byte *header_output, std::size_t decompressed_size, std::uint32_t dictionary_id) {
+        auto &demo_header = *reinterpret_cast<const MapHeaderDemo *>(header_input);
+        auto header_copy = *reinterpret_cast<const MapHeader *>(header_input);
+
+        // Demo maps have their header shuffled around, so put it back into the normal layout first
+        if(demo_header.head == MapHeaderDemo::HEAD_LITERAL && demo_header.foot == MapHeaderDemo::FOOT_LITERAL && demo_header.engine_type == CacheFileEngine::CACHE_FILE_DEMO) {
+            header_copy = {};
+            header_copy.head = MapHeader::HEAD_LITERAL;
+            header_copy.foot = MapHeader::FOOT_LITERAL;
+            std::memcpy(header_copy.name, demo_header.name, sizeof(header_copy.name));
+            std::memcpy(header_copy.build, demo_header.build, sizeof(header_copy.build));
+            header_copy.engine_type = CacheFileEngine::CACHE_FILE_DEMO_COMPRESSED;
+            header_copy.tag_data_offset = demo_header.tag_data_offset;
+            header_copy.tag_data_size = demo_header.tag_data_size;
+            header_copy.game_type = demo_header.game_type;
+            header_copy.crc32 = demo_header.crc32;
+        }
+        else if(header_copy.head == MapHeader::HEAD_LITERAL && header_copy.foot == MapHeader::FOOT_LITERAL) {
+            switch(header_copy.engine_type) {
+                case CacheFileEngine::CACHE_FILE_CUSTOM_EDITION:
+                    header_copy.engine_type = CacheFileEngine::CACHE_FILE_CUSTOM_EDITION_COMPRESSED;
+                    break;
+                case CacheFileEngine::CACHE_FILE_RETAIL:
+                    header_copy.engine_type = CacheFileEngine::CACHE_FILE_RETAIL_COMPRESSED;
+                    break;
+                default:
+                    throw std::exception();
+            }
+        }
+        else {
+            throw std::exception();
+        }
+
+        // Compressed maps store the decompressed size so the loader knows how much space to reserve
+        header_copy.file_size = decompressed_size;
+        header_copy.compression_dictionary = dictionary_id;
+        header_copy.compression_dictionary_literal = dictionary_id != 0 ? MapHeader::COMPRESSION_DICTIONARY_LITERAL : 0;
+        *reinterpret_cast<MapHeader *>(header_output) = header_copy;
     }
 
     constexpr std::size_t HEADER_SIZE = sizeof(MapHeader);
 
+    // Most of a multi-frame map to read at once before decompressing it (more is read if a single frame is bigger than this)
+    static constexpr std::size_t MULTI_FRAME_BATCH_SIZE = 16 * 1024 * 1024;
+
+    /**
+     * Run the job for every index from 0 to job_count on a pool of threads
+     * @param job_count   number of jobs
+     * @param threads     number of threads to use (0 = use all hardware threads)
+     * @param make_worker function that returns the job function for each thread; job functions return false on failure
+     * @return            true if every job succeeded
+     */
+    template <typename MakeWorker> static bool run_jobs(std::size_t job_count, std::size_t threads, const MakeWorker &make_worker) {
+        if(threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        threads = std::clamp<std::size_t>(threads, 1, std::max<std::size_t>(job_count, 1));
+
+        std::atomic<std::size_t> next_job {0};
+        std::atomic<bool> failed {false};
+        auto thread_function = [&next_job, &failed, &job_count, &make_worker]() {
+            auto job = make_worker();
+            while(!failed) {
+                std::size_t j = next_job++;
+                if(j >= job_count) {
+                    break;
+                }
+                if(!job(j)) {
+                    failed = true;
+                }
+            }
+        };
+
+        // Use this thread as one of the workers
+        std::vector<std::thread> pool;
+        for(std::size_t t = 1; t < threads; t++) {
+            pool.emplace_back(thread_function);
+        }
+        thread_function();
+        for(auto &t : pool) {
+            t.join();
+        }
+
+        return !failed;
+    }
+
+    /**
+     * CRC32s of the decompressed map, gathered as it is written so regions can be checksummed afterwards without reading them back
+     */
+    class DecompressedMapCRC32 {
+    public:
+        /** Writes are split into blocks aligned to this; only the parts of blocks that straddle a region's start or end need to be read back */
+        static constexpr std::size_t BLOCK_SIZE = 16 * 1024;
+
+        /** Engine of the decompressed map */
+        CacheFileEngine engine = CacheFileEngine::CACHE_FILE_CUSTOM_EDITION;
+
+        /**
+         * Set where the tag data is so it can be kept as it is written; this must be done before anything is added
+         * @param offset offset of the tag data
+         * @param size   size of the tag data
+         */
+        void set_tag_data_location(std::size_t offset, std::size_t size) {
+            this->tag_data_offset = offset;
+            this->tag_data.resize(size);
+        }
+
+        /**
+         * Add decompressed data; this is thread-safe as long as writes don't overlap
+         * @param data   decompressed data
+         * @param offset offset of the data in the decompressed map
+         * @param size   size of the data
+         */
+        void add(const std::byte *data, std::size_t offset, std::size_t size) {
+            // Keep any tag data
+            std::size_t copy_start = std::max(offset, this->tag_data_offset);
+            std::size_t copy_end = std::min(offset + size, this->tag_data_offset + this->tag_data.size());
+            if(copy_start < copy_end) {
+                std::copy(data + (copy_start - offset), data + (copy_end - offset), this->tag_data.data() + (copy_start - this->tag_data_offset));
+            }
+
+            std::vector<Block> new_blocks;
+            for(std::size_t position = offset, end = offset + size; position < end;) {
+                std::size_t block_end = std::min((position / BLOCK_SIZE + 1) * BLOCK_SIZE, end);
+                new_blocks.push_back(Block { position, block_end - position, crc32(0, data + (position - offset), block_end - position) });
+                position = block_end;
+            }
+
+            std::scoped_lock<std::mutex> lock(this->mutex);
+            this->blocks.insert(this->blocks.end(), new_blocks.begin(), new_blocks.end());
+            if(copy_start < copy_end) {
+                this->tag_data_copied += copy_end - copy_start;
+            }
+        }
+
+        /**
+         * Calculate the CRC32 of the map once everything has been added
+         * @param read_back function that reads size bytes at offset of the decompressed map into output, returning true if successful
+         * @return          CRC32 of the map (inverted, as it is stored in the map list), or nothing if it couldn't be calculated
+         */
+        template <typename ReadBack> std::optional<std::uint32_t> map_crc32(const ReadBack &read_back) {
+            std::sort(this->blocks.begin(), this->blocks.end(), [](const Block &a, const Block &b) { return a.offset < b.offset; });
+
+            // Without all of the tag data, we can't find anything else
+            if(this->tag_data.empty() || this->tag_data_copied != this->tag_data.size()) {
+                return std::nullopt;
+            }
+
+            auto crc = calculate_map_crc32(this->tag_data.data(), this->tag_data.size(), this->tag_data_offset, tag_data_address_for_engine(this->engine), [this, &read_back](std::uint32_t &crc, std::size_t offset, std::size_t size) -> bool {
+                return this->region_crc32(crc, offset, size, read_back);
+            });
+            if(!crc.has_value()) {
+                return std::nullopt;
+            }
+            return ~*crc;
+        }
+
+    private:
+        struct Block {
+            std::size_t offset;
+            std::size_t size;
+            std::uint32_t crc;
+        };
+
+        std::vector<Block> blocks;
+        std::mutex mutex;
+        std::size_t tag_data_offset = 0;
+        std::size_t tag_data_copied = 0;
+        std::vector<std::byte> tag_data;
+
+        template <typename ReadBack> bool region_crc32(std::uint32_t &crc, std::size_t offset, std::size_t size, const ReadBack &read_back) const {
+            std::size_t end = offset + size;
+            if(end < offset) {
+                return false;
+            }
+
+            // Start at the first block that ends after the region starts
+            auto block = std::upper_bound(this->blocks.begin(), this->blocks.end(), offset, [](std::size_t start, const Block &block) { return start < block.offset + block.size; });
+            std::vector<std::byte> partial;
+            for(std::size_t position = offset; position < end; block++) {
+                // If there's a gap, then this part of the map was never written
+                if(block == this->blocks.end() || block->offset > position) {
+                    return false;
+                }
+
+                // Whole blocks can be combined; the rest has to be read back
+                std::size_t block_end = block->offset + block->size;
+                if(block->offset == position && block_end <= end) {
+                    crc = crc32_combine(crc, block->crc, block->size);
+                    position = block_end;
+                }
+                else {
+                    std::size_t partial_end = std::min(block_end, end);
+                    partial.resize(partial_end - position);
+                    if(!read_back(position, partial.size(), partial.data())) {
+                        return false;
+                    }
+                    crc = crc32(crc, partial.data(), partial.size());
+                    position = partial_end;
+                }
+            }
+
+            return true;
+        }
+    };
+
     struct LowMemoryDecompression {
         /**
          * Callback for when a decompression occurs
@@ -78,6 +375,28 @@ namespace Chimera {
          */
         bool (*write_callback)(const std::byte *decompressed_data, std::size_t size, void *user_data) = nullptr;
 
+        /**
+         * Callback for writing a frame when decompressing multi-frame maps; this is called from multiple threads at once
+         * @param decompressed_data decompressed data to write
+         * @param offset            offset in the decompressed map to write to
+         * @param size              size of decompressed data
+         * @param user_data         user data to pass
+         * @return                  true if successful
+         */
+        bool (*write_at_callback)(const std::byte *decompressed_data, std::size_t offset, std::size_t size, void *user_data) = nullptr;
+
+        /** If set, frames of multi-frame maps are decompressed directly into here rather than passed to write_at_callback */
+        std::byte *direct_output = nullptr;
+
+        /** Size of direct_output */
+        std::size_t direct_output_size = 0;
+
+        /** Number of threads to use for multi-frame maps (0 = use all hardware threads) */
+        std::size_t thread_count = 0;
+
+        /** If set, everything written is checksummed as it goes */
+        DecompressedMapCRC32 *checksum = nullptr;
+
         /**
          * Decompress the map file
          * @param path path to the map file
@@ -89,140 +408,358 @@ namespace Chimera {
                 throw std::exception();
             }
 
-            // Get the size
-            std::size_t total_size = std::filesystem::file_size(input);
+            try {
+                this->decompress_map_file(input_file, std::filesystem::file_size(input), user_data);
+            }
+            catch (std::exception &) {
+                if(input_file) {
+                    std::fclose(input_file);
+                }
+                throw;
+            }
+        }
 
-            // Read the input file header
-            MapHeader header_input;
-            if(std::fread(&header_input, sizeof(header_input), 1, input_file) != 1) {
-                std::fclose(input_file);
+        /**
+         * Decompress the map as it's read in order, such as while it's downloaded; this is always done one frame at a time
+         * @param read_data       function that reads the next size bytes of the compressed map into where, throwing an exception if it can't
+         * @param compressed_size size of the compressed map
+         */
+        template <typename ReadData> void decompress_map_stream(ReadData &read_data, std::size_t compressed_size, void *user_data) {
+            if(compressed_size < HEADER_SIZE) {
                 throw std::exception();
             }
+            MapHeader header_input;
+            read_data(reinterpret_cast<std::byte *>(&header_input), sizeof(header_input));
+            auto dictionary = this->write_header(header_input, user_data);
+            this->decompress_stream(read_data, compressed_size - HEADER_SIZE, dictionary.get(), user_data);
+        }
 
+    private:
+        struct Frame {
+            const std::byte *data;
+            std::size_t compressed_size;
+            std::size_t offset;
+            std::size_t size;
+        };
+
+        /**
+         * Decompress the header and write it
+         * @param header_input compressed map header
+         * @return             dictionary the map was compressed with, if any
+         */
+        std::shared_ptr<const MapCompressionDictionary> write_header(const MapHeader &header_input, void *user_data) {
             // Make the output header and write it
             std::byte header_output[HEADER_SIZE];
-            try {
-                decompress_header(reinterpret_cast<std::byte *>(&header_input), header_output);
-            }
-            catch (std::exception &) {
-                std::fclose(input_file);
-                throw;
+            auto engine = decompress_map_header(reinterpret_cast<const std::byte *>(&header_input), header_output);
+
+            // Maps compressed with a dictionary can't be decompressed without it
+            std::shared_ptr<const MapCompressionDictionary> dictionary;
+            auto dictionary_id = header_input.get_compression_dictionary();
+            if(dictionary_id != 0 && !(dictionary = find_dictionary(dictionary_id))) {
+                throw std::exception();
             }
 
-            // Write the header
+            if(this->checksum) {
+                this->checksum->engine = engine;
+                this->checksum->set_tag_data_location(header_input.tag_data_offset, header_input.tag_data_size);
+                this->checksum->add(header_output, 0, sizeof(header_output));
+            }
             if(!write_callback(header_output, sizeof(header_output), user_data)) {
-                std::fclose(input_file);
                 throw std::exception();
             }
 
-            // Allocate and init a stream
-            auto decompression_stream = ZSTD_createDStream();
-            const std::size_t init = ZSTD_initDStream(decompression_stream);
+            return dictionary;
+        }
 
-            std::size_t total_read = HEADER_SIZE;
-            auto read_data = [&input_file, &decompression_stream, &total_read](std::byte *where, std::size_t size) {
-                if(std::fread(where, size, 1, input_file) != 1) {
-                    std::fclose(input_file);
-                    ZSTD_freeDStream(decompression_stream);
+        void decompress_map_file(std::FILE *&input_file, std::size_t total_size, void *user_data) {
+            // Read the input file header
+            MapHeader header_input;
+            if(std::fread(&header_input, sizeof(header_input), 1, input_file) != 1) {
+                throw std::exception();
+            }
+            auto dictionary = this->write_header(header_input, user_data);
+
+            std::size_t compressed_size = total_size - HEADER_SIZE;
+
+            // Peek at the first frame. If it doesn't hold the whole map, then the map was split into independent frames we can decompress at once.
+            std::byte peek[32];
+            std::size_t peek_size = std::min(sizeof(peek), compressed_size);
+            if(std::fread(peek, peek_size, 1, input_file) != 1 || std::fseek(input_file, HEADER_SIZE, SEEK_SET) != 0) {
+                throw std::exception();
+            }
+            auto first_frame_size = ZSTD_getFrameContentSize(peek, peek_size);
+            bool multi_frame = first_frame_size != ZSTD_CONTENTSIZE_UNKNOWN && first_frame_size != ZSTD_CONTENTSIZE_ERROR && HEADER_SIZE + first_frame_size < header_input.file_size;
+
+            if(!multi_frame || (!this->write_at_callback && !this->direct_output)) {
+                auto read_data = [&input_file](std::byte *where, std::size_t size) {
+                    if(std::fread(where, size, 1, input_file) != 1) {
+                        throw std::exception();
+                    }
+                };
+                this->decompress_stream(read_data, compressed_size, dictionary.get(), user_data);
+                std::fclose(input_file);
+                input_file = nullptr;
+                return;
+            }
+
+            // Read whole frames a batch at a time and decompress each batch at once, so only a bounded amount of the compressed map is in
+            // memory; this is a 32-bit process, and the map buffer may already have most of the address space reserved
+            std::vector<std::byte> batch(std::min(compressed_size, MULTI_FRAME_BATCH_SIZE));
+            std::size_t batch_used = 0;
+            std::size_t remaining = compressed_size;
+            std::size_t output_offset = HEADER_SIZE;
+            bool started = false;
+            while(remaining > 0 || batch_used > 0) {
+                std::size_t read_size = std::min(batch.size() - batch_used, remaining);
+                if(read_size > 0 && std::fread(batch.data() + batch_used, read_size, 1, input_file) != 1) {
                     throw std::exception();
                 }
-                total_read += size;
-            };
+                batch_used += read_size;
+                remaining -= read_size;
 
-            auto &write_callback = this->write_callback;
-            auto write_data = [&input_file, &write_callback, &decompression_stream, &user_data](const std::byte *where, std::size_t size) {
-                if(!write_callback(where, size, user_data)) {
-                    std::fclose(input_file);
-                    ZSTD_freeDStream(decompression_stream);
-                    throw std::exception();
+                // Find where each whole frame in the batch is and where it goes
+                std::vector<Frame> frames;
+                std::size_t position = 0;
+                while(position < batch_used) {
+                    auto *frame_data = batch.data() + position;
+                    std::size_t frame_compressed_size = ZSTD_findFrameCompressedSize(frame_data, batch_used - position);
+                    if(ZSTD_isError(frame_compressed_size)) {
+                        // The rest of this frame is in the next batch
+                        if(ZSTD_getErrorCode(frame_compressed_size) == ZSTD_error_srcSize_wrong && remaining > 0) {
+                            break;
+                        }
+                        throw std::exception();
+                    }
+
+                    // Skippable frames report a size of 0, so they're skipped here, too
+                    auto frame_size = ZSTD_getFrameContentSize(frame_data, batch_used - position);
+                    if(frame_size == ZSTD_CONTENTSIZE_UNKNOWN || frame_size == ZSTD_CONTENTSIZE_ERROR) {
+                        // If we don't know where everything goes, we have to do it one at a time, which we can only do from the start
+                        if(started) {
+                            throw std::exception();
+                        }
+                        if(std::fseek(input_file, HEADER_SIZE, SEEK_SET) != 0) {
+                            throw std::exception();
+                        }
+                        auto read_data = [&input_file](std::byte *where, std::size_t size) {
+                            if(std::fread(where, size, 1, input_file) != 1) {
+                                throw std::exception();
+                            }
+                        };
+                        this->decompress_stream(read_data, compressed_size, dictionary.get(), user_data);
+                        std::fclose(input_file);
+                        input_file = nullptr;
+                        return;
+                    }
+                    if(this->direct_output && (frame_size > this->direct_output_size || output_offset > this->direct_output_size - frame_size)) {
+                        throw std::exception();
+                    }
+                    if(frame_size > 0) {
+                        frames.push_back(Frame { frame_data, frame_compressed_size, output_offset, static_cast<std::size_t>(frame_size) });
+                    }
+
+                    output_offset += frame_size;
+                    position += frame_compressed_size;
                 }
-            };
 
-            while(total_read < total_size) {
-                // Make some input/output data thingy
-                std::vector<std::byte> input_data(init);
-                std::vector<std::byte> output_data(ZSTD_DStreamOutSize());
+                // If not even one frame fits, make room for it
+                if(position == 0) {
+                    batch.resize(std::min(batch.size() * 2, batch.size() + remaining));
+                    continue;
+                }
+
+                this->decompress_frames(frames, dictionary.get(), user_data);
+                started = true;
+
+                // Keep the start of the next frame for the next batch
+                std::copy(batch.data() + position, batch.data() + batch_used, batch.data());
+                batch_used -= position;
+            }
+            std::fclose(input_file);
+            input_file = nullptr;
 
-                // Read the first bit
-                read_data(input_data.data(), input_data.size());
+            // Let the writer know how far we got
+            if(this->direct_output && !this->write_at_callback(nullptr, output_offset, 0, user_data)) {
+                throw std::exception();
+            }
+        }
 
-                for(;;) {
-                    ZSTD_inBuffer_s input_buffer = {};
+        void decompress_frames(const std::vector<Frame> &frames, const MapCompressionDictionary *dictionary, void *user_data) {
+            auto &write_at_callback = this->write_at_callback;
+            auto *direct_output = this->direct_output;
+            auto *checksum = this->checksum;
+            auto *ddict = dictionary ? dictionary->ddict.get() : nullptr;
+            bool success = run_jobs(frames.size(), this->thread_count, [&frames, &write_at_callback, &direct_output, &checksum, &ddict, &user_data]() {
+                return [&frames, &write_at_callback, &direct_output, &checksum, &ddict, &user_data, context = std::shared_ptr<ZSTD_DCtx>(ZSTD_createDCtx(), ZSTD_freeDCtx), frame_buffer = std::vector<std::byte>()](std::size_t f) mutable -> bool {
+                    auto &frame = frames[f];
+
+                    // Decompress straight into the output if we can
+                    std::byte *output = direct_output ? direct_output + frame.offset : nullptr;
+                    if(!output) {
+                        frame_buffer.resize(frame.size);
+                        output = frame_buffer.data();
+                    }
+
+                    auto result = ddict ? ZSTD_decompress_usingDDict(context.get(), output, frame.size, frame.data, frame.compressed_size, ddict) : ZSTD_decompressDCtx(context.get(), output, frame.size, frame.data, frame.compressed_size);
+                    if(ZSTD_isError(result) || result != frame.size) {
+                        return false;
+                    }
+
+                    // Checksum it while it's still in the cache
+                    if(checksum) {
+                        checksum->add(output, frame.offset, frame.size);
+                    }
+
+                    return direct_output || write_at_callback(output, frame.offset, frame.size, user_data);
+                };
+            });
+
+            if(!success) {
+                throw std::exception();
+            }
+        }
+
+        template <typename ReadData> void decompress_stream(ReadData &read_data, std::size_t compressed_size, const MapCompressionDictionary *dictionary, void *user_data) {
+            // Allocate and init a stream
+            std::unique_ptr<ZSTD_DStream, std::size_t (*)(ZSTD_DStream *)> decompression_stream(ZSTD_createDStream(), ZSTD_freeDStream);
+            ZSTD_initDStream(decompression_stream.get());
+            if(dictionary && ZSTD_isError(ZSTD_DCtx_refDDict(decompression_stream.get(), dictionary->ddict.get()))) {
+                throw std::exception();
+            }
+
+            // Read in large chunks rather than whatever the decompressor hints at so we aren't doing a ton of tiny reads
+            std::vector<std::byte> input_data(ZSTD_DStreamInSize());
+            std::vector<std::byte> output_data(ZSTD_DStreamOutSize());
+            std::size_t last_result = 0;
+            std::size_t output_position = HEADER_SIZE;
+
+            for(std::size_t remaining = compressed_size; remaining > 0;) {
+                std::size_t read_size = std::min(input_data.size(), remaining);
+                read_data(input_data.data(), read_size);
+                remaining -= read_size;
+
+                ZSTD_inBuffer_s input_buffer = {};
+                input_buffer.src = input_data.data();
+                input_buffer.size = read_size;
+
+                // zstd won't consume the last byte of a frame until all of its data is flushed, so we're done when the input is used up
+                while(input_buffer.pos < input_buffer.size) {
                     ZSTD_outBuffer_s output_buffer = {};
-                    input_buffer.src = input_data.data();
-                    input_buffer.size = input_data.size();
                     output_buffer.dst = output_data.data();
                     output_buffer.size = output_data.size();
 
-                    // Get the output
-                    std::size_t q = ZSTD_decompressStream(decompression_stream, &output_buffer, &input_buffer);
-                    if(ZSTD_isError(q)) {
-                        std::fclose(input_file);
-                        ZSTD_freeDStream(decompression_stream);
+                    last_result = ZSTD_decompressStream(decompression_stream.get(), &output_buffer, &input_buffer);
+                    if(ZSTD_isError(last_result)) {
                         throw std::exception();
                     }
 
-                    // Write it
-                    if(output_buffer.pos) {
-                        write_data(reinterpret_cast<std::byte *>(output_buffer.dst), output_buffer.pos);
+                    if(output_buffer.pos == 0) {
+                        continue;
                     }
 
-                    // If it's > 0, we need more data
-                    if(q > 0) {
-                        input_data.clear();
-                        input_data.insert(input_data.end(), q, std::byte());
-                        read_data(input_data.data(), q);
+                    if(this->checksum) {
+                        this->checksum->add(output_data.data(), output_position, output_buffer.pos);
                     }
-                    else {
-                        break;
+                    output_position += output_buffer.pos;
+
+                    // Write it
+                    if(!write_callback(output_data.data(), output_buffer.pos, user_data)) {
+                        throw std::exception();
                     }
                 }
             }
 
-            // Close the stream and the files
-            std::fclose(input_file);
-            ZSTD_freeDStream(decompression_stream);
+            // If the decompressor still wants data, the map was truncated
+            if(last_result != 0) {
+                throw std::exception();
+            }
         }
     };
 
-    std::size_t decompress_map_file(const char *input, const char *output) {
+    /**
+     * Decompress a map into a file
+     * @param output     path to write the decompressed map to
+     * @param threads    number of threads to use for multi-frame maps (0 = use all hardware threads)
+     * @param map_crc32  if set, the map's CRC32 is calculated while decompressing and stored here
+     * @param decompress function that decompresses the map with the LowMemoryDecompression and user data it's given
+     * @return           size of the decompressed map
+     */
+    template <typename Decompress> static std::size_t decompress_map_to_file(const char *output, std::size_t threads, std::optional<std::uint32_t> *map_crc32, const Decompress &decompress) {
         struct OutputWriter {
             std::FILE *output_file;
             std::size_t output_position = 0;
-        } output_writer = { std::fopen(output, "wb") };
+            std::mutex mutex = {};
+        } output_writer = { std::fopen(output, map_crc32 ? "w+b" : "wb") };
  
         if(!output_writer.output_file) {
-            std::fclose(output_writer.output_file);
             throw std::exception();
         }
  
+        DecompressedMapCRC32 checksum;
         LowMemoryDecompression decomp;
+        decomp.thread_count = threads;
+        decomp.checksum = map_crc32 ? &checksum : nullptr;
         decomp.write_callback = [](const std::byte *decompressed_data, std::size_t size, void *user_data) -> bool {
             auto &output_writer = *reinterpret_cast<OutputWriter *>(user_data);
             output_writer.output_position += size;
             return std::fwrite(decompressed_data, size, 1, reinterpret_cast<std::FILE *>(output_writer.output_file));
         };
+        decomp.write_at_callback = [](const std::byte *decompressed_data, std::size_t offset, std::size_t size, void *user_data) -> bool {
+            auto &output_writer = *reinterpret_cast<OutputWriter *>(user_data);
+            std::scoped_lock<std::mutex> lock(output_writer.mutex);
+            output_writer.output_position = std::max(output_writer.output_position, offset + size);
+            return std::fseek(output_writer.output_file, offset, SEEK_SET) == 0 && std::fwrite(decompressed_data, size, 1, output_writer.output_file);
+        };
  
         try {
-            decomp.decompress_map_file(input, &output_writer);
+            decompress(decomp, &output_writer);
         }
         catch (std::exception &e) {
             std::fclose(output_writer.output_file);
             throw;
         }
+
+        // Only the edges of each region are read back
+        if(map_crc32) {
+            *map_crc32 = checksum.map_crc32([&output_writer](std::size_t offset, std::size_t size, std::byte *output) -> bool {
+                return std::fseek(output_writer.output_file, offset, SEEK_SET) == 0 && std::fread(output, size, 1, output_writer.output_file) == 1;
+            });
+        }
         std::fclose(output_writer.output_file);
  
         return output_writer.output_position;
     }
 
-    std::size_t decompress_map_file(const char *input, std::byte *output, std::size_t output_size) {
+    std::size_t decompress_map_file(const char *input, const char *output, std::size_t threads, std::optional<std::uint32_t> *map_crc32) {
+        return decompress_map_to_file(output, threads, map_crc32, [&input](LowMemoryDecompression &decomp, void *user_data) {
+            decomp.decompress_map_file(input, user_data);
+        });
+    }
+
+    std::size_t decompress_map_stream(const std::function<bool (std::byte *output, std::size_t size)> &read, std::size_t compressed_size, const char *output, std::optional<std::uint32_t> *map_crc32) {
+        auto read_data = [&read](std::byte *where, std::size_t size) {
+            if(!read(where, size)) {
+                throw std::exception();
+            }
+        };
+        return decompress_map_to_file(output, 1, map_crc32, [&read_data, &compressed_size](LowMemoryDecompression &decomp, void *user_data) {
+            decomp.decompress_map_stream(read_data, compressed_size, user_data);
+        });
+    }
+
+    std::size_t decompress_map_file(const char *input, std::byte *output, std::size_t output_size, std::size_t threads, std::optional<std::uint32_t> *map_crc32) {
         struct OutputWriter {
             std::byte *output;
             std::size_t output_size;
             std::size_t output_position = 0;
         } output_writer = { output, output_size };
  
+        DecompressedMapCRC32 checksum;
         LowMemoryDecompression decomp;
+        decomp.thread_count = threads;
+        decomp.checksum = map_crc32 ? &checksum : nullptr;
+        decomp.direct_output = output;
+        decomp.direct_output_size = output_size;
         decomp.write_callback = [](const std::byte *decompressed_data, std::size_t size, void *user_data) -> bool {
             OutputWriter &output_writer = *reinterpret_cast<OutputWriter *>(user_data);
             std::size_t new_position = output_writer.output_position + size;
@@ -233,6 +770,13 @@ namespace Chimera {
             output_writer.output_position = new_position;
             return true;
         };
+
+        // Frames are decompressed in place, so this is only called once they're all done to note the final size
+        decomp.write_at_callback = [](const std::byte *, std::size_t offset, std::size_t size, void *user_data) -> bool {
+            OutputWriter &output_writer = *reinterpret_cast<OutputWriter *>(user_data);
+            output_writer.output_position = offset + size;
+            return true;
+        };
  
         try {
             decomp.decompress_map_file(input, &output_writer);
@@ -240,7 +784,101 @@ namespace Chimera {
         catch (std::exception &e) {
             throw;
         }
+
+        if(map_crc32) {
+            *map_crc32 = checksum.map_crc32([&output_writer](std::size_t offset, std::size_t size, std::byte *output) -> bool {
+                if(offset + size < offset || offset + size > output_writer.output_position) {
+                    return false;
+                }
+                std::copy(output_writer.output + offset, output_writer.output + offset + size, output);
+                return true;
+            });
+        }
  
         return output_writer.output_position;
     }
-}
\ No newline at end of file
+
+    std::size_t compress_map_file(const char *input, const char *output, int compression_level, std::size_t frame_size, std::size_t threads, std::uint32_t dictionary_id) {
+        if(frame_size == 0) {
+            throw std::exception();
+        }
+
+        // Digest the dictionary once for all of the frames
+        std::unique_ptr<ZSTD_CDict, std::size_t (*)(ZSTD_CDict *)> cdict(nullptr, ZSTD_freeCDict);
+        if(dictionary_id != 0) {
+            auto dictionary = find_dictionary(dictionary_id);
+            if(!dictionary) {
+                throw std::exception();
+            }
+            cdict.reset(ZSTD_createCDict(dictionary->data.data(), dictionary->data.size(), compression_level));
+            if(!cdict) {
+                throw std::exception();
+            }
+        }
+
+        // Read the whole map
+        std::FILE *input_file = std::fopen(input, "rb");
+        if(!input_file) {
+            throw std::exception();
+        }
+        std::vector<std::byte> map_data(std::filesystem::file_size(input));
+        bool read_success = map_data.size() >= HEADER_SIZE && std::fread(map_data.data(), map_data.size(), 1, input_file) == 1;
+        std::fclose(input_file);
+        if(!read_success) {
+            throw std::exception();
+        }
+
+        std::byte header_output[HEADER_SIZE];
+        compress_header(map_data.data(), header_output, map_data.size(), dictionary_id);
+
+        // Compress each frame on its own so they can be decompressed independently
+        std::size_t data_size = map_data.size() - HEADER_SIZE;
+        std::size_t frame_count = (data_size + frame_size - 1) / frame_size;
+        std::vector<std::vector<std::byte>> frames(frame_count);
+        auto *cdict_ptr = cdict.get();
+        bool success = run_jobs(frame_count, threads, [&map_data, &frames, &data_size, &frame_size, &compression_level, &cdict_ptr]() {
+            return [&map_data, &frames, &data_size, &frame_size, &compression_level, &cdict_ptr, context = std::shared_ptr<ZSTD_CCtx>(ZSTD_createCCtx(), ZSTD_freeCCtx)](std::size_t f) -> bool {
+                std::size_t offset = f * frame_size;
+                std::size_t size = std::min(frame_size, data_size - offset);
+                auto &frame = frames[f];
+                frame.resize(ZSTD_compressBound(size));
+                auto *frame_input = map_data.data() + HEADER_SIZE + offset;
+                auto result = cdict_ptr ? ZSTD_compress_usingCDict(context.get(), frame.data(), frame.size(), frame_input, size, cdict_ptr) : ZSTD_compressCCtx(context.get(), frame.data(), frame.size(), frame_input, size, compression_level);
+                if(ZSTD_isError(result)) {
+                    return false;
+                }
+                frame.resize(result);
+                return true;
+            };
+        });
+        if(!success) {
+            throw std::exception();
+        }
+
+        // Append a seek table so the map can be read without decompressing all of it
+        std::vector<SeekTableEntry> seek_table_entries(frame_count);
+        for(std::size_t f = 0; f < frame_count; f++) {
+            seek_table_entries[f].compressed_size = static_cast<std::uint32_t>(frames[f].size());
+            seek_table_entries[f].decompressed_size = static_cast<std::uint32_t>(std::min(frame_size, data_size - f * frame_size));
+        }
+        frames.emplace_back(make_map_seek_table(seek_table_entries));
+
+        // Write it all
+        std::FILE *output_file = std::fopen(output, "wb");
+        if(!output_file) {
+            throw std::exception();
+        }
+        std::size_t output_size = sizeof(header_output);
+        bool write_success = std::fwrite(header_output, sizeof(header_output), 1, output_file) == 1;
+        for(auto &frame : frames) {
+            write_success = write_success && std::fwrite(frame.data(), frame.size(), 1, output_file) == 1;
+            output_size += frame.size();
+        }
+        std::fclose(output_file);
+        if(!write_success) {
+            throw std::exception();
+        }
+
+        return output_size;
+    }
+}
@@ -4,10 +4,113 @@
 #define CHIMERA_MAP_COMPRESSION_HPP
 
 #include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+
+#include "../halo_data/map.hpp"
+
+// zstd's decompression context (ZSTD_DCtx)
+struct ZSTD_DCtx_s;
 
 namespace Chimera {
-    std::size_t decompress_map_file(const char *input, const char *output);
-    std::size_t decompress_map_file(const char *input, std::byte *output, std::size_t output_size);
+    /** Default amount of decompressed data stored in each independent frame when compressing */
+    constexpr std::size_t DEFAULT_COMPRESSION_FRAME_SIZE = 4 * 1024 * 1024;
+
+    /**
+     * Add a zstd dictionary that maps can be compressed with; maps compressed with it store its ID in their header
+     * @param data dictionary, as made by zstd --train or chimera_map_tool train
+     * @param size size of the dictionary
+     * @return     ID of the dictionary, or 0 if it isn't a zstd dictionary
+     */
+    std::uint32_t add_map_compression_dictionary(const std::byte *data, std::size_t size);
+
+    /**
+     * Load a zstd dictionary from a file
+     * @param path path to the dictionary
+     * @return     ID of the dictionary, or 0 if it couldn't be loaded
+     */
+    std::uint32_t load_map_compression_dictionary(const std::filesystem::path &path);
+
+    /**
+     * Load every .dict file in the directory
+     * @param directory directory to load dictionaries from
+     * @return          number of dictionaries loaded
+     */
+    std::size_t load_map_compression_dictionaries(const std::filesystem::path &directory) noexcept;
+
+    /**
+     * Check if a dictionary is loaded
+     * @param id ID of the dictionary
+     * @return   true if the dictionary is loaded or id is 0 (no dictionary)
+     */
+    bool has_map_compression_dictionary(std::uint32_t id) noexcept;
+
+    /**
+     * Decompress a single frame of a compressed map; this is thread-safe as long as each thread uses its own context
+     * @param context       decompression context to reuse, from ZSTD_createDCtx()
+     * @param dictionary_id ID of the dictionary the map was compressed with, or 0 if none
+     * @param output        where to decompress to
+     * @param output_size   size of the output
+     * @param input         compressed frame
+     * @param input_size    size of the compressed frame
+     * @return              decompressed size, or 0 on failure
+     */
+    std::size_t decompress_map_frame(ZSTD_DCtx_s *context, std::uint32_t dictionary_id, std::byte *output, std::size_t output_size, const std::byte *input, std::size_t input_size) noexcept;
+
+    /**
+     * Decompress a compressed map's header, throwing an exception if the map isn't compressed
+     * @param header_input  compressed map header
+     * @param header_output where to write the decompressed header
+     * @return              engine of the decompressed map
+     */
+    CacheFileEngine decompress_map_header(const std::byte *header_input, std::byte *header_output);
+
+    /**
+     * Decompress the map file into a file
+     * @param input     path to the compressed map
+     * @param output    path to write the decompressed map to
+     * @param threads   number of threads to use for multi-frame maps (0 = use all hardware threads)
+     * @param map_crc32 if set, the map's CRC32 (inverted, as stored in the map list) is calculated while decompressing and stored here (empty if it can't be)
+     * @return          size of the decompressed map
+     */
+    std::size_t decompress_map_file(const char *input, const char *output, std::size_t threads = 0, std::optional<std::uint32_t> *map_crc32 = nullptr);
+
+    /**
+     * Decompress the map file into memory
+     * @param input       path to the compressed map
+     * @param output      buffer to write the decompressed map to
+     * @param output_size size of the buffer
+     * @param threads     number of threads to use for multi-frame maps (0 = use all hardware threads)
+     * @param map_crc32   if set, the map's CRC32 (inverted, as stored in the map list) is calculated while decompressing and stored here (empty if it can't be)
+     * @return            size of the decompressed map
+     */
+    std::size_t decompress_map_file(const char *input, std::byte *output, std::size_t output_size, std::size_t threads = 0, std::optional<std::uint32_t> *map_crc32 = nullptr);
+
+    /**
+     * Decompress a compressed map into a file as it's read in order from somewhere slow, such as while it's downloaded
+     * @param read            function that reads the next size bytes of the compressed map into output, waiting for them if it has
+     *                        to, and returns false if it can't
+     * @param compressed_size size of the compressed map
+     * @param output          path to write the decompressed map to
+     * @param map_crc32       if set, the map's CRC32 (inverted, as stored in the map list) is calculated while decompressing and stored here (empty if it can't be)
+     * @return                size of the decompressed map
+     */
+    std::size_t decompress_map_stream(const std::function<bool (std::byte *output, std::size_t size)> &read, std::size_t compressed_size, const char *output, std::optional<std::uint32_t> *map_crc32 = nullptr);
+
+    /**
+     * Compress the map file into independent frames so it can be decompressed in parallel, followed by a seek table so it can be read
+     * without decompressing all of it
+     * @param input             path to the uncompressed map
+     * @param output            path to write the compressed map to
+     * @param compression_level zstd compression level to use
+     * @param frame_size        amount of decompressed data to store in each frame
+     * @param threads           number of threads to use (0 = use all hardware threads)
+     * @param dictionary_id     ID of a loaded dictionary to compress with, or 0 for none
+     * @return                  size of the compressed map
+     */
+    std::size_t compress_map_file(const char *input, const char *output, int compression_level = 19, std::size_t frame_size = DEFAULT_COMPRESSION_FRAME_SIZE, std::size_t threads = 0, std::uint32_t dictionary_id = 0);
 }
 
-#endif
\ No newline at end of file
+#endif
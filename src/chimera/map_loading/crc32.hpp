@@ -1,8 +1,28 @@
 #ifndef CRC32_HPP
 #define CRC32_HPP
 
+#include <cstddef>
 #include <cstdint>
 
+/** CRC32 using the fastest implementation supported by this CPU */
 extern "C" std::uint32_t crc32(std::uint32_t crc, const void *buf, std::size_t size);
 
-#endif
\ No newline at end of file
+/** Original byte-at-a-time implementation */
+extern "C" std::uint32_t crc32_bytewise(std::uint32_t crc, const void *buf, std::size_t size);
+
+/** Table-driven implementation that handles eight bytes at a time */
+extern "C" std::uint32_t crc32_slice_by_8(std::uint32_t crc, const void *buf, std::size_t size);
+
+/** PCLMULQDQ folding; only call this if crc32_pclmul_supported() returns nonzero */
+extern "C" std::uint32_t crc32_pclmul(std::uint32_t crc, const void *buf, std::size_t size);
+
+/** Nonzero if the CPU supports PCLMULQDQ and SSE4.1 */
+extern "C" int crc32_pclmul_supported();
+
+/** CRC32 of the second block appended to the first, given the CRC32s of both and the length of the second */
+extern "C" std::uint32_t crc32_combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t len2);
+
+/** Name of the implementation used by crc32() */
+extern "C" const char *crc32_implementation();
+
+#endif
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cctype>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../chimera.hpp"
+#include "../event/frame.hpp"
+#include "crc32_cache.hpp"
+#include "fast_load.hpp"
+#include "map_loading.hpp"
+
+namespace Chimera {
+    struct CachedCRC32 {
+        unsigned long long file_size;
+        long long timestamp;
+        std::uint32_t crc32;
+    };
+
+    struct PendingCRC32 {
+        std::string map_name;
+        std::filesystem::path path;
+        std::string key;
+        CachedCRC32 file_info;
+    };
+
+    static std::unordered_map<std::string, CachedCRC32> crc32_cache;
+    static bool crc32_cache_loaded = false;
+
+    static std::mutex background_mutex;
+    static std::deque<PendingCRC32> background_queue;
+    static std::vector<PendingCRC32> background_results;
+    static bool background_thread_running = false;
+
+    static std::filesystem::path crc32_cache_path() {
+        return std::filesystem::path(get_chimera().get_path()) / "crc32_cache.txt";
+    }
+
+    // Paths are case-insensitive on Windows, so normalize them before using them as keys
+    std::string map_path_key(const std::filesystem::path &path) {
+        std::error_code ec;
+        auto absolute_path = std::filesystem::absolute(path, ec);
+        auto key = (ec ? path : absolute_path).lexically_normal().string();
+        for(auto &c : key) {
+            c = std::tolower(c);
+        }
+        return key;
+    }
+
+    static std::optional<CachedCRC32> stat_map_file(const std::filesystem::path &path) noexcept {
+        std::error_code ec;
+        auto file_size = std::filesystem::file_size(path, ec);
+        if(ec) {
+            return std::nullopt;
+        }
+        auto timestamp = std::filesystem::last_write_time(path, ec);
+        if(ec) {
+            return std::nullopt;
+        }
+        return CachedCRC32 { file_size, static_cast<long long>(timestamp.time_since_epoch().count()), 0 };
+    }
+
+    static void load_crc32_cache() {
+        if(crc32_cache_loaded) {
+            return;
+        }
+        crc32_cache_loaded = true;
+
+        // Each line is the CRC32, file size, and timestamp followed by the path
+        std::ifstream f(crc32_cache_path());
+        std::string line;
+        while(std::getline(f, line)) {
+            while(!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+                line.pop_back();
+            }
+
+            unsigned long crc32;
+            unsigned long long file_size;
+            long long timestamp;
+            int path_offset = 0;
+            if(std::sscanf(line.c_str(), "%lx %llu %lld %n", &crc32, &file_size, &timestamp, &path_offset) == 3 && path_offset > 0 && static_cast<std::size_t>(path_offset) < line.size()) {
+                crc32_cache[line.substr(path_offset)] = CachedCRC32 { file_size, timestamp, static_cast<std::uint32_t>(crc32) };
+            }
+        }
+    }
+
+    static void save_crc32_cache() noexcept {
+        std::ofstream f(crc32_cache_path(), std::ios_base::out | std::ios_base::trunc);
+        for(auto &[key, entry] : crc32_cache) {
+            char prefix[64];
+            std::snprintf(prefix, sizeof(prefix), "%08lX %llu %lld ", static_cast<unsigned long>(entry.crc32), entry.file_size, entry.timestamp);
+            f << prefix << key << "\n";
+        }
+    }
+
+    std::optional<std::uint32_t> get_cached_map_crc32(const std::filesystem::path &path) noexcept {
+        load_crc32_cache();
+
+        auto cached = crc32_cache.find(map_path_key(path));
+        if(cached == crc32_cache.end()) {
+            return std::nullopt;
+        }
+
+        // If the file was changed, the CRC32 is stale
+        auto file_info = stat_map_file(path);
+        if(!file_info.has_value() || file_info->file_size != cached->second.file_size || file_info->timestamp != cached->second.timestamp) {
+            return std::nullopt;
+        }
+
+        return cached->second.crc32;
+    }
+
+    void set_cached_map_crc32(const std::filesystem::path &path, std::uint32_t crc32) noexcept {
+        load_crc32_cache();
+
+        auto file_info = stat_map_file(path);
+        if(!file_info.has_value()) {
+            return;
+        }
+        file_info->crc32 = crc32;
+        crc32_cache[map_path_key(path)] = *file_info;
+        save_crc32_cache();
+    }
+
+    static void background_crc32_thread() noexcept {
+        while(true) {
+            PendingCRC32 pending;
+            {
+                std::scoped_lock<std::mutex> lock(background_mutex);
+                if(background_queue.empty()) {
+                    background_thread_running = false;
+                    return;
+                }
+                pending = std::move(background_queue.front());
+                background_queue.pop_front();
+            }
+
+            // Compressed maps need decompressed first, so those get done when they're loaded instead
+            auto crc32 = calculate_crc32_of_map_file(pending.path);
+            if(crc32.has_value()) {
+                pending.file_info.crc32 = *crc32;
+                std::scoped_lock<std::mutex> lock(background_mutex);
+                background_results.emplace_back(std::move(pending));
+            }
+        }
+    }
+
+    static void apply_background_crc32s() noexcept {
+        std::vector<PendingCRC32> results;
+        bool still_running;
+        {
+            std::scoped_lock<std::mutex> lock(background_mutex);
+            results.swap(background_results);
+            still_running = background_thread_running;
+        }
+
+        for(auto &r : results) {
+            crc32_cache[r.key] = r.file_info;
+            auto *entry = get_map_entry(r.map_name.c_str());
+            if(entry && !entry->crc32.has_value()) {
+                entry->crc32 = r.file_info.crc32;
+            }
+        }
+
+        if(!results.empty()) {
+            save_crc32_cache();
+            resync_map_list();
+        }
+
+        if(!still_running) {
+            remove_frame_event(apply_background_crc32s);
+        }
+    }
+
+    void queue_map_crc32_calculation(const char *map_name, const std::filesystem::path &path) noexcept {
+        auto file_info = stat_map_file(path);
+        if(!file_info.has_value()) {
+            return;
+        }
+
+        std::scoped_lock<std::mutex> lock(background_mutex);
+        background_queue.emplace_back(PendingCRC32 { map_name, path, map_path_key(path), *file_info });
+        if(!background_thread_running) {
+            background_thread_running = true;
+            std::thread(background_crc32_thread).detach();
+            add_frame_event(apply_background_crc32s);
+        }
+    }
+}
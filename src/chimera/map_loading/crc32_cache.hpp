@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_CRC32_CACHE_HPP
+#define CHIMERA_CRC32_CACHE_HPP
+
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+#include <string>
+
+namespace Chimera {
+    /**
+     * Get a key for a map's path that is the same no matter how the path is written
+     * @param path path to the map file
+     * @return     normalized, lowercase, absolute path
+     */
+    std::string map_path_key(const std::filesystem::path &path);
+
+    /**
+     * Get the cached CRC32 of a map file if the file has not been modified since it was cached
+     * @param path path to the map file
+     * @return     CRC32 if cached and still valid
+     */
+    std::optional<std::uint32_t> get_cached_map_crc32(const std::filesystem::path &path) noexcept;
+
+    /**
+     * Cache the CRC32 of a map file and save the cache
+     * @param path  path to the map file
+     * @param crc32 CRC32 of the map
+     */
+    void set_cached_map_crc32(const std::filesystem::path &path, std::uint32_t crc32) noexcept;
+
+    /**
+     * Calculate the CRC32 of a map file in the background, setting it in the map list when done
+     * @param map_name name of the map in the map list
+     * @param path     path to the map file
+     */
+    void queue_map_crc32_calculation(const char *map_name, const std::filesystem::path &path) noexcept;
+}
+
+#endif
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+
+#include "../../hac_map_downloader/hac_map_downloader.hpp"
+#include "compression.hpp"
+#include "crc32_cache.hpp"
+#include "download_decompression.hpp"
+#include "map_cache.hpp"
+
+namespace Chimera {
+    // How long to wait before checking if more of the map was downloaded
+    static constexpr std::chrono::milliseconds DOWNLOAD_POLL_INTERVAL(50);
+
+    DownloadDecompression::DownloadDecompression(HACMapDownloader &downloader, const std::filesystem::path &download_path) : downloader(downloader), download_path(download_path), decompressed_path(download_path.string() + ".decompressed") {
+        this->thread = std::thread(&DownloadDecompression::decompress, this);
+    }
+
+    DownloadDecompression::~DownloadDecompression() {
+        this->canceled = true;
+        this->thread.join();
+
+        // If it was added to the map cache, it isn't here anymore
+        std::error_code ec;
+        std::filesystem::remove(this->decompressed_path, ec);
+    }
+
+    bool DownloadDecompression::add_to_cache(const std::filesystem::path &map_path, const std::vector<std::filesystem::path> &keep) noexcept {
+        if(!this->finished || !this->success) {
+            return false;
+        }
+        this->success = false;
+        if(this->map_crc32.has_value()) {
+            set_cached_map_crc32(map_path, *this->map_crc32);
+        }
+        return add_decompressed_map_to_cache(map_path, this->decompressed_path, keep);
+    }
+
+    void DownloadDecompression::decompress() noexcept {
+        unsigned int restarts;
+        bool restarted = false;
+
+        // Wait until ready() says we have what we need, giving up if the download stops or starts over without it (or we're
+        // canceled, even if we have it, so this stops straight away)
+        auto wait = [this, &restarts, &restarted](const auto &ready) -> bool {
+            while(true) {
+                if(this->canceled) {
+                    return false;
+                }
+                auto status = this->downloader.get_status();
+                unsigned int current_restarts;
+                auto available = this->downloader.get_contiguous_size(&current_restarts);
+                if(current_restarts != restarts) {
+                    restarted = true;
+                    return false;
+                }
+                if(ready(available)) {
+                    return true;
+                }
+                if((status != HACMapDownloader::DOWNLOAD_STAGE_STARTING && status != HACMapDownloader::DOWNLOAD_STAGE_DOWNLOADING)) {
+                    return false;
+                }
+                std::this_thread::sleep_for(DOWNLOAD_POLL_INTERVAL);
+            }
+        };
+
+        do {
+            this->downloader.get_contiguous_size(&restarts);
+            restarted = false;
+
+            // We have to know how big the map is to know where it ends
+            std::size_t compressed_size = 0;
+            if(!wait([this, &compressed_size](std::size_t) { return (compressed_size = this->downloader.get_total_size()) > 0; })) {
+                continue;
+            }
+
+            // Only read what the downloader says has no gaps; anything past that could be anything
+            std::FILE *f = std::fopen(this->download_path.string().c_str(), "rb");
+            if(!f) {
+                break;
+            }
+            std::setvbuf(f, nullptr, _IONBF, 0);
+
+            std::size_t position = 0;
+            auto read = [&wait, &f, &position](std::byte *output, std::size_t size) -> bool {
+                if(!wait([&position, &size](std::size_t available) { return available >= position + size; })) {
+                    return false;
+                }
+                if(std::fseek(f, static_cast<long>(position), SEEK_SET) != 0 || std::fread(output, size, 1, f) != 1) {
+                    return false;
+                }
+                position += size;
+                return true;
+            };
+
+            try {
+                std::optional<std::uint32_t> map_crc32;
+                decompress_map_stream(read, compressed_size, this->decompressed_path.string().c_str(), &map_crc32);
+
+                // Make sure the download didn't start over after the last of it was read
+                unsigned int current_restarts;
+                this->downloader.get_contiguous_size(&current_restarts);
+                restarted = current_restarts != restarts;
+                if(!restarted) {
+                    this->map_crc32 = map_crc32;
+                    this->success = true;
+                }
+            }
+            catch(std::exception &) {
+                // If what we read didn't decompress, it might be because part of it was from an old version that is being downloaded again
+                if(!restarted) {
+                    wait([](std::size_t) { return false; });
+                }
+            }
+            std::fclose(f);
+        }
+        while(restarted && !this->canceled);
+
+        if(!this->success) {
+            std::error_code ec;
+            std::filesystem::remove(this->decompressed_path, ec);
+        }
+        this->finished = true;
+    }
+}
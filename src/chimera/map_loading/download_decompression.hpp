@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_DOWNLOAD_DECOMPRESSION_HPP
+#define CHIMERA_DOWNLOAD_DECOMPRESSION_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <thread>
+#include <vector>
+
+class HACMapDownloader;
+
+namespace Chimera {
+    /**
+     * Decompresses and checksums a map while it's still being downloaded, following the part of the download that has no gaps, so
+     * it's ready to go into the map cache as soon as the download finishes
+     */
+    class DownloadDecompression {
+    public:
+        /**
+         * Start decompressing
+         * @param downloader    downloader of the map; this must not be deleted before this is
+         * @param download_path path the map is being downloaded to
+         */
+        DownloadDecompression(HACMapDownloader &downloader, const std::filesystem::path &download_path);
+
+        DownloadDecompression(const DownloadDecompression &) = delete;
+        DownloadDecompression &operator=(const DownloadDecompression &) = delete;
+
+        /**
+         * Stop decompressing if we haven't finished yet, deleting the decompressed map if it wasn't added to the map cache
+         */
+        ~DownloadDecompression();
+
+        /**
+         * Get whether we're done, either because everything was decompressed or because it couldn't be
+         * @return true if done
+         */
+        bool is_finished() const noexcept {
+            return this->finished;
+        }
+
+        /**
+         * Add the decompressed map to the map cache and its CRC32 to the CRC32 cache once the download is finished and moved to where
+         * it goes, so it doesn't have to be decompressed or checksummed again when it's loaded
+         * @param map_path path the downloaded map was moved to
+         * @param keep     paths that must not be evicted from the map cache
+         * @return         true if the map was added
+         */
+        bool add_to_cache(const std::filesystem::path &map_path, const std::vector<std::filesystem::path> &keep) noexcept;
+
+    private:
+        /** Downloader of the map */
+        HACMapDownloader &downloader;
+
+        /** Path the map is being downloaded to */
+        std::filesystem::path download_path;
+
+        /** Path to decompress to */
+        std::filesystem::path decompressed_path;
+
+        /** Set when the thread is done */
+        std::atomic<bool> finished = false;
+
+        /** Set to make the thread stop */
+        std::atomic<bool> canceled = false;
+
+        /** The map was decompressed; set by the thread before it's finished */
+        bool success = false;
+
+        /** CRC32 of the decompressed map, as the map list has it, if it could be calculated */
+        std::optional<std::uint32_t> map_crc32;
+
+        /** Thread doing the decompression */
+        std::thread thread;
+
+        /**
+         * Decompress the map as it's downloaded, starting over if the download does
+         */
+        void decompress() noexcept;
+    };
+}
+
+#endif
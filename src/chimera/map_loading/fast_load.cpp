@@ -1,361 +1,884 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
-#include <windows.h>
-#include <cctype>
-#include <cstdint>
-#include <cstdlib>
-#include <filesystem>
-#include <shlwapi.h>
-
-#include "../chimera.hpp"
-#include "../signature/signature.hpp"
-#include "../signature/hook.hpp"
-#include "../event/frame.hpp"
-#include "../event/tick.hpp"
-#include "../event/map_load.hpp"
-#include "../halo_data/map.hpp"
-#include "../halo_data/tag.hpp"
-#include "../halo_data/game_engine.hpp"
-#include "../halo_data/multiplayer.hpp"
-#include "../map_loading/map_loading.hpp"
-#include "../output/output.hpp"
-
-#include "fast_load.hpp"
-
-extern "C" {
-    std::uint32_t crc32(std::uint32_t crc, const void *buf, std::size_t size) noexcept;
-    void on_get_crc32_hook() noexcept;
-}
-
-namespace Chimera {
-    std::filesystem::path MapEntry::get_file_path() {
-        auto p1 = std::filesystem::path("maps") / (this->name + ".map");
-        if(std::filesystem::exists(p1)) {
-            return p1;
-        }
-        else {
-            return std::filesystem::path(get_chimera().get_path()) / "maps" / (this->name + ".map");
-        }
-    }
-    
-    static bool same_string_case_insensitive(const char *a, const char *b) {
-        if(a == b) return true;
-        while(std::tolower(*a) == std::tolower(*b)) {
-            if(*a == 0) return true;
-            a++;
-            b++;
-        }
-        return false;
-    }
-
-    std::optional<std::uint32_t> crc32_for_stock_map(const char *stock_map) noexcept {
-        if(std::strcmp(stock_map, "beavercreek") == 0) {
-            return 0x07B3876A;
-        }
-        else if(std::strcmp(stock_map, "bloodgulch") == 0) {
-            return 0x7B309554;
-        }
-        else if(std::strcmp(stock_map, "boardingaction") == 0) {
-            return 0xF4DEEF94;
-        }
-        else if(std::strcmp(stock_map, "carousel") == 0) {
-            return 0x9C301A08;
-        }
-        else if(std::strcmp(stock_map, "chillout") == 0) {
-            return 0x93C53C27;
-        }
-        else if(std::strcmp(stock_map, "damnation") == 0) {
-            return 0x0FBA059D;
-        }
-        else if(std::strcmp(stock_map, "dangercanyon") == 0) {
-            return 0xC410CD74;
-        }
-        else if(std::strcmp(stock_map, "deathisland") == 0) {
-            return 0x1DF8C97F;
-        }
-        else if(std::strcmp(stock_map, "gephyrophobia") == 0) {
-            return 0xD2872165;
-        }
-        else if(std::strcmp(stock_map, "hangemhigh") == 0) {
-            return 0xA7C8B9C6;
-        }
-        else if(std::strcmp(stock_map, "icefields") == 0) {
-            return 0x5EC1DEB7;
-        }
-        else if(std::strcmp(stock_map, "infinity") == 0) {
-            return 0x0E7F7FE7;
-        }
-        else if(std::strcmp(stock_map, "longest") == 0) {
-            return 0xC8F48FF6;
-        }
-        else if(std::strcmp(stock_map, "prisoner") == 0) {
-            return 0x43B81A8B;
-        }
-        else if(std::strcmp(stock_map, "putput") == 0) {
-            return 0xAF2F0B84;
-        }
-        else if(std::strcmp(stock_map, "ratrace") == 0) {
-            return 0xF7F8E14C;
-        }
-        else if(std::strcmp(stock_map, "sidewinder") == 0) {
-            return 0xBD95CF55;
-        }
-        else if(std::strcmp(stock_map, "timberland") == 0) {
-            return 0x54446470;
-        }
-        else if(std::strcmp(stock_map, "wizard") == 0) {
-            return 0xCF3359B1;
-        }
-        return std::nullopt;
-    }
-
-    extern "C" void on_get_crc32_custom_edition_loading() noexcept {
-        static char *loading_map = *reinterpret_cast<char **>(get_chimera().get_signature("loading_map_sig").data() + 1);
-        load_map(loading_map);
-        auto *entry = get_map_entry(loading_map);
-        auto &map_list = get_map_list();
-        auto *indices = reinterpret_cast<MapIndexCustomEdition *>(map_list.map_list);
-        for(std::size_t i=0; i<map_list.map_count; i++) {
-            if(entry->name == indices[i].file_name) {
-                indices[i].crc32 = entry->crc32.value();
-                break;
-            }
-        }
-    }
-
-    void initialize_fast_load() noexcept {
-        auto engine = game_engine();
-
-        switch(engine) {
-            case GameEngine::GAME_ENGINE_CUSTOM_EDITION: {
-                // Disable Halo's CRC32ing (drastically speed up loading)
-                auto *get_crc = get_chimera().get_signature("get_crc_sig").data();
-                static unsigned char nop7[7] = { 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90 };
-                overwrite(get_crc, nop7, sizeof(nop7));
-                overwrite(get_crc, static_cast<std::uint8_t>(0xE8));
-                overwrite(get_crc + 1, reinterpret_cast<std::uintptr_t>(on_get_crc32_hook) - reinterpret_cast<std::uintptr_t>(get_crc + 5));
-
-                // Prevent Halo from loading the map list (speed up loading)
-                overwrite(get_chimera().get_signature("load_multiplayer_maps_sig").data(), static_cast<std::uint8_t>(0xC3));
-
-                // Load the maps list on the next tick
-                add_frame_event(reload_map_list_frame);
-
-                // Stop Halo from freeing the map list on close since it will just segfault if it does that
-                overwrite(get_chimera().get_signature("free_map_index_sig").data(), static_cast<std::uint8_t>(0xC3));
-                break;
-            }
-
-            case GameEngine::GAME_ENGINE_RETAIL: {
-                // Meme Halo into showing custom maps
-                overwrite(get_chimera().get_signature("load_multiplayer_maps_retail_sig").data(), static_cast<std::uint8_t>(0xC3));
-
-                // Load the maps list on the next tick
-                add_frame_event(reload_map_list_frame);
-
-                // Stop Halo from freeing the map list on close since it will just segfault if it does that
-                overwrite(get_chimera().get_signature("free_map_index_sig").data(), static_cast<std::uint8_t>(0xC3));
-                break;
-            }
-
-            case GameEngine::GAME_ENGINE_DEMO: {
-                // Meme Halo into showing custom maps
-                overwrite(get_chimera().get_signature("load_multiplayer_maps_demo_sig").data(), static_cast<std::uint8_t>(0xC3));
-
-                // Load the maps list on the next tick
-                add_frame_event(reload_map_list_frame);
-
-                // Stop Halo from freeing the map list on close since it will just segfault if it does that
-                overwrite(get_chimera().get_signature("free_map_index_demo_sig").data(), static_cast<std::uint8_t>(0xC3));
-                break;
-            }
-        }
-    }
-    
-    static std::vector<MapEntry> all_maps;
-    
-    template <typename MapIndexType> static void resync_map_list() {
-        // Hold our indices
-        static MapIndexType **indices = nullptr;
-        static std::uint32_t *count = nullptr;
-        static std::vector<MapIndexType> indices_vector;
-        
-        auto &map_list = get_map_list();
-        indices = reinterpret_cast<MapIndexType **>(&map_list.map_list);
-        count = reinterpret_cast<std::uint32_t *>(&map_list.map_count);
-        indices_vector.clear();
-        
-        for(auto &i : all_maps) {
-            if(!i.multiplayer) {
-                continue;
-            }
-            
-            auto *map = &indices_vector.emplace_back();
-            map->file_name = i.name.c_str();
-            map->map_name_index = i.index.value_or(13);
-            
-            if(sizeof(*map) >= sizeof(MapIndexRetail)) {
-                reinterpret_cast<MapIndexRetail *>(map)->loaded = 1;
-                
-                if(sizeof(*map) >= sizeof(MapIndexCustomEdition)) {
-                    reinterpret_cast<MapIndexCustomEdition *>(map)->crc32 = i.crc32.value_or(0xFFFFFFFF);
-                }
-            }
-        }
-        
-        *indices = indices_vector.data();
-        *count = indices_vector.size();
-    }
-    
-    void resync_map_list() {
-        auto engine = game_engine();
-
-        switch(engine) {
-            case GameEngine::GAME_ENGINE_CUSTOM_EDITION:
-                resync_map_list<MapIndexCustomEdition>();
-                break;
-            case GameEngine::GAME_ENGINE_RETAIL:
-                resync_map_list<MapIndexRetail>();
-                break;
-            case GameEngine::GAME_ENGINE_DEMO:
-                resync_map_list<MapIndex>();
-                break;
-        }
-    }
-    
-    MapEntry *get_map_entry(const char *map_name) {
-        for(auto &map : all_maps) {
-            if(same_string_case_insensitive(map_name, map.name.c_str())) {
-                return &map;
-            }
-        }
-        return nullptr;
-    }
-    
-    MapEntry &add_map_to_map_list(const char *map_name, std::optional<std::uint32_t> map_index) {
-        // Don't add maps we've already added
-        MapEntry *map;
-        if((map = get_map_entry(map_name)) != nullptr) {
-            return *map;
-        }
-        
-        // First, let's lowercase it
-        char map_name_lowercase[32];
-        std::strncpy(map_name_lowercase, map_name, sizeof(map_name_lowercase) - 1);
-        
-        // Add it!
-        map = &all_maps.emplace_back();
-        map->name = map_name_lowercase;
-        map->index = map_index;
-        map->multiplayer = true;
-        
-        // If it's known to not be a multiplayer map, set this
-        static const char *NON_MULTIPLAYER_MAPS[] = {
-            "a10",
-            "a30",
-            "a50",
-            "b30",
-            "b40",
-            "c10",
-            "c20",
-            "c40",
-            "d20",
-            "d40",
-            "ui"
-        };
-        for(auto &nmp : NON_MULTIPLAYER_MAPS) {
-            if(same_string_case_insensitive(nmp, map_name)) {
-                map->multiplayer = false;
-            }
-        }
-        
-        return *map;
-    }
-
-    static void reload_map_list() {
-        // Clear the bitch
-        auto old_maps = all_maps;
-        all_maps.clear();
-        
-        std::uint32_t stock_index = 0;
-        #define ADD_STOCK_MAP(map_name) add_map_to_map_list(map_name, stock_index++)
-        
-        if(game_engine() == GameEngine::GAME_ENGINE_DEMO) {
-            ADD_STOCK_MAP("bloodgulch");
-        }
-        else {
-            ADD_STOCK_MAP("beavercreek");
-            ADD_STOCK_MAP("sidewinder");
-            ADD_STOCK_MAP("damnation");
-            ADD_STOCK_MAP("ratrace");
-            ADD_STOCK_MAP("prisoner");
-            ADD_STOCK_MAP("hangemhigh");
-            ADD_STOCK_MAP("chillout");
-            ADD_STOCK_MAP("carousel");
-            ADD_STOCK_MAP("boardingaction");
-            ADD_STOCK_MAP("bloodgulch");
-            ADD_STOCK_MAP("wizard");
-            ADD_STOCK_MAP("putput");
-            ADD_STOCK_MAP("longest");
-            ADD_STOCK_MAP("icefields");
-            ADD_STOCK_MAP("deathisland");
-            ADD_STOCK_MAP("dangercanyon");
-            ADD_STOCK_MAP("infinity");
-            ADD_STOCK_MAP("timberland");
-            ADD_STOCK_MAP("gephyrophobia");
-        }
-        
-        auto add_map_folder = [](std::filesystem::path directory) {
-            static const char *BLACKLISTED_MAPS[] = {
-                "bitmaps",
-                "sounds",
-                "loc",
-                "custom_bitmaps",
-                "custom_sounds",
-                "custom_loc"
-            };
-            
-            for(auto &map : std::filesystem::directory_iterator(directory)) {
-                if(map.is_regular_file()) {
-                    auto &path = map.path();
-                    
-                    // Get extension
-                    auto extension = path.extension().string();
-                    if(same_string_case_insensitive(extension.c_str(), ".map")) {
-                        // Get name
-                        auto name = path.stem().string();
-                        
-                        // Is it blacklisted?
-                        for(auto &b : BLACKLISTED_MAPS) {
-                            if(same_string_case_insensitive(name.c_str(), b)) {
-                                goto nope;
-                            }
-                        }
-                        
-                        add_map_to_map_list(name.c_str());
-                    }
-                    
-                    nope: continue;
-                }
-            }
-        };
-        
-        add_map_folder("maps");
-        add_map_folder(std::filesystem::path(get_chimera().get_path()) / "maps");
-        
-        // Reset CRC32
-        for(auto &i : old_maps) {
-            auto *map = get_map_entry(i.name.c_str());
-            if(map) {
-                map->crc32 = i.crc32;
-            }
-        }
-        
-        resync_map_list();
-    }
-
-    void reload_map_list_frame() noexcept {
-        remove_frame_event(reload_map_list_frame);
-        reload_map_list();
-    }
-}
+#include <windows.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <shlwapi.h>
+
+#include "../chimera.hpp"
+#include "../signature/signature.hpp"
+#include "../signature/hook.hpp"
+#include "../event/frame.hpp"
+#include "../event/tick.hpp"
+#include "../event/map_load.hpp"
+#include "../halo_data/map.hpp"
+#include "../halo_data/tag.hpp"
+#include "../halo_data/game_engine.hpp"
+#include "../halo_data/multiplayer.hpp"
+#include "../map_loading/map_loading.hpp"
+#include "../output/output.hpp"
+#include "crc32_cache.hpp"
+#include "mapped_file.hpp"
+
+#include "fast_load.hpp"
+
+extern "C" {
+    std::uint32_t crc32(std::uint32_t crc, const void *buf, std::size_t size) noexcept;
+    void on_get_crc32_hook() noexcept;
+}
+
+namespace Chimera {
+    std::filesystem::path MapEntry::get_file_path() {
+        auto p1 = std::filesystem::path("maps") / (this->name + ".map");
+        if(std::filesystem::exists(p1)) {
+            return p1;
+        }
+        else {
+            return std::filesystem::path(get_chimera().get_path()) / "maps" / (this->name + ".map");
+        }
+    }
+    
+    static bool same_string_case_insensitive(const char *a, const char *b) {
+        if(a == b) return true;
+        while(std::tolower(*a) == std::tolower(*b)) {
+            if(*a == 0) return true;
+            a++;
+            b++;
+        }
+        return false;
+    }
+    
+    static std::string lowercase_map_name(const char *map_name) {
+        std::string name = map_name;
+        for(auto &c : name) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return name;
+    }
+
+    std::optional<std::uint32_t> crc32_for_stock_map(const char *stock_map) noexcept {
+        if(std::strcmp(stock_map, "beavercreek") == 0) {
+            return 0x07B3876A;
+        }
+        else if(std::strcmp(stock_map, "bloodgulch") == 0) {
+            return 0x7B309554;
+        }
+        else if(std::strcmp(stock_map, "boardingaction") == 0) {
+            return 0xF4DEEF94;
+        }
+        else if(std::strcmp(stock_map, "carousel") == 0) {
+            return 0x9C301A08;
+        }
+        else if(std::strcmp(stock_map, "chillout") == 0) {
+            return 0x93C53C27;
+        }
+        else if(std::strcmp(stock_map, "damnation") == 0) {
+            return 0x0FBA059D;
+        }
+        else if(std::strcmp(stock_map, "dangercanyon") == 0) {
+            return 0xC410CD74;
+        }
+        else if(std::strcmp(stock_map, "deathisland") == 0) {
+            return 0x1DF8C97F;
+        }
+        else if(std::strcmp(stock_map, "gephyrophobia") == 0) {
+            return 0xD2872165;
+        }
+        else if(std::strcmp(stock_map, "hangemhigh") == 0) {
+            return 0xA7C8B9C6;
+        }
+        else if(std::strcmp(stock_map, "icefields") == 0) {
+            return 0x5EC1DEB7;
+        }
+        else if(std::strcmp(stock_map, "infinity") == 0) {
+            return 0x0E7F7FE7;
+        }
+        else if(std::strcmp(stock_map, "longest") == 0) {
+            return 0xC8F48FF6;
+        }
+        else if(std::strcmp(stock_map, "prisoner") == 0) {
+            return 0x43B81A8B;
+        }
+        else if(std::strcmp(stock_map, "putput") == 0) {
+            return 0xAF2F0B84;
+        }
+        else if(std::strcmp(stock_map, "ratrace") == 0) {
+            return 0xF7F8E14C;
+        }
+        else if(std::strcmp(stock_map, "sidewinder") == 0) {
+            return 0xBD95CF55;
+        }
+        else if(std::strcmp(stock_map, "timberland") == 0) {
+            return 0x54446470;
+        }
+        else if(std::strcmp(stock_map, "wizard") == 0) {
+            return 0xCF3359B1;
+        }
+        return std::nullopt;
+    }
+
+    extern "C" void on_get_crc32_custom_edition_loading() noexcept {
+        static char *loading_map = *reinterpret_cast<char **>(get_chimera().get_signature("loading_map_sig").data() + 1);
+        load_map(loading_map);
+        auto *entry = get_map_entry(loading_map);
+        auto &map_list = get_map_list();
+        auto *indices = reinterpret_cast<MapIndexCustomEdition *>(map_list.map_list);
+        for(std::size_t i=0; i<map_list.map_count; i++) {
+            if(entry->name == indices[i].file_name) {
+                indices[i].crc32 = entry->crc32.value();
+                break;
+            }
+        }
+    }
+
+    void initialize_fast_load() noexcept {
+        auto engine = game_engine();
+
+        switch(engine) {
+            case GameEngine::GAME_ENGINE_CUSTOM_EDITION: {
+                // Disable Halo's CRC32ing (drastically speed up loading)
+                auto *get_crc = get_chimera().get_signature("get_crc_sig").data();
+                static unsigned char nop7[7] = { 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90 };
+                overwrite(get_crc, nop7, sizeof(nop7));
+                overwrite(get_crc, static_cast<std::uint8_t>(0xE8));
+                overwrite(get_crc + 1, reinterpret_cast<std::uintptr_t>(on_get_crc32_hook) - reinterpret_cast<std::uintptr_t>(get_crc + 5));
+
+                // Prevent Halo from loading the map list (speed up loading)
+                overwrite(get_chimera().get_signature("load_multiplayer_maps_sig").data(), static_cast<std::uint8_t>(0xC3));
+
+                // Load the maps list on the next tick
+                add_frame_event(reload_map_list_frame);
+
+                // Stop Halo from freeing the map list on close since it will just segfault if it does that
+                overwrite(get_chimera().get_signature("free_map_index_sig").data(), static_cast<std::uint8_t>(0xC3));
+                break;
+            }
+
+            case GameEngine::GAME_ENGINE_RETAIL: {
+                // Meme Halo into showing custom maps
+                overwrite(get_chimera().get_signature("load_multiplayer_maps_retail_sig").data(), static_cast<std::uint8_t>(0xC3));
+
+                // Load the maps list on the next tick
+                add_frame_event(reload_map_list_frame);
+
+                // Stop Halo from freeing the map list on close since it will just segfault if it does that
+                overwrite(get_chimera().get_signature("free_map_index_sig").data(), static_cast<std::uint8_t>(0xC3));
+                break;
+            }
+
+            case GameEngine::GAME_ENGINE_DEMO: {
+                // Meme Halo into showing custom maps
+                overwrite(get_chimera().get_signature("load_multiplayer_maps_demo_sig").data(), static_cast<std::uint8_t>(0xC3));
+
+                // Load the maps list on the next tick
+                add_frame_event(reload_map_list_frame);
+
+                // Stop Halo from freeing the map list on close since it will just segfault if it does that
+                overwrite(get_chimera().get_signature("free_map_index_demo_sig").data(), static_cast<std::uint8_t>(0xC3));
+                break;
+            }
+        }
+    }
+    
+    static std::vector<MapEntry> all_maps;
+    
+    // Lowercase map names -> index in all_maps
+    static std::unordered_map<std::string, std::size_t> all_maps_by_name;
+    
+    static void save_map_catalog() noexcept;
+    
+    static void reindex_map_list() {
+        all_maps_by_name.clear();
+        all_maps_by_name.reserve(all_maps.size());
+        for(std::size_t i = 0; i < all_maps.size(); i++) {
+            all_maps_by_name.try_emplace(lowercase_map_name(all_maps[i].name.c_str()), i);
+        }
+    }
+    
+    template <typename MapIndexType> static void resync_map_list() {
+        // Hold our indices
+        static MapIndexType **indices = nullptr;
+        static std::uint32_t *count = nullptr;
+        static std::vector<MapIndexType> indices_vector;
+        static std::vector<MapIndexType> new_indices_vector;
+        
+        auto &map_list = get_map_list();
+        indices = reinterpret_cast<MapIndexType **>(&map_list.map_list);
+        count = reinterpret_cast<std::uint32_t *>(&map_list.map_count);
+        new_indices_vector.clear();
+        
+        for(auto &i : all_maps) {
+            if(!i.multiplayer) {
+                continue;
+            }
+            
+            auto *map = &new_indices_vector.emplace_back();
+            map->file_name = i.name.c_str();
+            map->map_name_index = i.index.value_or(13);
+            
+            if(sizeof(*map) >= sizeof(MapIndexRetail)) {
+                reinterpret_cast<MapIndexRetail *>(map)->loaded = 1;
+                
+                if(sizeof(*map) >= sizeof(MapIndexCustomEdition)) {
+                    reinterpret_cast<MapIndexCustomEdition *>(map)->crc32 = i.crc32.value_or(0xFFFFFFFF);
+                }
+            }
+        }
+        
+        // Only give Halo a new list if something changed
+        bool unchanged = *indices == indices_vector.data() && *count == indices_vector.size() && new_indices_vector.size() == indices_vector.size() && std::memcmp(new_indices_vector.data(), indices_vector.data(), indices_vector.size() * sizeof(MapIndexType)) == 0;
+        if(unchanged) {
+            return;
+        }
+        
+        indices_vector.swap(new_indices_vector);
+        *indices = indices_vector.data();
+        *count = indices_vector.size();
+    }
+    
+    void resync_map_list() {
+        auto engine = game_engine();
+
+        switch(engine) {
+            case GameEngine::GAME_ENGINE_CUSTOM_EDITION:
+                resync_map_list<MapIndexCustomEdition>();
+                break;
+            case GameEngine::GAME_ENGINE_RETAIL:
+                resync_map_list<MapIndexRetail>();
+                break;
+            case GameEngine::GAME_ENGINE_DEMO:
+                resync_map_list<MapIndex>();
+                break;
+        }
+        
+        save_map_catalog();
+    }
+    
+    MapEntry *get_map_entry(const char *map_name) {
+        auto map = all_maps_by_name.find(lowercase_map_name(map_name));
+        if(map == all_maps_by_name.end()) {
+            return nullptr;
+        }
+        return &all_maps[map->second];
+    }
+    
+    MapEntry &add_map_to_map_list(const char *map_name, std::optional<std::uint32_t> map_index) {
+        // Don't add maps we've already added
+        MapEntry *map;
+        if((map = get_map_entry(map_name)) != nullptr) {
+            return *map;
+        }
+        
+        // First, let's lowercase it
+        char map_name_lowercase[32] = {};
+        std::strncpy(map_name_lowercase, map_name, sizeof(map_name_lowercase) - 1);
+        
+        // Add it!
+        map = &all_maps.emplace_back();
+        map->name = map_name_lowercase;
+        map->index = map_index;
+        map->multiplayer = true;
+        all_maps_by_name.try_emplace(lowercase_map_name(map_name_lowercase), all_maps.size() - 1);
+        
+        // If it's known to not be a multiplayer map, set this
+        static const char *NON_MULTIPLAYER_MAPS[] = {
+            "a10",
+            "a30",
+            "a50",
+            "b30",
+            "b40",
+            "c10",
+            "c20",
+            "c40",
+            "d20",
+            "d40",
+            "ui"
+        };
+        for(auto &nmp : NON_MULTIPLAYER_MAPS) {
+            if(same_string_case_insensitive(nmp, map_name)) {
+                map->multiplayer = false;
+            }
+        }
+        
+        return *map;
+    }
+
+    /**
+     * Get the name of the map if the file is a map that can go in the map list
+     * @param path path to the file
+     * @return     name of the map if so
+     */
+    static std::optional<std::string> map_name_for_file(const std::filesystem::path &path) {
+        static const char *BLACKLISTED_MAPS[] = {
+            "bitmaps",
+            "sounds",
+            "loc",
+            "custom_bitmaps",
+            "custom_sounds",
+            "custom_loc"
+        };
+        
+        // Get extension
+        auto extension = path.extension().string();
+        if(!same_string_case_insensitive(extension.c_str(), ".map")) {
+            return std::nullopt;
+        }
+        
+        // Get name
+        auto name = path.stem().string();
+        
+        // Is it blacklisted?
+        for(auto &b : BLACKLISTED_MAPS) {
+            if(same_string_case_insensitive(name.c_str(), b)) {
+                return std::nullopt;
+            }
+        }
+        
+        return name;
+    }
+    
+    static std::vector<std::filesystem::path> map_folders() {
+        return { "maps", std::filesystem::path(get_chimera().get_path()) / "maps" };
+    }
+    
+    static void add_stock_maps() {
+        std::uint32_t stock_index = 0;
+        #define ADD_STOCK_MAP(map_name) add_map_to_map_list(map_name, stock_index++)
+        
+        if(game_engine() == GameEngine::GAME_ENGINE_DEMO) {
+            ADD_STOCK_MAP("bloodgulch");
+        }
+        else {
+            ADD_STOCK_MAP("beavercreek");
+            ADD_STOCK_MAP("sidewinder");
+            ADD_STOCK_MAP("damnation");
+            ADD_STOCK_MAP("ratrace");
+            ADD_STOCK_MAP("prisoner");
+            ADD_STOCK_MAP("hangemhigh");
+            ADD_STOCK_MAP("chillout");
+            ADD_STOCK_MAP("carousel");
+            ADD_STOCK_MAP("boardingaction");
+            ADD_STOCK_MAP("bloodgulch");
+            ADD_STOCK_MAP("wizard");
+            ADD_STOCK_MAP("putput");
+            ADD_STOCK_MAP("longest");
+            ADD_STOCK_MAP("icefields");
+            ADD_STOCK_MAP("deathisland");
+            ADD_STOCK_MAP("dangercanyon");
+            ADD_STOCK_MAP("infinity");
+            ADD_STOCK_MAP("timberland");
+            ADD_STOCK_MAP("gephyrophobia");
+        }
+    }
+    
+    static void fill_in_map_crc32s() {
+        // Fill in any CRC32s we have cached; the rest are calculated in the background
+        for(auto &i : all_maps) {
+            if(i.crc32.has_value() || !i.multiplayer) {
+                continue;
+            }
+            
+            auto path = i.get_file_path();
+            auto cached_crc32 = get_cached_map_crc32(path);
+            if(cached_crc32.has_value()) {
+                i.crc32 = cached_crc32;
+            }
+            else {
+                queue_map_crc32_calculation(i.name.c_str(), path);
+            }
+        }
+    }
+    
+    struct MapCatalogHeader {
+        static const std::uint32_t MAGIC = 0x4D434154;
+        static const std::uint32_t VERSION = 2;
+        
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t game_engine;
+        std::uint32_t map_count;
+    };
+    static_assert(sizeof(MapCatalogHeader) == 0x10);
+    
+    // CRC32s aren't kept here since the map could have been replaced since; they come from the CRC32 cache, which checks that
+    struct MapCatalogEntry {
+        static const std::uint8_t FLAG_MULTIPLAYER = 1;
+        static const std::uint8_t FLAG_INDEX = 4;
+        static const std::uint8_t FLAG_ENGINE = 8;
+        
+        char name[32];
+        std::uint64_t file_size;
+        std::int64_t file_time;
+        std::uint32_t engine;
+        std::uint32_t index;
+        std::uint8_t flags;
+        std::uint8_t padding[7];
+    };
+    static_assert(sizeof(MapCatalogEntry) == 0x40);
+    
+    // What's in the map catalog file so we only write it when something changed
+    static std::vector<std::byte> saved_map_catalog;
+    
+    static std::filesystem::path map_catalog_path() {
+        return std::filesystem::path(get_chimera().get_path()) / "map_catalog.bin";
+    }
+    
+    static std::vector<std::byte> make_map_catalog() {
+        std::vector<std::byte> catalog(sizeof(MapCatalogHeader) + all_maps.size() * sizeof(MapCatalogEntry));
+        auto &header = *reinterpret_cast<MapCatalogHeader *>(catalog.data());
+        header.magic = MapCatalogHeader::MAGIC;
+        header.version = MapCatalogHeader::VERSION;
+        header.game_engine = static_cast<std::uint32_t>(game_engine());
+        header.map_count = all_maps.size();
+        
+        auto *entries = reinterpret_cast<MapCatalogEntry *>(catalog.data() + sizeof(header));
+        for(std::size_t i = 0; i < all_maps.size(); i++) {
+            auto &map = all_maps[i];
+            auto &entry = entries[i];
+            std::strncpy(entry.name, map.name.c_str(), sizeof(entry.name) - 1);
+            entry.file_size = map.file_size;
+            entry.file_time = map.file_time;
+            entry.engine = map.engine.value_or(static_cast<CacheFileEngine>(0));
+            entry.index = map.index.value_or(0);
+            entry.flags = (map.multiplayer ? MapCatalogEntry::FLAG_MULTIPLAYER : 0) |
+                          (map.index.has_value() ? MapCatalogEntry::FLAG_INDEX : 0) |
+                          (map.engine.has_value() ? MapCatalogEntry::FLAG_ENGINE : 0);
+        }
+        
+        return catalog;
+    }
+    
+    static void save_map_catalog() noexcept {
+        auto catalog = make_map_catalog();
+        if(catalog == saved_map_catalog) {
+            return;
+        }
+        
+        // Write it somewhere else first so a crash doesn't leave a broken catalog
+        auto path = map_catalog_path();
+        auto temp_path = path;
+        temp_path += ".tmp";
+        std::FILE *f = std::fopen(temp_path.string().c_str(), "wb");
+        if(!f) {
+            return;
+        }
+        bool success = std::fwrite(catalog.data(), catalog.size(), 1, f) == 1;
+        success = std::fclose(f) == 0 && success;
+        
+        std::error_code ec;
+        if(success) {
+            std::filesystem::rename(temp_path, path, ec);
+        }
+        if(!success || ec) {
+            std::filesystem::remove(temp_path, ec);
+            return;
+        }
+        
+        saved_map_catalog = std::move(catalog);
+    }
+    
+    /**
+     * Replace the map list with what was in the map catalog when it was last saved
+     * @return true if the map catalog was loaded
+     */
+    static bool load_map_catalog() noexcept {
+        try {
+            MappedFile catalog(map_catalog_path());
+            auto *data = catalog.data();
+            auto size = catalog.size();
+            if(size < sizeof(MapCatalogHeader)) {
+                return false;
+            }
+            
+            auto &header = *reinterpret_cast<const MapCatalogHeader *>(data);
+            if(header.magic != MapCatalogHeader::MAGIC || header.version != MapCatalogHeader::VERSION || header.game_engine != static_cast<std::uint32_t>(game_engine()) || header.map_count != (size - sizeof(header)) / sizeof(MapCatalogEntry) || (size - sizeof(header)) % sizeof(MapCatalogEntry) != 0) {
+                return false;
+            }
+            
+            all_maps.clear();
+            all_maps_by_name.clear();
+            add_stock_maps();
+            
+            auto *entries = reinterpret_cast<const MapCatalogEntry *>(data + sizeof(header));
+            for(std::size_t i = 0; i < header.map_count; i++) {
+                auto &entry = entries[i];
+                char name[sizeof(entry.name) + 1] = {};
+                std::memcpy(name, entry.name, sizeof(entry.name));
+                
+                // Stock maps are already in the list, so this only adds custom maps
+                auto &map = add_map_to_map_list(name, (entry.flags & MapCatalogEntry::FLAG_INDEX) ? std::optional<std::uint32_t>(entry.index) : std::nullopt);
+                map.multiplayer = entry.flags & MapCatalogEntry::FLAG_MULTIPLAYER;
+                map.file_size = entry.file_size;
+                map.file_time = entry.file_time;
+                if(entry.flags & MapCatalogEntry::FLAG_ENGINE) {
+                    map.engine = static_cast<CacheFileEngine>(entry.engine);
+                }
+            }
+            
+            saved_map_catalog.assign(data, data + size);
+            return true;
+        }
+        catch(std::exception &) {
+            return false;
+        }
+    }
+    
+    struct ScannedMapFile {
+        std::string name;
+        std::uint64_t file_size;
+        long long file_time;
+        std::optional<CacheFileEngine> engine;
+        bool changed;
+    };
+    
+    struct KnownMapFile {
+        std::uint64_t file_size;
+        long long file_time;
+        bool engine_known;
+    };
+    
+    static std::mutex map_folder_scan_mutex;
+    static std::optional<std::vector<ScannedMapFile>> map_folder_scan;
+    
+    static std::optional<CacheFileEngine> read_map_engine(const std::filesystem::path &path) noexcept {
+        union {
+            MapHeaderDemo demo_header;
+            MapHeader fv_header;
+        } header;
+        
+        std::FILE *f = std::fopen(path.string().c_str(), "rb");
+        if(!f) {
+            return std::nullopt;
+        }
+        bool read = std::fread(&header, sizeof(header), 1, f) == 1;
+        std::fclose(f);
+        
+        if(!read) {
+            return std::nullopt;
+        }
+        else if(header.fv_header.is_valid()) {
+            return header.fv_header.engine_type;
+        }
+        else if(header.demo_header.is_valid()) {
+            return header.demo_header.engine_type;
+        }
+        return std::nullopt;
+    }
+    
+    static void scan_map_folders(std::vector<std::filesystem::path> folders, std::unordered_map<std::string, KnownMapFile> known) noexcept {
+        std::vector<ScannedMapFile> scanned;
+        std::unordered_map<std::string, std::size_t> scanned_by_name;
+        
+        for(auto &folder : folders) {
+            std::error_code ec;
+            for(auto &file : std::filesystem::directory_iterator(folder, ec)) {
+                std::error_code file_ec;
+                if(!file.is_regular_file(file_ec)) {
+                    continue;
+                }
+                
+                // If it's in both folders, the first one is used
+                auto name = map_name_for_file(file.path());
+                if(!name.has_value() || !scanned_by_name.try_emplace(lowercase_map_name(name->c_str()), scanned.size()).second) {
+                    continue;
+                }
+                
+                auto file_size = file.file_size(file_ec);
+                auto file_time = file.last_write_time(file_ec);
+                if(file_ec) {
+                    continue;
+                }
+                
+                auto &map = scanned.emplace_back();
+                map.name = std::move(*name);
+                map.file_size = file_size;
+                map.file_time = static_cast<long long>(file_time.time_since_epoch().count());
+                
+                // Only look inside maps we don't know about or that changed
+                auto k = known.find(lowercase_map_name(map.name.c_str()));
+                map.changed = k == known.end() || k->second.file_size != map.file_size || k->second.file_time != map.file_time;
+                if(map.changed || !k->second.engine_known) {
+                    map.changed = true;
+                    map.engine = read_map_engine(file.path());
+                }
+            }
+        }
+        
+        std::scoped_lock<std::mutex> lock(map_folder_scan_mutex);
+        map_folder_scan = std::move(scanned);
+    }
+    
+    static void apply_map_folder_scan() noexcept {
+        std::vector<ScannedMapFile> scanned;
+        {
+            std::scoped_lock<std::mutex> lock(map_folder_scan_mutex);
+            if(!map_folder_scan.has_value()) {
+                return;
+            }
+            scanned = std::move(*map_folder_scan);
+            map_folder_scan = std::nullopt;
+        }
+        remove_frame_event(apply_map_folder_scan);
+        
+        // Add new maps and forget the CRC32 of changed ones
+        std::vector<bool> found(all_maps.size());
+        for(auto &s : scanned) {
+            auto *map = get_map_entry(s.name.c_str());
+            if(map) {
+                std::size_t index = map - all_maps.data();
+                if(index < found.size()) {
+                    found[index] = true;
+                }
+            }
+            else {
+                map = &add_map_to_map_list(s.name.c_str());
+            }
+            
+            if(s.changed) {
+                if(map->file_size != s.file_size || map->file_time != s.file_time) {
+                    map->crc32 = std::nullopt;
+                }
+                map->file_size = s.file_size;
+                map->file_time = s.file_time;
+                map->engine = s.engine;
+            }
+        }
+        
+        // Remove custom maps that are gone
+        std::size_t i = 0;
+        auto removed = std::remove_if(all_maps.begin(), all_maps.end(), [&found, &i](const MapEntry &map) {
+            bool remove = i < found.size() && !found[i] && !map.index.has_value();
+            i++;
+            return remove;
+        });
+        if(removed != all_maps.end()) {
+            all_maps.erase(removed, all_maps.end());
+            reindex_map_list();
+        }
+        
+        fill_in_map_crc32s();
+        resync_map_list();
+    }
+    
+    static void reload_map_list() {
+        // Clear the bitch
+        auto old_maps = all_maps;
+        all_maps.clear();
+        all_maps_by_name.clear();
+        
+        add_stock_maps();
+        
+        auto add_map_folder = [](std::filesystem::path directory) {
+            for(auto &map : std::filesystem::directory_iterator(directory)) {
+                if(map.is_regular_file()) {
+                    auto name = map_name_for_file(map.path());
+                    if(name.has_value()) {
+                        auto &entry = add_map_to_map_list(name->c_str());
+                        if(entry.file_time == 0) {
+                            entry.file_size = map.file_size();
+                            entry.file_time = static_cast<long long>(map.last_write_time().time_since_epoch().count());
+                        }
+                    }
+                }
+            }
+        };
+        
+        for(auto &folder : map_folders()) {
+            add_map_folder(folder);
+        }
+        
+        // Reset CRC32 (unless the file changed, in which case it has to be calculated again)
+        for(auto &i : old_maps) {
+            auto *map = get_map_entry(i.name.c_str());
+            if(map && map->file_size == i.file_size && map->file_time == i.file_time) {
+                map->crc32 = i.crc32;
+                map->engine = i.engine;
+            }
+        }
+        
+        fill_in_map_crc32s();
+        resync_map_list();
+    }
+    
+    // Files changed in the maps folders that haven't been looked at yet
+    static std::mutex map_folder_changes_mutex;
+    static std::vector<std::string> map_folder_changes;
+    static bool map_folder_changes_overflowed = false;
+    static std::chrono::steady_clock::time_point map_folder_last_change;
+    
+    static void watch_map_folder(std::filesystem::path directory) noexcept {
+        auto handle = CreateFileW(directory.wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if(handle == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        
+        std::vector<DWORD> notifications(16 * 1024);
+        while(true) {
+            DWORD returned = 0;
+            if(!ReadDirectoryChangesW(handle, notifications.data(), notifications.size() * sizeof(DWORD), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, &returned, nullptr, nullptr)) {
+                break;
+            }
+            
+            std::scoped_lock<std::mutex> lock(map_folder_changes_mutex);
+            map_folder_last_change = std::chrono::steady_clock::now();
+            
+            // If nothing was returned, too much changed to fit, so we don't know what changed
+            if(returned == 0) {
+                map_folder_changes_overflowed = true;
+                continue;
+            }
+            
+            auto *notification_bytes = reinterpret_cast<const std::byte *>(notifications.data());
+            while(true) {
+                auto *notification = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(notification_bytes);
+                int name_length = static_cast<int>(notification->FileNameLength / sizeof(WCHAR));
+                int narrow_length = WideCharToMultiByte(CP_ACP, 0, notification->FileName, name_length, nullptr, 0, nullptr, nullptr);
+                if(narrow_length > 0) {
+                    std::string name(static_cast<std::size_t>(narrow_length), '\0');
+                    WideCharToMultiByte(CP_ACP, 0, notification->FileName, name_length, name.data(), narrow_length, nullptr, nullptr);
+                    map_folder_changes.emplace_back(std::move(name));
+                }
+                
+                if(notification->NextEntryOffset == 0) {
+                    break;
+                }
+                notification_bytes += notification->NextEntryOffset;
+            }
+        }
+        
+        CloseHandle(handle);
+    }
+    
+    /**
+     * Update the map list for a file that changed in one of the maps folders
+     * @param file_name name of the file that changed
+     * @return          true if the map list changed
+     */
+    static bool update_map_list_for_file(const std::string &file_name) {
+        auto name = map_name_for_file(file_name);
+        if(!name.has_value()) {
+            return false;
+        }
+        
+        bool exists = false;
+        for(auto &folder : map_folders()) {
+            std::error_code ec;
+            if(std::filesystem::is_regular_file(folder / file_name, ec)) {
+                exists = true;
+                break;
+            }
+        }
+        
+        auto *entry = get_map_entry(name->c_str());
+        
+        // Stock maps stay in the list even if they're missing
+        if(!exists) {
+            if(!entry || entry->index.has_value()) {
+                return false;
+            }
+            all_maps.erase(all_maps.begin() + (entry - all_maps.data()));
+            reindex_map_list();
+            return true;
+        }
+        
+        bool changed = false;
+        if(!entry) {
+            entry = &add_map_to_map_list(name->c_str());
+            changed = true;
+        }
+        
+        auto path = entry->get_file_path();
+        std::error_code size_ec, time_ec;
+        auto file_size = std::filesystem::file_size(path, size_ec);
+        auto file_time = std::filesystem::last_write_time(path, time_ec);
+        if(!size_ec && !time_ec && (entry->file_size != file_size || entry->file_time != static_cast<long long>(file_time.time_since_epoch().count()))) {
+            entry->file_size = file_size;
+            entry->file_time = static_cast<long long>(file_time.time_since_epoch().count());
+            entry->engine = read_map_engine(path);
+        }
+        
+        // If it was replaced, we need a new CRC32
+        if(entry->multiplayer) {
+            auto cached_crc32 = get_cached_map_crc32(path);
+            if(cached_crc32 != entry->crc32) {
+                entry->crc32 = cached_crc32;
+                changed = true;
+            }
+            if(!cached_crc32.has_value()) {
+                queue_map_crc32_calculation(entry->name.c_str(), path);
+            }
+        }
+        
+        return changed;
+    }
+    
+    static void apply_map_folder_changes() noexcept {
+        std::vector<std::string> changes;
+        bool overflowed;
+        {
+            // Wait for things to settle down so we don't look at maps that are still being copied
+            std::scoped_lock<std::mutex> lock(map_folder_changes_mutex);
+            if((map_folder_changes.empty() && !map_folder_changes_overflowed) || std::chrono::steady_clock::now() - map_folder_last_change < std::chrono::milliseconds(500)) {
+                return;
+            }
+            changes.swap(map_folder_changes);
+            overflowed = map_folder_changes_overflowed;
+            map_folder_changes_overflowed = false;
+        }
+        
+        if(overflowed) {
+            reload_map_list();
+            return;
+        }
+        
+        // The same file usually shows up several times
+        std::sort(changes.begin(), changes.end());
+        changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+        
+        bool changed = false;
+        for(auto &c : changes) {
+            changed = update_map_list_for_file(c) || changed;
+        }
+        if(changed) {
+            resync_map_list();
+        }
+    }
+
+    void reload_map_list_frame() noexcept {
+        remove_frame_event(reload_map_list_frame);
+        
+        // Give Halo the maps we had last time right away, then check for changes in the background
+        if(load_map_catalog()) {
+            fill_in_map_crc32s();
+            resync_map_list();
+        }
+        else {
+            reload_map_list();
+        }
+        
+        // Keep the list up to date when maps are added, removed, or replaced
+        auto folders = map_folders();
+        std::error_code ec;
+        if(std::filesystem::equivalent(folders[0], folders[1], ec)) {
+            folders.pop_back();
+        }
+        for(auto &folder : folders) {
+            std::thread(watch_map_folder, folder).detach();
+        }
+        add_frame_event(apply_map_folder_changes);
+        
+        std::unordered_map<std::string, KnownMapFile> known;
+        for(auto &map : all_maps) {
+            known.try_emplace(lowercase_map_name(map.name.c_str()), KnownMapFile { map.file_size, map.file_time, map.engine.has_value() });
+        }
+        std::thread(scan_map_folders, map_folders(), std::move(known)).detach();
+        add_frame_event(apply_map_folder_scan);
+    }
+}
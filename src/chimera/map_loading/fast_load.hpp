@@ -17,6 +17,8 @@ namespace Chimera {
         std::optional<CacheFileEngine> engine;
         std::string name;
         std::optional<std::uint32_t> index;
+        std::uint64_t file_size = 0;
+        long long file_time = 0;
         
         std::filesystem::path get_file_path();
     };
@@ -38,7 +40,7 @@ namespace Chimera {
     MapEntry &add_map_to_map_list(const char *map_name, std::optional<std::uint32_t> name_index = std::nullopt);
     
     /**
-     * Resync the map list in the game with our own map list
+     * Resync the map list in the game with our own map list if anything changed
      */
     void resync_map_list();
     
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+
+#include "map_buffer.hpp"
+
+namespace Chimera {
+    const MapBuffer::Region *MapBuffer::find(const std::string &name) const noexcept {
+        for(auto &r : this->p_regions) {
+            if(r.name == name) {
+                return &r;
+            }
+        }
+        return nullptr;
+    }
+
+    void MapBuffer::use(const std::string &name) noexcept {
+        for(auto &r : this->p_regions) {
+            if(r.name == name) {
+                r.last_used = ++this->p_clock;
+                this->p_statistics.hits++;
+                return;
+            }
+        }
+    }
+
+    std::size_t MapBuffer::available(const std::vector<std::string> &pinned) const noexcept {
+        std::size_t available = this->p_capacity;
+        for(auto &r : this->p_regions) {
+            if(std::find(pinned.begin(), pinned.end(), r.name) != pinned.end()) {
+                available -= r.map_size;
+            }
+        }
+        return available;
+    }
+
+    std::optional<std::size_t> MapBuffer::allocate(const std::string &name, std::size_t size, const std::vector<std::string> &pinned, const MapBufferEvents &events) {
+        this->free(name);
+
+        // Don't evict anything if it won't fit anyway
+        if(size > this->available(pinned)) {
+            return std::nullopt;
+        }
+        this->p_statistics.misses++;
+
+        while(true) {
+            // Use the biggest gap so there's as much room as possible to preload stuff after the map
+            std::size_t best_offset = 0;
+            std::size_t best_gap = 0;
+            std::size_t previous_end = 0;
+            for(std::size_t i = 0; i <= this->p_regions.size(); i++) {
+                std::size_t next_start = i < this->p_regions.size() ? this->p_regions[i].offset : this->p_capacity;
+                if(next_start - previous_end > best_gap || i == 0) {
+                    best_gap = next_start - previous_end;
+                    best_offset = previous_end;
+                }
+                if(i < this->p_regions.size()) {
+                    previous_end = this->p_regions[i].offset + this->p_regions[i].size;
+                }
+            }
+
+            if(best_gap >= size) {
+                Region region = { name, best_offset, size, size, ++this->p_clock };
+                auto position = std::upper_bound(this->p_regions.begin(), this->p_regions.end(), best_offset, [](std::size_t offset, const Region &r) { return offset < r.offset; });
+                this->p_regions.insert(position, std::move(region));
+                return best_offset;
+            }
+
+            std::vector<Region *> lru_order;
+            std::size_t free_space = this->p_capacity;
+            for(auto &r : this->p_regions) {
+                free_space -= r.size;
+                lru_order.push_back(&r);
+            }
+            std::sort(lru_order.begin(), lru_order.end(), [](const Region *a, const Region *b) { return a->last_used < b->last_used; });
+
+            // Preloaded data is cheaper to lose than a whole map, so drop that first, and then move everything together
+            std::size_t preloaded_space = 0;
+            for(auto *r : lru_order) {
+                preloaded_space += r->size - r->map_size;
+            }
+            if(free_space + preloaded_space >= size) {
+                for(auto *r : lru_order) {
+                    if(free_space >= size) {
+                        break;
+                    }
+                    if(r->size > r->map_size) {
+                        events.discard(r->offset + r->map_size, r->size - r->map_size);
+                        free_space += r->size - r->map_size;
+                        r->size = r->map_size;
+                    }
+                }
+                this->compact(events);
+                continue;
+            }
+
+            // Otherwise evict the least recently used map
+            auto victim = std::find_if(lru_order.begin(), lru_order.end(), [&pinned](const Region *r) {
+                return std::find(pinned.begin(), pinned.end(), r->name) == pinned.end();
+            });
+            if(victim == lru_order.end()) {
+                return std::nullopt;
+            }
+            auto victim_name = (*victim)->name;
+            events.discard((*victim)->offset, (*victim)->size);
+            this->free(victim_name);
+            events.evict(victim_name);
+            this->p_statistics.evictions++;
+        }
+    }
+
+    std::size_t MapBuffer::space(const std::string &name) const noexcept {
+        for(std::size_t i = 0; i < this->p_regions.size(); i++) {
+            if(this->p_regions[i].name == name) {
+                std::size_t next_start = i + 1 < this->p_regions.size() ? this->p_regions[i + 1].offset : this->p_capacity;
+                return next_start - this->p_regions[i].offset;
+            }
+        }
+        return 0;
+    }
+
+    void MapBuffer::set_size(const std::string &name, std::size_t size) noexcept {
+        auto space = this->space(name);
+        for(auto &r : this->p_regions) {
+            if(r.name == name) {
+                r.size = std::min(std::max(size, r.map_size), space);
+                return;
+            }
+        }
+    }
+
+    void MapBuffer::free(const std::string &name) noexcept {
+        this->p_regions.erase(std::remove_if(this->p_regions.begin(), this->p_regions.end(), [&name](const Region &r) { return r.name == name; }), this->p_regions.end());
+    }
+
+    void MapBuffer::compact(const MapBufferEvents &events) {
+        std::size_t cursor = 0;
+        bool moved = false;
+        for(auto &r : this->p_regions) {
+            if(r.offset != cursor) {
+                if(r.size > r.map_size) {
+                    events.discard(r.offset + r.map_size, r.size - r.map_size);
+                    r.size = r.map_size;
+                }
+                events.move(r.name, r.offset, cursor, r.size);
+                r.offset = cursor;
+                moved = true;
+            }
+            cursor += r.size;
+        }
+        if(moved) {
+            this->p_statistics.compactions++;
+        }
+    }
+}
@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAP_BUFFER_HPP
+#define CHIMERA_MAP_BUFFER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Chimera {
+    /**
+     * Called when space in the map buffer is about to be reused
+     */
+    struct MapBufferEvents {
+        /** A map is being evicted, so it's no longer in memory */
+        std::function<void(const std::string &name)> evict;
+
+        /** Whatever is in this range is going away (called before evicting a map or dropping what was preloaded after it) */
+        std::function<void(std::size_t offset, std::size_t size)> discard;
+
+        /** A map needs moved to make room; its data has to be copied from one offset to the other (the ranges may overlap) */
+        std::function<void(const std::string &name, std::size_t from, std::size_t to, std::size_t size)> move;
+    };
+
+    /**
+     * Keeps track of which maps are where in the map memory buffer so several can be kept in memory at once
+     */
+    class MapBuffer {
+    public:
+        struct Region {
+            /** Name of the map */
+            std::string name;
+
+            /** Where the map is in the buffer */
+            std::size_t offset;
+
+            /** Size of the map itself */
+            std::size_t map_size;
+
+            /** Size of the map and anything preloaded after it; anything after map_size can be dropped if space is needed */
+            std::size_t size;
+
+            /** When this was last used; higher is more recent */
+            unsigned long long last_used;
+        };
+
+        struct Statistics {
+            /** Maps that were already in the buffer when loaded */
+            std::size_t hits = 0;
+
+            /** Maps that had to be read into the buffer */
+            std::size_t misses = 0;
+
+            /** Maps evicted to make room */
+            std::size_t evictions = 0;
+
+            /** Times maps had to be moved to make room */
+            std::size_t compactions = 0;
+        };
+
+        /**
+         * Set the size of the buffer; this should only be done before anything is allocated
+         * @param capacity size of the buffer in bytes
+         */
+        void set_capacity(std::size_t capacity) noexcept {
+            this->p_capacity = capacity;
+        }
+
+        /**
+         * Get the size of the buffer
+         * @return size of the buffer in bytes
+         */
+        std::size_t capacity() const noexcept {
+            return this->p_capacity;
+        }
+
+        /**
+         * Find the map in the buffer
+         * @param name name of the map
+         * @return     region of the map if it's in the buffer, or nullptr
+         */
+        const Region *find(const std::string &name) const noexcept;
+
+        /**
+         * Mark the map as used, counting it as a hit
+         * @param name name of the map
+         */
+        void use(const std::string &name) noexcept;
+
+        /**
+         * Get how big of a map could fit if everything that isn't pinned were evicted
+         * @param pinned maps that can't be evicted
+         * @return       size in bytes
+         */
+        std::size_t available(const std::vector<std::string> &pinned) const noexcept;
+
+        /**
+         * Make room for a map, dropping preloaded data, moving maps, and evicting the least recently used maps as needed
+         * @param name   name of the map
+         * @param size   size of the map
+         * @param pinned maps that can't be evicted
+         * @param events what to do when space is reused
+         * @return       offset of the map if it fits
+         */
+        std::optional<std::size_t> allocate(const std::string &name, std::size_t size, const std::vector<std::string> &pinned, const MapBufferEvents &events);
+
+        /**
+         * Get how much space the map can use without moving anything
+         * @param name name of the map
+         * @return     space from the start of the map to the next map or the end of the buffer
+         */
+        std::size_t space(const std::string &name) const noexcept;
+
+        /**
+         * Set how much of the buffer the map uses, including anything preloaded after it
+         * @param name name of the map
+         * @param size size in bytes; this is clamped so it's at least the size of the map and fits before the next map
+         */
+        void set_size(const std::string &name, std::size_t size) noexcept;
+
+        /**
+         * Remove the map from the buffer
+         * @param name name of the map
+         */
+        void free(const std::string &name) noexcept;
+
+        /**
+         * Get the maps in the buffer
+         * @return maps ordered by offset
+         */
+        const std::vector<Region> &regions() const noexcept {
+            return this->p_regions;
+        }
+
+        /**
+         * Get hit/miss statistics
+         * @return statistics
+         */
+        const Statistics &statistics() const noexcept {
+            return this->p_statistics;
+        }
+
+    private:
+        /** Maps in the buffer, ordered by offset */
+        std::vector<Region> p_regions;
+
+        /** Size of the buffer */
+        std::size_t p_capacity = 0;
+
+        /** Incremented every time a map is used */
+        unsigned long long p_clock = 0;
+
+        /** Statistics */
+        Statistics p_statistics;
+
+        /**
+         * Move every map to the start of the buffer so all of the free space is at the end, dropping preloaded data of any map that is moved
+         * @param events what to do when space is reused
+         */
+        void compact(const MapBufferEvents &events);
+    };
+}
+
+#endif
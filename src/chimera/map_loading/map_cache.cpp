@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "../chimera.hpp"
+#include "../halo_data/map.hpp"
+#include "crc32.hpp"
+#include "crc32_cache.hpp"
+#include "map_cache.hpp"
+
+namespace Chimera {
+    // Compressed maps are identified by their size, modification time, and the CRC32 of their header (which has the decompressed
+    // map's CRC32 and size in it), so the whole map doesn't have to be read to find it
+    struct MapCacheEntry {
+        /** CRC32 of the compressed map's header */
+        std::uint32_t crc32;
+
+        /** Size of the compressed map */
+        unsigned long long compressed_size;
+
+        /** Size of the decompressed map */
+        unsigned long long decompressed_size;
+
+        /** When this was last used; higher is more recent */
+        unsigned long long last_used;
+
+        /** Modification time of the compressed map when it was last seen */
+        long long source_timestamp;
+
+        /** Key of the path to the compressed map when it was last seen */
+        std::string source_key;
+    };
+
+    static std::vector<MapCacheEntry> map_cache;
+    static bool map_cache_loaded = false;
+    static std::uint64_t map_cache_size = 0;
+    static unsigned long long map_cache_clock = 0;
+
+    // Maps can be decompressed into the cache in the background
+    static std::mutex map_cache_mutex;
+
+    // Map being decompressed into the cache
+    static std::optional<MapCacheEntry> pending_map;
+
+    static std::filesystem::path map_cache_directory() {
+        return std::filesystem::path(get_chimera().get_path()) / "tmp";
+    }
+
+    static std::filesystem::path map_cache_index_path() {
+        return map_cache_directory() / "map_cache.txt";
+    }
+
+    static std::filesystem::path path_for_entry(const MapCacheEntry &entry) {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%08lX-%llu-%llX.map", static_cast<unsigned long>(entry.crc32), entry.compressed_size, static_cast<unsigned long long>(entry.source_timestamp));
+        return map_cache_directory() / name;
+    }
+
+    static void save_map_cache() noexcept {
+        std::error_code ec;
+        std::filesystem::create_directories(map_cache_directory(), ec);
+
+        std::ofstream f(map_cache_index_path(), std::ios_base::out | std::ios_base::trunc);
+        for(auto &entry : map_cache) {
+            char prefix[128];
+            std::snprintf(prefix, sizeof(prefix), "%08lX %llu %llu %llu %lld ", static_cast<unsigned long>(entry.crc32), entry.compressed_size, entry.decompressed_size, entry.last_used, entry.source_timestamp);
+            f << prefix << entry.source_key << "\n";
+        }
+    }
+
+    static void load_map_cache() noexcept {
+        if(map_cache_loaded) {
+            return;
+        }
+        map_cache_loaded = true;
+
+        // Each line is the CRC32 and size of the compressed map, the size of the decompressed map, when it was last used, and the timestamp followed by the path of the compressed map
+        std::ifstream f(map_cache_index_path());
+        std::string line;
+        bool changed = false;
+        while(std::getline(f, line)) {
+            while(!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+                line.pop_back();
+            }
+
+            unsigned long crc32;
+            MapCacheEntry entry;
+            int path_offset = 0;
+            if(std::sscanf(line.c_str(), "%lx %llu %llu %llu %lld %n", &crc32, &entry.compressed_size, &entry.decompressed_size, &entry.last_used, &entry.source_timestamp, &path_offset) != 5 || path_offset <= 0) {
+                changed = true;
+                continue;
+            }
+            entry.crc32 = static_cast<std::uint32_t>(crc32);
+            entry.source_key = line.substr(path_offset);
+
+            // If it's missing or the wrong size, forget about it
+            std::error_code ec;
+            auto file_size = std::filesystem::file_size(path_for_entry(entry), ec);
+            if(ec || file_size != entry.decompressed_size) {
+                changed = true;
+                continue;
+            }
+
+            map_cache_clock = std::max(map_cache_clock, entry.last_used);
+            map_cache.emplace_back(std::move(entry));
+        }
+        f.close();
+
+        // Delete anything that isn't in the cache, such as maps from an interrupted decompression or old tmp_#.map files
+        std::error_code ec;
+        for(auto &file : std::filesystem::directory_iterator(map_cache_directory(), ec)) {
+            auto &path = file.path();
+            if(path.extension() != ".map") {
+                continue;
+            }
+            bool cached = std::find_if(map_cache.begin(), map_cache.end(), [&path](const MapCacheEntry &entry) { return path_for_entry(entry).filename() == path.filename(); }) != map_cache.end();
+            if(!cached) {
+                std::error_code remove_ec;
+                std::filesystem::remove(path, remove_ec);
+            }
+        }
+
+        if(changed) {
+            save_map_cache();
+        }
+    }
+
+    static std::optional<std::uint32_t> crc32_of_header(const std::filesystem::path &path) noexcept {
+        std::FILE *f = std::fopen(path.string().c_str(), "rb");
+        if(!f) {
+            return std::nullopt;
+        }
+
+        std::byte header[sizeof(MapHeader)];
+        bool success = std::fread(header, sizeof(header), 1, f) == 1;
+        std::fclose(f);
+
+        if(!success) {
+            return std::nullopt;
+        }
+        return crc32(0, header, sizeof(header));
+    }
+
+    // Get what the entry for the compressed map would be
+    static std::optional<MapCacheEntry> entry_for_compressed_map(const std::filesystem::path &compressed_path, std::size_t decompressed_size) noexcept {
+        std::error_code ec;
+        auto compressed_size = std::filesystem::file_size(compressed_path, ec);
+        if(ec) {
+            return std::nullopt;
+        }
+        auto timestamp = std::filesystem::last_write_time(compressed_path, ec);
+        if(ec) {
+            return std::nullopt;
+        }
+
+        MapCacheEntry entry = {};
+        entry.compressed_size = compressed_size;
+        entry.decompressed_size = decompressed_size;
+        entry.source_timestamp = static_cast<long long>(timestamp.time_since_epoch().count());
+        entry.source_key = map_path_key(compressed_path);
+
+        auto crc32 = crc32_of_header(compressed_path);
+        if(!crc32.has_value()) {
+            return std::nullopt;
+        }
+        entry.crc32 = *crc32;
+        return entry;
+    }
+
+    static std::vector<MapCacheEntry>::iterator find_entry(const MapCacheEntry &entry) noexcept {
+        return std::find_if(map_cache.begin(), map_cache.end(), [&entry](const MapCacheEntry &other) {
+            return other.crc32 == entry.crc32 && other.compressed_size == entry.compressed_size && other.source_timestamp == entry.source_timestamp;
+        });
+    }
+
+    // Evict the least recently used maps until a map of this size fits; the mutex must be locked
+    static void evict_cached_decompressed_maps(std::size_t decompressed_size, const std::vector<std::filesystem::path> &keep) noexcept {
+        // If it doesn't fit on its own, it's allowed to go over until the next map is loaded
+        std::uint64_t total_size = decompressed_size;
+        for(auto &i : map_cache) {
+            total_size += i.decompressed_size;
+        }
+        std::vector<MapCacheEntry *> eviction_order;
+        for(auto &i : map_cache) {
+            eviction_order.push_back(&i);
+        }
+        std::sort(eviction_order.begin(), eviction_order.end(), [](const MapCacheEntry *a, const MapCacheEntry *b) { return a->last_used < b->last_used; });
+
+        std::vector<std::filesystem::path> evicted;
+        for(auto *i : eviction_order) {
+            if(total_size <= map_cache_size) {
+                break;
+            }
+            auto evict_path = path_for_entry(*i);
+            if(std::find(keep.begin(), keep.end(), evict_path) != keep.end()) {
+                continue;
+            }
+
+            // If it can't be deleted, it's probably still open
+            std::error_code ec;
+            std::filesystem::remove(evict_path, ec);
+            if(ec) {
+                continue;
+            }
+            total_size -= i->decompressed_size;
+            evicted.emplace_back(std::move(evict_path));
+        }
+        map_cache.erase(std::remove_if(map_cache.begin(), map_cache.end(), [&evicted](const MapCacheEntry &entry) {
+            return std::find(evicted.begin(), evicted.end(), path_for_entry(entry)) != evicted.end();
+        }), map_cache.end());
+    }
+
+    void set_map_cache_size(std::uint64_t size) noexcept {
+        map_cache_size = size;
+    }
+
+    bool map_cache_enabled() noexcept {
+        return map_cache_size > 0;
+    }
+
+    std::optional<std::filesystem::path> find_cached_decompressed_map(const std::filesystem::path &compressed_path, std::size_t decompressed_size) noexcept {
+        if(!map_cache_enabled()) {
+            return std::nullopt;
+        }
+        std::scoped_lock<std::mutex> lock(map_cache_mutex);
+        load_map_cache();
+
+        auto entry = entry_for_compressed_map(compressed_path, decompressed_size);
+        if(!entry.has_value()) {
+            return std::nullopt;
+        }
+        auto cached = find_entry(*entry);
+        if(cached == map_cache.end()) {
+            return std::nullopt;
+        }
+
+        // Make sure it's still intact
+        auto path = path_for_entry(*cached);
+        union {
+            MapHeaderDemo demo_header;
+            MapHeader fv_header;
+        } header;
+        std::error_code ec;
+        bool intact = cached->decompressed_size == decompressed_size && std::filesystem::file_size(path, ec) == decompressed_size && !ec;
+        if(intact) {
+            std::FILE *f = std::fopen(path.string().c_str(), "rb");
+            intact = f && std::fread(&header, sizeof(header), 1, f) == 1 && (header.fv_header.is_valid() || header.demo_header.is_valid());
+            if(f) {
+                std::fclose(f);
+            }
+        }
+        if(!intact) {
+            std::filesystem::remove(path, ec);
+            map_cache.erase(cached);
+            save_map_cache();
+            return std::nullopt;
+        }
+
+        // Remember where we saw it last
+        cached->source_key = entry->source_key;
+        cached->last_used = ++map_cache_clock;
+        save_map_cache();
+
+        return path;
+    }
+
+    std::optional<std::filesystem::path> reserve_cached_decompressed_map(const std::filesystem::path &compressed_path, std::size_t decompressed_size, const std::vector<std::filesystem::path> &keep) noexcept {
+        if(!map_cache_enabled()) {
+            return std::nullopt;
+        }
+        std::scoped_lock<std::mutex> lock(map_cache_mutex);
+        load_map_cache();
+
+        auto entry = entry_for_compressed_map(compressed_path, decompressed_size);
+        if(!entry.has_value()) {
+            return std::nullopt;
+        }
+        auto path = path_for_entry(*entry);
+
+        // If there's already an entry for it, it's being redone
+        auto existing = find_entry(*entry);
+        if(existing != map_cache.end()) {
+            map_cache.erase(existing);
+        }
+
+        evict_cached_decompressed_maps(decompressed_size, keep);
+        save_map_cache();
+
+        pending_map = entry;
+        return path;
+    }
+
+    void finish_cached_decompressed_map(const std::filesystem::path &compressed_path, bool success) noexcept {
+        std::scoped_lock<std::mutex> lock(map_cache_mutex);
+        if(!pending_map.has_value() || pending_map->source_key != map_path_key(compressed_path)) {
+            return;
+        }
+
+        if(success) {
+            pending_map->last_used = ++map_cache_clock;
+            map_cache.emplace_back(std::move(*pending_map));
+            save_map_cache();
+        }
+        else {
+            std::error_code ec;
+            std::filesystem::remove(path_for_entry(*pending_map), ec);
+        }
+
+        pending_map = std::nullopt;
+    }
+
+    bool add_decompressed_map_to_cache(const std::filesystem::path &compressed_path, const std::filesystem::path &decompressed_path, const std::vector<std::filesystem::path> &keep) noexcept {
+        std::error_code ec;
+        if(!map_cache_enabled()) {
+            std::filesystem::remove(decompressed_path, ec);
+            return false;
+        }
+        std::scoped_lock<std::mutex> lock(map_cache_mutex);
+        load_map_cache();
+
+        std::optional<MapCacheEntry> found_entry;
+        auto decompressed_size = std::filesystem::file_size(decompressed_path, ec);
+        if(!ec) {
+            found_entry = entry_for_compressed_map(compressed_path, decompressed_size);
+        }
+        if(!found_entry.has_value()) {
+            std::filesystem::remove(decompressed_path, ec);
+            return false;
+        }
+        auto &entry = *found_entry;
+        entry.last_used = ++map_cache_clock;
+
+        // If we already have it, just remember where this copy is
+        auto existing = find_entry(entry);
+        if(existing != map_cache.end()) {
+            *existing = entry;
+            save_map_cache();
+            std::filesystem::remove(decompressed_path, ec);
+            return true;
+        }
+
+        evict_cached_decompressed_maps(entry.decompressed_size, keep);
+
+        std::filesystem::create_directories(map_cache_directory(), ec);
+        std::filesystem::rename(decompressed_path, path_for_entry(entry), ec);
+        if(ec) {
+            std::filesystem::remove(decompressed_path, ec);
+            save_map_cache();
+            return false;
+        }
+        map_cache.emplace_back(std::move(entry));
+        save_map_cache();
+        return true;
+    }
+}
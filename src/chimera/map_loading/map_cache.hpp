@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAP_CACHE_HPP
+#define CHIMERA_MAP_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+#include <vector>
+
+namespace Chimera {
+    /**
+     * Set the maximum combined size of decompressed maps kept in the map cache
+     * @param size maximum size in bytes (0 = disabled); this can be more than fits in memory
+     */
+    void set_map_cache_size(std::uint64_t size) noexcept;
+
+    /**
+     * Get whether the map cache is enabled
+     * @return true if enabled
+     */
+    bool map_cache_enabled() noexcept;
+
+    /**
+     * Find a decompressed copy of a compressed map in the map cache, marking it as the most recently used
+     * @param compressed_path path to the compressed map
+     * @param decompressed_size size of the map once decompressed
+     * @return                  path to the decompressed copy if it's cached and intact
+     */
+    std::optional<std::filesystem::path> find_cached_decompressed_map(const std::filesystem::path &compressed_path, std::size_t decompressed_size) noexcept;
+
+    /**
+     * Get a path in the map cache to decompress a compressed map to, evicting the least recently used maps to make room
+     * @param compressed_path   path to the compressed map
+     * @param decompressed_size size of the map once decompressed
+     * @param keep              paths that must not be evicted
+     * @return                  path to decompress to, or nothing if the map cache is disabled or the map could not be read
+     */
+    std::optional<std::filesystem::path> reserve_cached_decompressed_map(const std::filesystem::path &compressed_path, std::size_t decompressed_size, const std::vector<std::filesystem::path> &keep) noexcept;
+
+    /**
+     * Add the map to the map cache once it was decompressed to the path given by reserve_cached_decompressed_map()
+     * @param compressed_path path to the compressed map
+     * @param success         false if decompression failed, in which case the reserved file is deleted
+     */
+    void finish_cached_decompressed_map(const std::filesystem::path &compressed_path, bool success) noexcept;
+
+    /**
+     * Move a map that was already decompressed somewhere else into the map cache, evicting the least recently used maps to make room
+     * @param compressed_path   path to the compressed map
+     * @param decompressed_path path to the decompressed map; it's moved into the map cache, or deleted if it can't be
+     * @param keep              paths that must not be evicted
+     * @return                  true if the map is now in the map cache
+     */
+    bool add_decompressed_map_to_cache(const std::filesystem::path &compressed_path, const std::filesystem::path &decompressed_path, const std::vector<std::filesystem::path> &keep) noexcept;
+}
+
+#endif
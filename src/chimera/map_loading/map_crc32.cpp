@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "map_crc32.hpp"
+
+namespace Chimera {
+    std::uint32_t tag_data_address_for_engine(CacheFileEngine engine) noexcept {
+        switch(engine) {
+            case CacheFileEngine::CACHE_FILE_DEMO:
+                return 0x4BF10000;
+            default:
+                return 0x40440000;
+        }
+    }
+
+    std::optional<std::uint32_t> calculate_map_crc32(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_data_offset, std::uint32_t tag_data_address, const MapRegionCRC32 &region_crc32) noexcept {
+        std::uint32_t crc = 0;
+
+        // Get a pointer into the tag data if the whole thing is in there; maps that didn't come from Halo can't be trusted
+        auto in_tag_data = [&tag_data, &tag_data_size](std::uint64_t offset, std::uint64_t size) -> const std::byte * {
+            if(offset > tag_data_size || size > tag_data_size - offset) {
+                return nullptr;
+            }
+            return tag_data + offset;
+        };
+        auto read_address = [&tag_data_address](const std::byte *address) -> std::uint64_t {
+            return static_cast<std::uint32_t>(*reinterpret_cast<const std::uint32_t *>(address) - tag_data_address);
+        };
+        if(!in_tag_data(0, 0x24)) {
+            return std::nullopt;
+        }
+
+        // Get the scenario tag so we can get the BSPs
+        auto *scenario_tag = in_tag_data(read_address(tag_data) + (*reinterpret_cast<const std::uint32_t *>(tag_data + 4) & 0xFFFF) * 0x20ULL, 0x20);
+        if(!scenario_tag) {
+            return std::nullopt;
+        }
+        auto *scenario_tag_data = in_tag_data(read_address(scenario_tag + 0x14), 0x5A4 + 0xC);
+        if(!scenario_tag_data) {
+            return std::nullopt;
+        }
+
+        // CRC32 the BSP(s)
+        auto &structure_bsp_count = *reinterpret_cast<const std::uint32_t *>(scenario_tag_data + 0x5A4);
+        auto *structure_bsps = in_tag_data(read_address(scenario_tag_data + 0x5A4 + 4), static_cast<std::uint64_t>(structure_bsp_count) * 0x20);
+        if(!structure_bsps) {
+            return std::nullopt;
+        }
+        for(std::size_t b=0;b<structure_bsp_count;b++) {
+            auto *bsp = structure_bsps + b * 0x20;
+            auto &bsp_offset = *reinterpret_cast<const std::uint32_t *>(bsp);
+            auto &bsp_size = *reinterpret_cast<const std::uint32_t *>(bsp + 4);
+            if(!region_crc32(crc, bsp_offset, bsp_size)) {
+                return std::nullopt;
+            }
+        }
+
+        // Next, CRC32 the model data
+        auto &model_vertices_offset = *reinterpret_cast<const std::uint32_t *>(tag_data + 0x14);
+        auto &vertices_size = *reinterpret_cast<const std::uint32_t *>(tag_data + 0x20);
+        if(!region_crc32(crc, model_vertices_offset, vertices_size)) {
+            return std::nullopt;
+        }
+
+        // Lastly, CRC32 the tag data itself
+        if(!region_crc32(crc, tag_data_offset, tag_data_size)) {
+            return std::nullopt;
+        }
+
+        return crc;
+    }
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAP_CRC32_HPP
+#define CHIMERA_MAP_CRC32_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include "../halo_data/map.hpp"
+
+namespace Chimera {
+    /**
+     * Function that chains the CRC32 of a region of the map onto crc
+     * @param crc    CRC32 to chain onto; set to the new CRC32
+     * @param offset offset of the region in the map
+     * @param size   size of the region
+     * @return       true if successful, false if the region could not be read
+     */
+    using MapRegionCRC32 = std::function<bool (std::uint32_t &crc, std::size_t offset, std::size_t size)>;
+
+    /**
+     * Get the address tag data is loaded to for the engine
+     * @param engine engine of the (decompressed) map
+     * @return       address of the tag data
+     */
+    std::uint32_t tag_data_address_for_engine(CacheFileEngine engine) noexcept;
+
+    /**
+     * Calculate the CRC32 of the map the way Halo does: the BSPs, then the model data, then the tag data. This is not inverted.
+     * @param tag_data         pointer to the map's tag data
+     * @param tag_data_size    size of the tag data
+     * @param tag_data_offset  offset of the tag data in the map
+     * @param tag_data_address address the tag data is loaded to
+     * @param region_crc32     function used to checksum each region
+     * @return                 CRC32 of the map, or nothing if the tag data points outside of itself or a region could not be read
+     */
+    std::optional<std::uint32_t> calculate_map_crc32(const std::byte *tag_data, std::size_t tag_data_size, std::size_t tag_data_offset, std::uint32_t tag_data_address, const MapRegionCRC32 &region_crc32) noexcept;
+}
+
+#endif
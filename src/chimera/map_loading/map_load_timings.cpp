@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <optional>
+
+#include "map_load_timings.hpp"
+#include "../localization/localization.hpp"
+#include "../output/output.hpp"
+#include "../chimera.hpp"
+
+namespace Chimera {
+    // How many map loads to remember
+    static constexpr std::size_t MAP_LOAD_TIMINGS_HISTORY_SIZE = 32;
+
+    static std::deque<MapLoadTimings> history;
+    static std::optional<MapLoadTimings> current;
+    static std::optional<MapLoadClock::time_point> halo_start;
+
+    static double milliseconds_since(MapLoadClock::time_point start) noexcept {
+        return std::chrono::duration<double, std::milli>(MapLoadClock::now() - start).count();
+    }
+
+    double MapLoadTimings::total_milliseconds() const noexcept {
+        double total = 0.0;
+        for(auto &i : this->milliseconds) {
+            total += i;
+        }
+        return total;
+    }
+
+    void start_map_load_timings(const char *map_name) {
+        current = MapLoadTimings {};
+        current->map_name = map_name;
+        current->source = "loaded";
+        halo_start = std::nullopt;
+    }
+
+    void set_map_load_source(const char *map_name, const char *source, std::size_t size) {
+        if(current.has_value() && current->map_name == map_name) {
+            current->source = source;
+            current->size = size;
+        }
+    }
+
+    void add_map_load_time(MapLoadStage stage, MapLoadClock::time_point start, MapLoadClock::time_point end) noexcept {
+        if(current.has_value()) {
+            current->milliseconds[stage] += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+    }
+
+    void hand_map_load_to_halo(const char *map_name) {
+        if(!current.has_value() || current->map_name != map_name || halo_start.has_value()) {
+            start_map_load_timings(map_name);
+        }
+        halo_start = MapLoadClock::now();
+    }
+
+    void finish_map_load_timings(bool report) {
+        if(!current.has_value() || !halo_start.has_value()) {
+            return;
+        }
+
+        // Preloading and resolving happen while Halo is loading the map, so don't count them twice
+        auto &timings = *current;
+        double halo = milliseconds_since(*halo_start) - timings.milliseconds[MAP_LOAD_STAGE_PRELOAD] - timings.milliseconds[MAP_LOAD_STAGE_RESOLVE];
+        timings.milliseconds[MAP_LOAD_STAGE_HALO] = halo > 0.0 ? halo : 0.0;
+
+        history.emplace_back(std::move(timings));
+        while(history.size() > MAP_LOAD_TIMINGS_HISTORY_SIZE) {
+            history.pop_front();
+        }
+        current = std::nullopt;
+        halo_start = std::nullopt;
+
+        if(report) {
+            auto &finished = history.back();
+            console_output(localize("chimera_map_load_times_loaded"), finished.map_name.c_str(), finished.source.c_str(), finished.total_milliseconds());
+            for(std::size_t i = 0; i < MAP_LOAD_STAGE_COUNT; i++) {
+                console_output("    %s: %.1f ms", map_load_stage_name(static_cast<MapLoadStage>(i)), finished.milliseconds[i]);
+            }
+
+            std::deque<MapLoadTimings> just_this = { finished };
+            write_map_load_timings_csv(std::filesystem::path(get_chimera().get_path()) / "map_load_times.csv", just_this, true);
+        }
+    }
+
+    const std::deque<MapLoadTimings> &get_map_load_timings_history() noexcept {
+        return history;
+    }
+
+    const char *map_load_stage_name(MapLoadStage stage) noexcept {
+        switch(stage) {
+            case MapLoadStage::MAP_LOAD_STAGE_HEADER:
+                return localize("chimera_map_load_times_stage_header");
+            case MapLoadStage::MAP_LOAD_STAGE_DECOMPRESSION:
+                return localize("chimera_map_load_times_stage_decompression");
+            case MapLoadStage::MAP_LOAD_STAGE_CRC32:
+                return localize("chimera_map_load_times_stage_crc32");
+            case MapLoadStage::MAP_LOAD_STAGE_PRELOAD:
+                return localize("chimera_map_load_times_stage_preload");
+            case MapLoadStage::MAP_LOAD_STAGE_RESOLVE:
+                return localize("chimera_map_load_times_stage_resolve");
+            case MapLoadStage::MAP_LOAD_STAGE_HALO:
+                return localize("chimera_map_load_times_stage_halo");
+            default:
+                return "?";
+        }
+    }
+
+    bool write_map_load_timings_csv(const std::filesystem::path &path, const std::deque<MapLoadTimings> &timings, bool append) noexcept {
+        std::error_code ec;
+        bool write_header = !append || !std::filesystem::exists(path, ec) || std::filesystem::file_size(path, ec) == 0;
+
+        auto *f = std::fopen(path.string().c_str(), append ? "ab" : "wb");
+        if(!f) {
+            return false;
+        }
+
+        // Column names aren't localized so the file can be read by scripts
+        if(write_header) {
+            std::fprintf(f, "map,source,size,header_ms,decompression_ms,crc32_ms,preload_ms,resolve_ms,halo_ms,total_ms\n");
+        }
+        for(auto &i : timings) {
+            std::fprintf(f, "%s,%s,%zu", i.map_name.c_str(), i.source.c_str(), i.size);
+            for(auto &m : i.milliseconds) {
+                std::fprintf(f, ",%.3f", m);
+            }
+            std::fprintf(f, ",%.3f\n", i.total_milliseconds());
+        }
+
+        bool success = std::ferror(f) == 0;
+        std::fclose(f);
+        return success;
+    }
+}
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAP_LOAD_TIMINGS_HPP
+#define CHIMERA_MAP_LOAD_TIMINGS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <string>
+
+namespace Chimera {
+    using MapLoadClock = std::chrono::steady_clock;
+
+    enum MapLoadStage : std::size_t {
+        /** Opening the map and reading its header */
+        MAP_LOAD_STAGE_HEADER,
+
+        /** Reading or decompressing the map (including waiting on a background load) */
+        MAP_LOAD_STAGE_DECOMPRESSION,
+
+        /** Checksumming the map if it wasn't done while decompressing */
+        MAP_LOAD_STAGE_CRC32,
+
+        /** Preloading bitmap and sound data into the memory buffer */
+        MAP_LOAD_STAGE_PRELOAD,
+
+        /** Resolving tags indexed from bitmaps.map, sounds.map, and loc.map */
+        MAP_LOAD_STAGE_RESOLVE,
+
+        /** Everything else Halo does until the map is loaded */
+        MAP_LOAD_STAGE_HALO,
+
+        MAP_LOAD_STAGE_COUNT
+    };
+
+    struct MapLoadTimings {
+        /** Name of the map */
+        std::string map_name;
+
+        /** How the map was loaded (buffer, mapped, cache, decompressed, file, or loaded if it was already loaded) */
+        std::string source;
+
+        /** Size of the map once decompressed */
+        std::size_t size = 0;
+
+        /** Time spent in each stage */
+        double milliseconds[MAP_LOAD_STAGE_COUNT] = {};
+
+        /**
+         * Get the time spent in every stage
+         * @return total time in milliseconds
+         */
+        double total_milliseconds() const noexcept;
+    };
+
+    /**
+     * Start timing a map load, discarding whatever was being timed before if it didn't finish
+     * @param map_name name of the map
+     */
+    void start_map_load_timings(const char *map_name);
+
+    /**
+     * Set how the map being timed was loaded
+     * @param map_name name of the map; nothing is done if this isn't the map being timed
+     * @param source   how the map was loaded
+     * @param size     size of the map once decompressed
+     */
+    void set_map_load_source(const char *map_name, const char *source, std::size_t size);
+
+    /**
+     * Add time to a stage of the map load being timed, if any
+     * @param stage stage to add to
+     * @param start when the stage started
+     * @param end   when the stage ended
+     */
+    void add_map_load_time(MapLoadStage stage, MapLoadClock::time_point start, MapLoadClock::time_point end = MapLoadClock::now()) noexcept;
+
+    /**
+     * Note that Chimera is done with the map and Halo is now loading it, starting a new timing if the map was already loaded
+     * @param map_name name of the map
+     */
+    void hand_map_load_to_halo(const char *map_name);
+
+    /**
+     * Finish timing the map load, adding it to the history
+     * @param report print the timings to the console and append them to map_load_times.csv in the Chimera folder
+     */
+    void finish_map_load_timings(bool report);
+
+    /**
+     * Get the most recent map loads
+     * @return map loads, oldest first
+     */
+    const std::deque<MapLoadTimings> &get_map_load_timings_history() noexcept;
+
+    /**
+     * Get the localized name of a stage
+     * @param stage stage
+     * @return      name of the stage
+     */
+    const char *map_load_stage_name(MapLoadStage stage) noexcept;
+
+    /**
+     * Write map loads to a CSV file
+     * @param path    path to the CSV file
+     * @param timings map loads to write
+     * @param append  append to the file if it exists rather than overwrite it
+     * @return        true if successful
+     */
+    bool write_map_load_timings_csv(const std::filesystem::path &path, const std::deque<MapLoadTimings> &timings, bool append) noexcept;
+}
+
+#endif
@@ -2,15 +2,31 @@
 
 #define _WIN32_WINNT _WIN32_WINNT_WIN7
 #include <windows.h>
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <vector>
 #include <deque>
 #include <cstring>
+#include <limits>
 #include <memory>
+#include <new>
+#include <thread>
 
 #include "map_loading.hpp"
 #include "compression.hpp"
 #include "crc32.hpp"
+#include "download_decompression.hpp"
+#include "map_buffer.hpp"
+#include "map_cache.hpp"
+#include "map_crc32.hpp"
+#include "map_load_timings.hpp"
+#include "map_prefetch.hpp"
+#include "preload_priority.hpp"
+#include "resource_index.hpp"
+#include "seekable_map.hpp"
+#include "resource_map_tag_data.hpp"
+#include "crc32_cache.hpp"
 #include "../halo_data/game_engine.hpp"
 #include "../halo_data/map.hpp"
 #include "../halo_data/tag.hpp"
@@ -36,15 +52,19 @@ using charmeleon = char16_t;
 
 namespace Chimera {
     static bool fix_tag(std::vector<std::byte> &tag_data, TagClassInt primary_class) noexcept;
-    static const charmander * const tmp_format = "tmp_%zu.map";
     
     static std::deque<LoadedMap> loaded_maps;
     static std::byte *buffer;
     static std::size_t total_buffer_size = 0;
-    static std::size_t max_temp_files = 3;
+    static std::byte *buffer_committed_end = nullptr;
+    static MapBuffer map_buffer;
+    static std::size_t decompression_threads = 0;
     static bool do_benchmark = false;
+    static bool map_uncompressed_maps = false;
+    static bool seekable_maps = false;
     static bool download_retail_maps = false;
     static bool custom_edition_maps_supported = false;
+    static bool map_resource_maps = false;
     static GenericFont download_font = GenericFont::FONT_CONSOLE;
     
     static const charmander *bitmaps_file = "bitmaps.map";
@@ -55,33 +75,12 @@ namespace Chimera {
     static const charmander *custom_sounds_file = "custom_sounds.map";
     static const charmander *custom_loc_file = "custom_loc.map";
     
-    enum ResourceOrigin {
-        RESOURCE_ORIGIN_CUSTOM_BIT     = 0b0100,
-        
-        RESOURCE_ORIGIN_BITMAPS        = 0b0000,
-        RESOURCE_ORIGIN_SOUNDS         = 0b0001,
-        RESOURCE_ORIGIN_LOC            = 0b0010,
-        
-        RESOURCE_ORIGIN_CUSTOM_BITMAPS = RESOURCE_ORIGIN_BITMAPS | RESOURCE_ORIGIN_CUSTOM_BIT,
-        RESOURCE_ORIGIN_CUSTOM_SOUNDS  = RESOURCE_ORIGIN_SOUNDS  | RESOURCE_ORIGIN_CUSTOM_BIT,
-        RESOURCE_ORIGIN_CUSTOM_LOC     = RESOURCE_ORIGIN_LOC     | RESOURCE_ORIGIN_CUSTOM_BIT
-    };
-    
-    struct ResourceMetadata {
-        ResourceOrigin origin;
-        std::uint32_t offset;
-        std::byte *data;
-        std::size_t size;
-    };
-    
-    static std::vector<ResourceMetadata> metadata;
+    static ResourceIndex metadata;
     
     // Resource maps' tag data
-    static std::vector<std::vector<std::byte>> custom_edition_bitmaps_tag_data;
-    static std::vector<std::vector<std::byte>> custom_edition_sounds_tag_data;
-    static std::vector<std::string> custom_edition_sounds_tag_data_paths;
-    static std::vector<std::vector<std::byte>> custom_edition_loc_tag_data;
-    static std::vector<bool> custom_edition_loc_tag_data_fixed; // we don't know what tag is what, so we depend on the map to determine that for us
+    static ResourceMapTagData custom_edition_bitmaps_tag_data;
+    static ResourceMapTagData custom_edition_sounds_tag_data;
+    static ResourceMapTagData custom_edition_loc_tag_data;
     
     extern "C" {
         void map_loading_asm() noexcept;
@@ -117,7 +116,7 @@ namespace Chimera {
         return nullptr;
     }
     
-    static void unload_map(LoadedMap *map) {
+    static void forget_map(LoadedMap *map) {
         auto iterator = loaded_maps.begin();
         auto last = loaded_maps.end();
         while(iterator != last) {
@@ -130,42 +129,150 @@ namespace Chimera {
         }
     }
     
-    static std::filesystem::path path_for_tmp(std::size_t tmp) {
-        charmander tmp_name[64];
-        std::snprintf(tmp_name, sizeof(tmp_name), tmp_format, tmp);
-        return std::filesystem::path(get_chimera().get_path()) / "tmp" / tmp_name;
+    static void unload_map(LoadedMap *map) {
+        // Free up its space in the buffer, too
+        if(map->memory_location.has_value()) {
+            auto *region = map_buffer.find(map->name);
+            if(region) {
+                metadata.erase_range(buffer + region->offset, buffer + region->offset + region->size);
+                map_buffer.free(map->name);
+            }
+        }
+        forget_map(map);
+    }
+    
+    // Decompressing anything into the map cache (here, in the background, or after a download) can evict maps we have loaded, and
+    // those have to be decompressed again next time
+    static void forget_evicted_maps() {
+        for(bool evicted = true; evicted;) {
+            evicted = false;
+            for(auto &i : loaded_maps) {
+                if(i.in_map_cache && !std::filesystem::exists(i.path)) {
+                    unload_map(&i);
+                    evicted = true;
+                    break;
+                }
+            }
+        }
+    }
+    
+    // Maps mapped into memory hold onto address space for as long as they're loaded, and there isn't much of that to go around (and
+    // seekable maps hold onto a file and their cached frames), so only the most recently used ones stay loaded; anything else is
+    // loaded again if Halo needs it again
+    static constexpr std::size_t MAXIMUM_MAPPED_MAPS = 2;
+    
+    static void release_mapped_maps(std::size_t keep) {
+        for(bool released = true; released;) {
+            released = false;
+            std::size_t kept = 0;
+            for(auto i = loaded_maps.rbegin(); i != loaded_maps.rend(); i++) {
+                if((i->mapping || i->seekable) && kept++ >= keep) {
+                    forget_map(&*i);
+                    released = true;
+                    break;
+                }
+            }
+        }
     }
     
     static std::filesystem::path path_for_map_local(const charmander *map_name) {
         return add_map_to_map_list(map_name).get_file_path();
     }
     
-    static std::uint32_t calculate_crc32_of_map_file(const LoadedMap *map) noexcept {
-        std::uint32_t crc = 0;
+    // Don't evict ui.map
+    static std::vector<std::filesystem::path> maps_to_keep_in_map_cache() {
+        std::vector<std::filesystem::path> keep;
+        for(auto &i : loaded_maps) {
+            if(i.name == "ui" && i.in_map_cache) {
+                keep.emplace_back(i.path);
+            }
+        }
+        return keep;
+    }
+    
+    // The buffer is only reserved up front, so commit it as it gets used rather than holding onto all of it
+    static bool commit_buffer(const std::byte *end) noexcept {
+        static constexpr std::size_t COMMIT_GRANULARITY = 16 * 1024 * 1024;
+        
+        std::size_t needed = end - buffer;
+        std::size_t committed = buffer_committed_end - buffer;
+        if(needed <= committed) {
+            return true;
+        }
+        if(needed > total_buffer_size) {
+            return false;
+        }
+        
+        std::size_t new_committed = std::min((needed + COMMIT_GRANULARITY - 1) / COMMIT_GRANULARITY * COMMIT_GRANULARITY, total_buffer_size);
+        if(!VirtualAlloc(buffer_committed_end, new_committed - committed, MEM_COMMIT, PAGE_READWRITE)) {
+            return false;
+        }
+        buffer_committed_end = buffer + new_committed;
+        return true;
+    }
+    
+    static std::optional<std::uint32_t> calculate_crc32_of_map_file(const LoadedMap *map) noexcept {
+        std::optional<std::uint32_t> crc;
         std::uint32_t tag_data_size;
         std::uint32_t tag_data_offset;
-        std::uint32_t current_offset = 0;
         
-        auto *maps_in_ram_region = map->memory_location.value_or(nullptr);
-        std::FILE *f = (maps_in_ram_region != nullptr) ? nullptr : std::fopen(map->path.string().c_str(), "rb");
+        // If the map is in memory (or mapped into memory), we can checksum it in place
+        const std::byte *maps_in_ram_region = map->memory_location.value_or(nullptr);
+        std::size_t maps_in_ram_size = map->decompressed_size;
+        if(!maps_in_ram_region && map->mapping) {
+            maps_in_ram_region = map->mapping->data();
+            maps_in_ram_size = map->mapping->size();
+        }
+        auto *seekable = map->seekable.get();
+        std::FILE *f = (maps_in_ram_region != nullptr || seekable != nullptr) ? nullptr : std::fopen(map->path.string().c_str(), "rb");
+        if(!f && !maps_in_ram_region && !seekable) {
+            return crc;
+        }
+        
+        // Anything in the header could be wrong, so nothing is read past the end of the map
+        std::size_t map_size = maps_in_ram_size;
+        if(seekable) {
+            map_size = seekable->size();
+        }
+        else if(f) {
+            std::error_code ec;
+            auto file_size = std::filesystem::file_size(map->path, ec);
+            if(ec || file_size > std::numeric_limits<long>::max()) {
+                std::fclose(f);
+                return crc;
+            }
+            map_size = static_cast<std::size_t>(file_size);
+        }
 
-        auto seek = [&f, &current_offset](std::size_t offset) {
-            if(f) {
-                std::fseek(f, offset, SEEK_SET);
+        // Get a pointer to the data, reading it into the buffer first if it isn't in memory
+        auto read = [&f, &seekable, &maps_in_ram_region, &map_size](std::size_t offset, std::size_t size, std::unique_ptr<std::byte []> &buffer) -> const std::byte * {
+            if(offset > map_size || size > map_size - offset) {
+                return nullptr;
+            }
+            else if(maps_in_ram_region) {
+                return maps_in_ram_region + offset;
+            }
+            
+            buffer.reset(new (std::nothrow) std::byte[size]);
+            if(!buffer) {
+                return nullptr;
+            }
+            else if(seekable) {
+                return seekable->read(offset, buffer.get(), size) ? buffer.get() : nullptr;
+            }
+            else if(std::fseek(f, static_cast<long>(offset), SEEK_SET) != 0 || std::fread(buffer.get(), 1, size, f) != size) {
+                return nullptr;
             }
             else {
-                current_offset = offset;
+                return buffer.get();
             }
         };
-
-        auto read = [&f, &current_offset, &maps_in_ram_region](void *where, std::size_t size) {
+        
+        auto finish = [&f, &crc]() {
             if(f) {
-                std::fread(where, size, 1, f);
-            }
-            else {
-                std::copy(maps_in_ram_region + current_offset, maps_in_ram_region + size + current_offset, reinterpret_cast<std::byte *>(where));
+                std::fclose(f);
             }
-            current_offset += size;
+            return crc;
         };
         
         CacheFileEngine engine;
@@ -173,8 +280,12 @@ namespace Chimera {
             MapHeaderDemo demo_header;
             MapHeader fv_header;
         } header;
-        seek(0);
-        read(&header, sizeof(header));
+        std::unique_ptr<std::byte []> header_buffer;
+        auto *header_data = read(0, sizeof(header), header_buffer);
+        if(!header_data) {
+            return finish();
+        }
+        std::memcpy(&header, header_data, sizeof(header));
         
         if(game_engine() == GameEngine::GAME_ENGINE_DEMO && header.demo_header.is_valid()) {
             engine = header.demo_header.engine_type;
@@ -187,71 +298,301 @@ namespace Chimera {
             tag_data_offset = header.fv_header.tag_data_offset;
         }
         
-        std::uint32_t tag_data_addr;
-        switch(engine) {
-            case CacheFileEngine::CACHE_FILE_DEMO:
-                tag_data_addr = 0x4BF10000;
-                break;
-            default:
-                tag_data_addr = 0x40440000;
-                break;
+        // Load tag data
+        std::unique_ptr<std::byte []> tag_data_buffer;
+        auto *tag_data = read(tag_data_offset, tag_data_size, tag_data_buffer);
+        if(!tag_data) {
+            return finish();
         }
 
-        // Load tag data
-        auto tag_data_ptr = std::make_unique<std::byte []>(tag_data_size);
-        auto *tag_data = tag_data_ptr.get();
-        seek(tag_data_offset);
-        read(tag_data, tag_data_size);
-
-        // Get the scenario tag so we can get the BSPs
-        auto *scenario_tag = tag_data + (*reinterpret_cast<std::uint32_t *>(tag_data) - tag_data_addr) + (*reinterpret_cast<std::uint32_t *>(tag_data + 4) & 0xFFFF) * 0x20;
-        auto *scenario_tag_data = tag_data + (*reinterpret_cast<std::uint32_t *>(scenario_tag + 0x14) - tag_data_addr);
-
-        // CRC32 the BSP(s)
-        auto &structure_bsp_count = *reinterpret_cast<std::uint32_t *>(scenario_tag_data + 0x5A4);
-        auto *structure_bsps = tag_data + (*reinterpret_cast<std::uint32_t *>(scenario_tag_data + 0x5A4 + 4) - tag_data_addr);
-        for(std::size_t b=0;b<structure_bsp_count;b++) {
-            auto *bsp = structure_bsps + b * 0x20;
-            auto &bsp_offset = *reinterpret_cast<std::uint32_t *>(bsp);
-            auto &bsp_size = *reinterpret_cast<std::uint32_t *>(bsp + 4);
-
-            auto bsp_data = std::make_unique<std::byte []>(bsp_size);
-            seek(bsp_offset);
-            read(bsp_data.get(), bsp_size);
-            crc = crc32(crc, bsp_data.get(), bsp_size);
-        }
-
-        // Next, CRC32 the model data
-        auto &model_vertices_offset = *reinterpret_cast<std::uint32_t *>(tag_data + 0x14);
-        auto &vertices_size = *reinterpret_cast<std::uint32_t *>(tag_data + 0x20);
-
-        auto model_vertices = std::make_unique<std::byte []>(vertices_size);
-        seek(model_vertices_offset);
-        read(model_vertices.get(), vertices_size);
-        crc = crc32(crc, model_vertices.get(), vertices_size);
-
-        // Lastly, CRC32 the tag data itself
-        crc = crc32(crc, tag_data, tag_data_size);
-
-        return crc;
+        auto map_crc32 = calculate_map_crc32(tag_data, tag_data_size, tag_data_offset, tag_data_address_for_engine(engine), [&read, &tag_data, &tag_data_offset, &tag_data_size](std::uint32_t &running_crc, std::size_t offset, std::size_t size) -> bool {
+            // We already have the tag data
+            if(offset == tag_data_offset && size == tag_data_size) {
+                running_crc = crc32(running_crc, tag_data, size);
+                return true;
+            }
+
+            std::unique_ptr<std::byte []> region_buffer;
+            auto *region = read(offset, size, region_buffer);
+            if(!region) {
+                return false;
+            }
+            running_crc = crc32(running_crc, region, size);
+            return true;
+        });
+        if(map_crc32.has_value()) {
+            crc = ~*map_crc32;
+        }
+
+        return finish();
+    }
+    
+    std::optional<std::uint32_t> calculate_crc32_of_map_file(const std::filesystem::path &path) noexcept {
+        union {
+            MapHeaderDemo demo_header;
+            MapHeader fv_header;
+        } header;
+        
+        std::FILE *f = std::fopen(path.string().c_str(), "rb");
+        if(!f) {
+            return std::nullopt;
+        }
+        bool header_read = std::fread(&header, sizeof(header), 1, f) == 1;
+        std::fclose(f);
+        
+        // Make sure it's something we can checksum without decompressing it
+        if(!header_read) {
+            return std::nullopt;
+        }
+        else if(game_engine() == GameEngine::GAME_ENGINE_DEMO && header.demo_header.is_valid()) {
+            if(header.demo_header.engine_type != CacheFileEngine::CACHE_FILE_DEMO) {
+                return std::nullopt;
+            }
+        }
+        else if(!header.fv_header.is_valid() || (header.fv_header.engine_type != CacheFileEngine::CACHE_FILE_RETAIL && header.fv_header.engine_type != CacheFileEngine::CACHE_FILE_CUSTOM_EDITION)) {
+            return std::nullopt;
+        }
+        
+        LoadedMap map = {};
+        map.path = path;
+        return calculate_crc32_of_map_file(&map);
     }
     
-    template <typename T> static std::vector<std::byte> &translate_index(T index, std::vector<std::vector<std::byte>> &of_what) {
+    template <typename T> static std::vector<std::byte> &translate_index(T index, ResourceMapTagData &of_what, TagClassInt primary_class) {
         auto index_val = reinterpret_cast<std::uint32_t>(index);
         if(index_val >= of_what.size()) {
             MessageBox(nullptr, "Map could not be loaded due to an invalid index", "Failed to load map", MB_OK | MB_ICONERROR);
             std::exit(EXIT_FAILURE);
         }
-        return of_what[index_val];
+        
+        // Tag data is read and fixed the first time something uses it (we don't know what loc tags are until then, anyway)
+        try {
+            bool was_loaded;
+            auto &tag_data = of_what.get(index_val, was_loaded);
+            if(was_loaded && tag_data.size() && !fix_tag(tag_data, primary_class)) {
+                throw std::exception();
+            }
+            return tag_data;
+        }
+        catch(std::exception &) {
+            MessageBox(nullptr, "Failed to read resource maps' data.", "Files possibly corrupt", MB_OK | MB_ICONERROR);
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    
+    struct ResourcePreloadRequest {
+        ResourceOrigin origin;
+        std::uint32_t offset;
+        std::uint32_t size;
+    };
+    
+    struct ResourceRead {
+        std::uint32_t offset;
+        std::uint32_t size;
+        std::byte *destination;
+    };
+    
+    struct ResourcePreloadPlan {
+        std::vector<ResourcePreloadRequest> sounds_to_read;
+        std::vector<ResourcePreloadRequest> bitmaps_to_read;
+        std::vector<ResourceRead> sound_reads;
+        std::vector<ResourceRead> bitmap_reads;
+    };
+    
+    /**
+     * Plan preloading resources into the buffer. These are read in file order with adjacent and overlapping resources merged into one read.
+     * @param requests resources to preload, in order of priority
+     * @param cursor   where to put them; this is set to the end of whatever will be loaded
+     * @param end      end of the buffer
+     * @return         reads to do
+     */
+    static ResourcePreloadPlan plan_resource_preloads(const std::vector<ResourcePreloadRequest> &requests, std::byte *&cursor, std::byte *end) {
+        // Take whatever we don't already have until we run out of room; if something doesn't fit, something smaller still might
+        ResourcePreloadPlan plan;
+        std::size_t space_left = end - cursor;
+        for(auto &r : requests) {
+            auto *present = metadata.find(r.origin, r.offset);
+            if((present && present->size >= r.size) || r.size == 0 || r.size > space_left) {
+                continue;
+            }
+            space_left -= r.size;
+            ((r.origin & ResourceOrigin::RESOURCE_ORIGIN_SOUNDS) ? plan.sounds_to_read : plan.bitmaps_to_read).push_back(r);
+        }
+        
+        // Sort by offset (larger first for the same offset) and merge anything that touches; the merged reads are laid out in the buffer in that order
+        auto plan_reads = [&cursor](std::vector<ResourcePreloadRequest> &to_read) {
+            std::sort(to_read.begin(), to_read.end(), [](const ResourcePreloadRequest &a, const ResourcePreloadRequest &b) {
+                return a.offset < b.offset || (a.offset == b.offset && a.size > b.size);
+            });
+            
+            std::vector<ResourceRead> reads;
+            for(auto &r : to_read) {
+                if(reads.empty() || r.offset > reads.back().offset + reads.back().size) {
+                    reads.push_back(ResourceRead { r.offset, r.size, cursor });
+                }
+                else {
+                    auto &read = reads.back();
+                    read.size = std::max(read.size, r.offset + r.size - read.offset);
+                }
+                cursor = reads.back().destination + reads.back().size;
+            }
+            return reads;
+        };
+        
+        auto *start = cursor;
+        plan.sound_reads = plan_reads(plan.sounds_to_read);
+        plan.bitmap_reads = plan_reads(plan.bitmaps_to_read);
+        if(!commit_buffer(cursor)) {
+            cursor = start;
+            return ResourcePreloadPlan();
+        }
+        
+        return plan;
+    }
+    
+    /**
+     * Do the reads for preloading resources; sounds are read on another thread while bitmaps are read on this one
+     * @param plan    reads to do
+     * @param bitmaps bitmaps file
+     * @param sounds  sounds file
+     */
+    static void read_resource_preloads(const ResourcePreloadPlan &plan, std::FILE *bitmaps, std::FILE *sounds) {
+        auto do_reads = [](const std::vector<ResourceRead> &reads, std::FILE *from) {
+            for(auto &read : reads) {
+                std::fseek(from, read.offset, SEEK_SET);
+                std::fread(read.destination, read.size, 1, from);
+            }
+        };
+        std::thread sound_thread(do_reads, std::cref(plan.sound_reads), sounds);
+        do_reads(plan.bitmap_reads, bitmaps);
+        sound_thread.join();
+    }
+    
+    /**
+     * Point everything that was preloaded at where it ended up
+     * @param plan reads that were done
+     */
+    static void add_resource_preload_metadata(const ResourcePreloadPlan &plan) {
+        auto add_metadata = [](const std::vector<ResourcePreloadRequest> &to_read, const std::vector<ResourceRead> &reads) {
+            auto read = reads.begin();
+            const ResourcePreloadRequest *previous = nullptr;
+            for(auto &r : to_read) {
+                if(previous && previous->offset == r.offset) {
+                    continue;
+                }
+                previous = &r;
+                
+                while(r.offset >= read->offset + read->size) {
+                    read++;
+                }
+                
+                metadata.add(ResourceMetadata { r.origin, r.offset, read->destination + (r.offset - read->offset), r.size });
+            }
+        };
+        add_metadata(plan.sounds_to_read, plan.sound_reads);
+        add_metadata(plan.bitmaps_to_read, plan.bitmap_reads);
+    }
+    
+    /**
+     * Preload resources into the buffer
+     * @param requests resources to preload, in order of priority
+     * @param cursor   where to put them; this is set to the end of whatever was loaded
+     * @param end      end of the buffer
+     * @param bitmaps  bitmaps file
+     * @param sounds   sounds file
+     */
+    static void preload_resources(const std::vector<ResourcePreloadRequest> &requests, std::byte *&cursor, std::byte *end, std::FILE *bitmaps, std::FILE *sounds) {
+        auto plan = plan_resource_preloads(requests, cursor, end);
+        read_resource_preloads(plan, bitmaps, sounds);
+        add_resource_preload_metadata(plan);
+    }
+    
+    // Low priority resources being read after the map has started
+    struct ResourceStream {
+        ResourcePreloadPlan plan;
+        std::atomic<bool> done = false;
+        std::thread thread;
+        
+        ~ResourceStream() {
+            if(this->thread.joinable()) {
+                this->thread.join();
+            }
+        }
+    };
+    static std::unique_ptr<ResourceStream> resource_stream;
+    static bool stream_assets = false;
+    static void check_resource_stream() noexcept;
+    
+    /**
+     * Wait for the resource stream to finish and use what it read; this has to be done before anything in the buffer moves
+     */
+    static void finish_resource_stream() noexcept {
+        if(!resource_stream) {
+            return;
+        }
+        
+        resource_stream->thread.join();
+        add_resource_preload_metadata(resource_stream->plan);
+        resource_stream.reset();
+        remove_preframe_event(check_resource_stream);
+    }
+    
+    static void check_resource_stream() noexcept {
+        if(resource_stream && resource_stream->done) {
+            finish_resource_stream();
+        }
+    }
+    
+    /**
+     * Read resources into the buffer on another thread; they're used once they're all read
+     * @param requests     resources to read, in order of priority
+     * @param cursor       where to put them; this is set to the end of whatever will be loaded
+     * @param end          end of the buffer
+     * @param bitmaps_path path to the bitmaps file
+     * @param sounds_path  path to the sounds file
+     */
+    static void start_resource_stream(const std::vector<ResourcePreloadRequest> &requests, std::byte *&cursor, std::byte *end, const std::filesystem::path &bitmaps_path, const std::filesystem::path &sounds_path) {
+        finish_resource_stream();
+        
+        resource_stream = std::make_unique<ResourceStream>();
+        resource_stream->plan = plan_resource_preloads(requests, cursor, end);
+        if(resource_stream->plan.sound_reads.empty() && resource_stream->plan.bitmap_reads.empty()) {
+            resource_stream.reset();
+            return;
+        }
+        
+        auto *stream = resource_stream.get();
+        stream->thread = std::thread([stream, bitmaps_path, sounds_path]() {
+            std::FILE *bitmaps = std::fopen(bitmaps_path.string().c_str(), "rb");
+            std::FILE *sounds = std::fopen(sounds_path.string().c_str(), "rb");
+            if(bitmaps && sounds) {
+                read_resource_preloads(stream->plan, bitmaps, sounds);
+            }
+            else {
+                stream->plan = ResourcePreloadPlan();
+            }
+            if(bitmaps) {
+                std::fclose(bitmaps);
+            }
+            if(sounds) {
+                std::fclose(sounds);
+            }
+            stream->done = true;
+        });
+        add_preframe_event(check_resource_stream);
     }
     
     static void preload_assets(LoadedMap &map) {
+        // Anything still being read for the last map has to be done first
+        finish_resource_stream();
+        
         // If we can't, don't
         if(!map.memory_location.has_value()) {
             return;
         }
         
-        // Set this byte stuff
+        // Set this byte stuff; we can use anything up to the next map in the buffer
+        map.buffer_size = map_buffer.space(map.name);
         std::byte *cursor = *map.memory_location + map.loaded_size;
         auto *end = *map.memory_location + map.buffer_size;
         
@@ -262,15 +603,18 @@ namespace Chimera {
         std::FILE *sounds = nullptr;
         
         CacheFileEngine map_engine;
+        std::size_t tag_data_size;
         auto current_engine = game_engine();
         
         if(current_engine == GameEngine::GAME_ENGINE_DEMO) {
             auto &header = *reinterpret_cast<MapHeaderDemo *>(*map.memory_location);
             map_engine = header.engine_type;
+            tag_data_size = header.tag_data_size;
         }
         else {
             auto &header = *reinterpret_cast<MapHeader *>(*map.memory_location);
             map_engine = header.engine_type;
+            tag_data_size = header.tag_data_size;
         }
         
         bool can_load_indexed_tags = map_engine == CacheFileEngine::CACHE_FILE_CUSTOM_EDITION;
@@ -285,111 +629,76 @@ namespace Chimera {
             sounds_path = std::filesystem::path("maps") / sounds_file;
         }
         
-        // If it's a custom edition map, we ought to first figure out what tags go to what
-        const std::uint32_t tag_count = tag_data_header.tag_count;
-        
         Tag *tag_array = reinterpret_cast<Tag *>(tag_data_header.tag_array);
         
-        auto preload_asset_maybe = [&cursor, &end, &can_load_indexed_tags](std::uint32_t offset, std::uint32_t size, std::FILE *from, ResourceOrigin origin) -> bool {
+        // Gather everything first so it can all be read in file order; what the map needs first goes first
+        std::vector<ResourcePreloadRequest> requests[2];
+        auto preload_asset_maybe = [&can_load_indexed_tags](std::vector<ResourcePreloadRequest> &requests, std::uint32_t offset, std::uint32_t size, ResourceOrigin origin) {
             if(can_load_indexed_tags) {
                 origin = static_cast<ResourceOrigin>(origin | ResourceOrigin::RESOURCE_ORIGIN_CUSTOM_BIT);
             }
-            
-            // Already present? No need then.
-            for(auto &i : metadata) {
-                if(i.origin == origin && i.offset == offset && i.size >= size) {
-                    return true;
-                }
-            }
-            
-            // Let's think about this. Make sure it isn't too big
-            std::byte *new_cursor = cursor + size;
-            if(new_cursor < cursor || new_cursor > end) {
-                return false;
-            }
-            
-            // Navigate to this
-            std::fseek(from, offset, SEEK_SET);
-            std::fread(cursor, size, 1, from);
-            
-            // Set asset data
-            auto &new_asset = metadata.emplace_back();
-            new_asset.data = cursor;
-            new_asset.origin = origin;
-            new_asset.offset = offset;
-            new_asset.size = size;
-            
-            // Increment the cursor
-            cursor = new_cursor;
-        
-            return true;
+            requests.push_back(ResourcePreloadRequest { origin, offset, size });
         };
         
-        auto preload_all_tags_of_class = [&preload_asset_maybe, &tag_count, &tag_array, &bitmaps, &sounds](TagClassInt class_int) {
-            for(std::uint32_t i = 0; i < tag_count; i++) {
-                auto &tag = tag_array[i];
-                
-                if(tag.primary_class == class_int) {
-                    switch(class_int) {
-                        case TagClassInt::TAG_CLASS_BITMAP: {
-                            auto *td = tag.data;
-                            
-                            auto *bitmap_data = *reinterpret_cast<std::byte **>(td + 0x60 + 0x4);
-                            std::uint32_t bitmap_count = *reinterpret_cast<std::uint32_t *>(td + 0x60);
-                            
-                            for(std::uint32_t bd = 0; bd < bitmap_count; bd++) {
-                                auto *bitmap = bitmap_data + bd * 0x40;
-                                
-                                bool external = *reinterpret_cast<std::uint8_t *>(bitmap + 0xF) & 1;
-                                
-                                // Ignore internal tags
-                                if(!external) {
-                                    continue;
-                                }
-                                
-                                std::uint32_t bitmap_size = *reinterpret_cast<std::uint32_t *>(bitmap + 0x1C);
-                                std::uint32_t bitmap_offset = *reinterpret_cast<std::uint32_t *>(bitmap + 0x18);
-                                
-                                preload_asset_maybe(bitmap_offset, bitmap_size, bitmaps, ResourceOrigin::RESOURCE_ORIGIN_BITMAPS);
-                            }
-                            
-                            break;
+        auto preload_tag = [&preload_asset_maybe](Tag &tag, std::vector<ResourcePreloadRequest> &requests) {
+            switch(tag.primary_class) {
+                case TagClassInt::TAG_CLASS_BITMAP: {
+                    auto *td = tag.data;
+                    
+                    auto *bitmap_data = *reinterpret_cast<std::byte **>(td + 0x60 + 0x4);
+                    std::uint32_t bitmap_count = *reinterpret_cast<std::uint32_t *>(td + 0x60);
+                    
+                    for(std::uint32_t bd = 0; bd < bitmap_count; bd++) {
+                        auto *bitmap = bitmap_data + bd * 0x40;
+                        
+                        bool external = *reinterpret_cast<std::uint8_t *>(bitmap + 0xF) & 1;
+                        
+                        // Ignore internal tags
+                        if(!external) {
+                            continue;
                         }
-                        case TagClassInt::TAG_CLASS_SOUND: {
-                            auto *td = tag.data;
+                        
+                        std::uint32_t bitmap_size = *reinterpret_cast<std::uint32_t *>(bitmap + 0x1C);
+                        std::uint32_t bitmap_offset = *reinterpret_cast<std::uint32_t *>(bitmap + 0x18);
+                        
+                        preload_asset_maybe(requests, bitmap_offset, bitmap_size, ResourceOrigin::RESOURCE_ORIGIN_BITMAPS);
+                    }
+                    
+                    break;
+                }
+                case TagClassInt::TAG_CLASS_SOUND: {
+                    auto *td = tag.data;
+                    
+                    auto pitch_range_count = *reinterpret_cast<std::uint32_t *>(td + 0x98);
+                    auto *pitch_ranges = *reinterpret_cast<std::byte **>(td + 0x98 + 0x4);
+                    
+                    for(std::uint32_t pr = 0; pr < pitch_range_count; pr++) {
+                        auto *pitch_range = pitch_ranges + pr * 0x48;
+                        
+                        auto permutation_count = *reinterpret_cast<std::uint32_t *>(pitch_range + 0x3C);
+                        auto *permutation_ptr = *reinterpret_cast<std::byte **>(pitch_range + 0x3C + 0x4);
+                        
+                        for(std::uint32_t pe = 0; pe < permutation_count; pe++) {
+                            auto *permutation = permutation_ptr + pe * 0x7C;
                             
-                            auto pitch_range_count = *reinterpret_cast<std::uint32_t *>(td + 0x98);
-                            auto *pitch_ranges = *reinterpret_cast<std::byte **>(td + 0x98 + 0x4);
+                            bool external = *reinterpret_cast<std::uint8_t *>(permutation + 0x44) & 1;
                             
-                            for(std::uint32_t pr = 0; pr < pitch_range_count; pr++) {
-                                auto *pitch_range = pitch_ranges + pr * 0x48;
-                                
-                                auto permutation_count = *reinterpret_cast<std::uint32_t *>(pitch_range + 0x3C);
-                                auto *permutation_ptr = *reinterpret_cast<std::byte **>(pitch_range + 0x3C + 0x4);
-                                
-                                for(std::uint32_t pe = 0; pe < permutation_count; pe++) {
-                                    auto *permutation = permutation_ptr + pe * 0x7C;
-                                    
-                                    bool external = *reinterpret_cast<std::uint8_t *>(permutation + 0x44) & 1;
-                                    
-                                    // Ignore internal tags
-                                    if(!external) {
-                                        continue;
-                                    }
-                                    
-                                    std::uint32_t sound_offset = *reinterpret_cast<std::uint32_t *>(permutation + 0x48);
-                                    std::uint32_t sound_size = *reinterpret_cast<std::uint32_t *>(permutation + 0x40);
-                                    
-                                    preload_asset_maybe(sound_offset, sound_size, sounds, ResourceOrigin::RESOURCE_ORIGIN_SOUNDS);
-                                }
+                            // Ignore internal tags
+                            if(!external) {
+                                continue;
                             }
                             
-                            break;
+                            std::uint32_t sound_offset = *reinterpret_cast<std::uint32_t *>(permutation + 0x48);
+                            std::uint32_t sound_size = *reinterpret_cast<std::uint32_t *>(permutation + 0x40);
+                            
+                            preload_asset_maybe(requests, sound_offset, sound_size, ResourceOrigin::RESOURCE_ORIGIN_SOUNDS);
                         }
-                        
-                        default: break;
                     }
+                    
+                    break;
                 }
+                
+                default: break;
             }
         };
         
@@ -401,15 +710,35 @@ namespace Chimera {
             goto done_preloading_assets;
         }
         
-        // Prioritize loading sounds over bitmaps
-        preload_all_tags_of_class(TagClassInt::TAG_CLASS_SOUND);
-        preload_all_tags_of_class(TagClassInt::TAG_CLASS_BITMAP);
+        // Prioritize loading sounds over bitmaps within each priority
+        {
+            auto tag_order = prioritize_tags_for_preloading(*map.memory_location, map.loaded_size, tag_data_size);
+            for(auto class_int : { TagClassInt::TAG_CLASS_SOUND, TagClassInt::TAG_CLASS_BITMAP }) {
+                for(auto &t : tag_order) {
+                    auto &tag = tag_array[t.index];
+                    if(tag.primary_class == class_int) {
+                        preload_tag(tag, requests[t.priority]);
+                    }
+                }
+            }
+        }
+        
+        // Low priority assets can be read once the map has started
+        if(stream_assets) {
+            preload_resources(requests[PreloadPriority::PRELOAD_PRIORITY_HIGH], cursor, end, bitmaps, sounds);
+            start_resource_stream(requests[PreloadPriority::PRELOAD_PRIORITY_LOW], cursor, end, bitmaps_path, sounds_path);
+        }
+        else {
+            auto &all_requests = requests[PreloadPriority::PRELOAD_PRIORITY_HIGH];
+            all_requests.insert(all_requests.end(), requests[PreloadPriority::PRELOAD_PRIORITY_LOW].begin(), requests[PreloadPriority::PRELOAD_PRIORITY_LOW].end());
+            preload_resources(all_requests, cursor, end, bitmaps, sounds);
+        }
         
         // Cleanup
         done_preloading_assets:
         
         map.loaded_size = (cursor - *map.memory_location);
-        map.buffer_size = end - cursor;
+        map_buffer.set_size(map.name, map.loaded_size);
         if(bitmaps) {
             std::fclose(bitmaps);
         }
@@ -418,8 +747,205 @@ namespace Chimera {
         }
     }
     
-    std::unique_ptr<HACMapDownloader> map_downloader;
-    
+    std::unique_ptr<HACMapDownloader> map_downloader;
+    
+    // Decompresses the map being downloaded as it downloads; this has to be deleted before map_downloader is
+    static std::unique_ptr<DownloadDecompression> download_decompression;
+    
+    // Map being loaded in the background
+    struct BackgroundMapLoad {
+        std::string name;
+        std::filesystem::path path;
+        
+        // Set by the thread
+        std::optional<std::uint32_t> crc32;
+        
+        std::thread thread;
+        
+        ~BackgroundMapLoad() {
+            if(this->thread.joinable()) {
+                this->thread.join();
+            }
+        }
+    };
+    static std::unique_ptr<BackgroundMapLoad> background_map_load;
+    static bool background_map_loading = false;
+    
+    // ui.map stays loaded; anything else can be evicted to make room
+    static const std::vector<std::string> pinned_maps = { "ui" };
+    
+    static std::size_t buffer_space_for_map() noexcept {
+        return map_buffer.available(pinned_maps);
+    }
+    
+    static MapBufferEvents map_buffer_events() {
+        MapBufferEvents events;
+        events.evict = [](const std::string &name) {
+            for(auto &i : loaded_maps) {
+                if(i.name == name && i.memory_location.has_value()) {
+                    forget_map(&i);
+                    break;
+                }
+            }
+        };
+        events.discard = [](std::size_t offset, std::size_t size) {
+            metadata.erase_range(buffer + offset, buffer + offset + size);
+        };
+        events.move = [](const std::string &name, std::size_t from, std::size_t to, std::size_t size) {
+            std::memmove(buffer + to, buffer + from, size);
+            for(auto &i : loaded_maps) {
+                if(i.name == name && i.memory_location.has_value()) {
+                    i.memory_location = buffer + to;
+                    i.loaded_size = size;
+                    break;
+                }
+            }
+        };
+        return events;
+    }
+    
+    /**
+     * Wait for the map being loaded in the background to finish
+     * @param map_name_lowercase name of the map that is about to be loaded
+     * @return                   CRC32 of the map if it was calculated in the background
+     */
+    static std::optional<std::uint32_t> finish_background_map_load(const charmander *map_name_lowercase) noexcept {
+        if(!background_map_load) {
+            return std::nullopt;
+        }
+        
+        background_map_load->thread.join();
+        std::optional<std::uint32_t> crc32;
+        if(background_map_load->name == map_name_lowercase) {
+            crc32 = background_map_load->crc32;
+        }
+        background_map_load.reset();
+        return crc32;
+    }
+    
+    /**
+     * Start loading the map on another thread so it's (hopefully) done by the time Halo asks for it
+     * @param map_name name of the map
+     */
+    static void start_background_map_load(const charmander *map_name) noexcept {
+        if(!background_map_loading) {
+            return;
+        }
+        
+        charmander map_name_lowercase[32] = {};
+        std::strncpy(map_name_lowercase, map_name, sizeof(map_name_lowercase) - 1);
+        for(auto &i : map_name_lowercase) {
+            i = std::tolower(i);
+        }
+        
+        // Only one at a time
+        finish_background_map_load(map_name_lowercase);
+        forget_evicted_maps();
+        
+        // If it's already loaded, there's nothing to do
+        auto map_path = path_for_map_local(map_name_lowercase);
+        std::error_code ec;
+        auto timestamp = std::filesystem::last_write_time(map_path, ec);
+        if(ec) {
+            return;
+        }
+        for(auto &i : loaded_maps) {
+            if(i.name == map_name_lowercase && i.timestamp == timestamp) {
+                return;
+            }
+        }
+        
+        // Everything the thread needs from this thread has to be figured out now
+        bool calculate_crc32 = !get_cached_map_crc32(map_path).has_value();
+        std::size_t buffer_space = total_buffer_size > 0 ? buffer_space_for_map() : 0;
+        auto keep = maps_to_keep_in_map_cache();
+        
+        background_map_load = std::make_unique<BackgroundMapLoad>();
+        background_map_load->name = map_name_lowercase;
+        background_map_load->path = map_path;
+        
+        auto *load = background_map_load.get();
+        load->thread = std::thread([load, calculate_crc32, buffer_space, keep, use_seekable = seekable_maps]() {
+            union {
+                MapHeaderDemo demo_header;
+                MapHeader fv_header;
+            } header;
+            
+            std::FILE *f = std::fopen(load->path.string().c_str(), "rb");
+            if(!f) {
+                return;
+            }
+            bool header_read = std::fread(&header, sizeof(header), 1, f) == 1;
+            std::fclose(f);
+            if(!header_read) {
+                return;
+            }
+            
+            bool compressed = header.fv_header.is_valid() && (
+                header.fv_header.engine_type == CacheFileEngine::CACHE_FILE_RETAIL_COMPRESSED ||
+                header.fv_header.engine_type == CacheFileEngine::CACHE_FILE_CUSTOM_EDITION_COMPRESSED ||
+                header.fv_header.engine_type == CacheFileEngine::CACHE_FILE_DEMO_COMPRESSED
+            );
+            
+            // Uncompressed maps just need checksummed
+            if(!compressed) {
+                if(calculate_crc32) {
+                    load->crc32 = calculate_crc32_of_map_file(load->path);
+                }
+                return;
+            }
+            
+            // If it'll go in the memory buffer, we can't touch that until Halo is done with the current map, so read it ahead instead so it's decompressed from memory
+            std::size_t size = header.fv_header.file_size;
+            if(size <= buffer_space) {
+                if((f = std::fopen(load->path.string().c_str(), "rb"))) {
+                    static constexpr std::size_t CHUNK_SIZE = 1024 * 1024;
+                    auto chunk = std::make_unique<std::byte []>(CHUNK_SIZE);
+                    while(std::fread(chunk.get(), 1, CHUNK_SIZE, f) == CHUNK_SIZE) {
+                        continue;
+                    }
+                    std::fclose(f);
+                }
+                return;
+            }
+            
+            // Seekable maps are read in place, so only the checksum is needed
+            if(use_seekable) {
+                try {
+                    LoadedMap map = {};
+                    map.seekable = std::make_shared<SeekableMap>(load->path);
+                    if(calculate_crc32) {
+                        load->crc32 = calculate_crc32_of_map_file(&map);
+                    }
+                    return;
+                }
+                catch (std::exception &) {
+                    // Not seekable; decompress it
+                }
+            }
+            
+            // Otherwise it goes in the map cache
+            if(!map_cache_enabled() || find_cached_decompressed_map(load->path, size).has_value()) {
+                return;
+            }
+            auto reserved_path = reserve_cached_decompressed_map(load->path, size, keep);
+            if(!reserved_path.has_value()) {
+                return;
+            }
+            try {
+                std::optional<std::uint32_t> crc32;
+                bool success = decompress_map_file(load->path.string().c_str(), reserved_path->string().c_str(), decompression_threads, calculate_crc32 ? &crc32 : nullptr) == size;
+                finish_cached_decompressed_map(load->path, success);
+                if(success && calculate_crc32) {
+                    load->crc32 = crc32;
+                }
+            }
+            catch (std::exception &) {
+                finish_cached_decompressed_map(load->path, false);
+            }
+        });
+    }
+    
     // Load the map
     LoadedMap *load_map(const charmander *map_name) {
         // Lowercase it
@@ -429,6 +955,12 @@ namespace Chimera {
             i = std::tolower(i);
         }
         
+        // If this was being loaded in the background, wait for it
+        auto background_start = MapLoadClock::now();
+        auto background_crc32 = finish_background_map_load(map_name_lowercase);
+        auto background_end = MapLoadClock::now();
+        forget_evicted_maps();
+        
         // Get the map path
         auto map_path = path_for_map_local(map_name_lowercase);
         auto timestamp = std::filesystem::last_write_time(map_path);
@@ -439,9 +971,13 @@ namespace Chimera {
             if(i.name == map_name_lowercase) {
                 // If the map is loaded and it hasn't been modified, do not reload it
                 if(i.timestamp == timestamp) {
+                    if(i.memory_location.has_value()) {
+                        map_buffer.use(i.name);
+                    }
+                    
                     // Move it to the front of the array, though
                     auto copy = i;
-                    unload_map(&i);
+                    forget_map(&i);
                     return &loaded_maps.emplace_back(copy);
                 }
                 
@@ -451,6 +987,14 @@ namespace Chimera {
             }
         }
         
+        // Maps in the buffer can move once we start loading this one, so anything still being streamed in has to be done
+        finish_resource_stream();
+        
+        // Waiting on the background load counts as decompression since that's what it was doing
+        start_map_load_timings(map_name_lowercase);
+        add_map_load_time(MapLoadStage::MAP_LOAD_STAGE_DECOMPRESSION, background_start, background_end);
+        auto stage_start = MapLoadClock::now();
+        
         // Add our map to the list
         std::size_t size = std::filesystem::file_size(map_path);
         LoadedMap new_map;
@@ -511,6 +1055,9 @@ namespace Chimera {
                 case CacheFileEngine::CACHE_FILE_DEMO_COMPRESSED:
                     size = header.fv_header.file_size;
                     needs_decompressed = true;
+                    if(!has_map_compression_dictionary(header.fv_header.get_compression_dictionary())) {
+                        invalid("Map was compressed with a dictionary that is not in the dictionaries folder");
+                    }
                     break;
                     
                 default:
@@ -521,75 +1068,88 @@ namespace Chimera {
             invalid("Header is invalid");
         }
         
-        // Do we have enough space to load into memory?
+        add_map_load_time(MapLoadStage::MAP_LOAD_STAGE_HEADER, stage_start);
+        stage_start = MapLoadClock::now();
+        
+        // If we already checksummed this exact file (or just did so in the background), we don't need to do it again; otherwise compressed maps are checksummed as they're decompressed
+        auto new_crc32 = get_cached_map_crc32(map_path);
+        bool cache_crc32 = !new_crc32.has_value();
+        if(cache_crc32 && background_crc32.has_value()) {
+            new_crc32 = background_crc32;
+        }
+        std::optional<std::uint32_t> decompressed_crc32;
+        
+        // If it's not compressed, we can map it into memory instead of reading it (this skips the buffer, so nothing gets preloaded)
         bool tmp_file = true;
-        if(total_buffer_size > 0) {
-            std::size_t remaining_buffer_size = total_buffer_size;
-            auto *buffer_location = buffer;
-            
-            // If it's not ui.map, then we need to ensure ui.map is always loaded
-            if(std::strcmp(map_name_lowercase, "ui") != 0) {
-                for(auto &i : loaded_maps) {
-                    if(i.name == "ui" && i.memory_location.has_value()) {
-                        auto size = i.loaded_size;
-                        remaining_buffer_size -= size;
-                        buffer_location += size;
-                        break;
-                    }
-                }
-            }
-            
-            // We do!
-            if(remaining_buffer_size >= size) {
-                if(needs_decompressed) {
-                    try {
-                        actual_size = decompress_map_file(map_path.string().c_str(), buffer_location, size);
-                    }
-                    catch (std::exception &) {
-                        invalid("Failed to read map");
-                    }
-                    if(actual_size != size) {
-                        invalid("Size in map is incorrect");
-                    }
-                    new_map.decompressed_size = actual_size;
-                }
-                else {
-                    std::fseek(f, 0, SEEK_SET);
-                    if(std::fread(buffer_location, size, 1, f) != 1) {
-                        invalid("Failed to read map");
-                    }
-                }
-                
-                // Next, we need to remove any loaded map we may have, not including ui.map
-                for(auto &i : loaded_maps) {
-                    if((i.name != "ui" || std::strcmp(map_name_lowercase, "ui") == 0) && i.memory_location.has_value()) {
-                        unload_map(&i);
-                        break;
-                    }
-                }
+        const char *source = "file";
+        if(map_uncompressed_maps && !needs_decompressed) {
+            release_mapped_maps(MAXIMUM_MAPPED_MAPS - 1);
+            try {
+                new_map.mapping = std::make_shared<MappedFile>(map_path);
                 
-                // We're done with this
                 std::fclose(f);
                 f = nullptr;
                 
-                // Find all metadata after the thing we're loading to
-                std::size_t metadata_size = metadata.size();
-                for(std::size_t m = 0; m < metadata_size; m++) {
-                    auto &md = metadata[m];
-                    if(md.data >= buffer_location) {
-                        metadata.erase(metadata.begin() + m);
-                        m--;
-                        metadata_size--;
-                        continue;
-                    }
-                }
-                
-                new_map.loaded_size = size;
-                new_map.memory_location = buffer_location;
-                new_map.buffer_size = remaining_buffer_size;
+                new_map.loaded_size = 0;
+                new_map.buffer_size = 0;
                 
                 tmp_file = false;
+                source = "mapped";
+            }
+            catch (std::exception &) {
+                // Probably out of address space; load it normally
+                new_map.mapping = nullptr;
+            }
+        }
+        
+        // Do we have enough space to load into memory? Other maps can stay in the buffer as long as there's room for them.
+        std::optional<std::size_t> buffer_offset;
+        if(tmp_file && total_buffer_size > 0) {
+            buffer_offset = map_buffer.allocate(map_name_lowercase, size, pinned_maps, map_buffer_events());
+            if(buffer_offset.has_value() && !commit_buffer(buffer + *buffer_offset + size)) {
+                map_buffer.free(map_name_lowercase);
+                buffer_offset = std::nullopt;
+            }
+        }
+        if(buffer_offset.has_value()) {
+            // We do!
+            auto *buffer_location = buffer + *buffer_offset;
+            
+            if(needs_decompressed) {
+                try {
+                    actual_size = decompress_map_file(map_path.string().c_str(), buffer_location, size, decompression_threads, new_crc32.has_value() ? nullptr : &decompressed_crc32);
+                }
+                catch (std::exception &) {
+                    invalid("Failed to read map");
+                }
+                if(actual_size != size) {
+                    invalid("Size in map is incorrect");
+                }
+                new_map.decompressed_size = actual_size;
+                if(!new_crc32.has_value()) {
+                    new_crc32 = decompressed_crc32;
+                }
+            }
+            else {
+                std::fseek(f, 0, SEEK_SET);
+                if(std::fread(buffer_location, size, 1, f) != 1) {
+                    invalid("Failed to read map");
+                }
             }
+            
+            // We're done with this
+            std::fclose(f);
+            f = nullptr;
+            
+            // Remove all metadata for whatever was here before
+            metadata.erase_range(buffer_location, buffer_location + size);
+            
+            new_map.loaded_size = size;
+            new_map.memory_location = buffer_location;
+            new_map.buffer_size = map_buffer.space(map_name_lowercase);
+            
+            tmp_file = false;
+            source = "buffer";
         }
         
         if(tmp_file) {
@@ -597,52 +1157,63 @@ namespace Chimera {
             std::fclose(f);
             f = nullptr;
             
+            // If it has a seek table, Halo can read it in place by decompressing only what it asks for
+            if(needs_decompressed && seekable_maps) {
+                release_mapped_maps(MAXIMUM_MAPPED_MAPS - 1);
+                try {
+                    new_map.seekable = std::make_shared<SeekableMap>(map_path);
+                    new_map.decompressed_size = size;
+                    needs_decompressed = false;
+                    source = "seekable";
+                }
+                catch (std::exception &) {
+                    // Not seekable; decompress it
+                    new_map.seekable = nullptr;
+                }
+            }
+            
             // Does it need decompressed?
             if(needs_decompressed) {
-                // First we need to reserve a temp file
-                if(max_temp_files == 0) {
+                // We need somewhere to put it
+                if(!map_cache_enabled()) {
                     invalid("Temporary files are disabled");
                 }
                 
-                // Go through each possible index. See if we can reserve something.
-                for(std::size_t t = 0; t < max_temp_files; t++) {
-                    bool found = false;
-                    for(auto &i : loaded_maps) {
-                        if(i.tmp_file == t) {
-                            found = true;
-                            break;
-                        }
+                // If we decompressed this exact map before, we can use that
+                auto cached_path = find_cached_decompressed_map(map_path, size);
+                if(cached_path.has_value()) {
+                    new_map.path = *cached_path;
+                    source = "cache";
+                }
+                else {
+                    auto reserved_path = reserve_cached_decompressed_map(map_path, size, maps_to_keep_in_map_cache());
+                    if(!reserved_path.has_value()) {
+                        invalid("Failed to read map");
                     }
-                    if(!found) {
-                        new_map.tmp_file = t;
-                        break;
+                    new_map.path = *reserved_path;
+                    
+                    // Decompress it
+                    try {
+                        actual_size = decompress_map_file(map_path.string().c_str(), new_map.path.string().c_str(), decompression_threads, new_crc32.has_value() ? nullptr : &decompressed_crc32);
                     }
-                }
-                
-                // No? We need to take one then. Find the lowest-index temp file and remove it
-                if(!new_map.tmp_file.has_value()) {
-                    for(auto &i : loaded_maps) {
-                        if(i.tmp_file.has_value()) {
-                            new_map.tmp_file = i.tmp_file;
-                            unload_map(&i);
-                            break;
-                        }
+                    catch (std::exception &) {
+                        finish_cached_decompressed_map(map_path, false);
+                        invalid("Failed to read map");
                     }
+                    if(actual_size != size) {
+                        finish_cached_decompressed_map(map_path, false);
+                        invalid("Size in map is incorrect");
+                    }
+                    finish_cached_decompressed_map(map_path, true);
+                    
+                    if(!new_crc32.has_value()) {
+                        new_crc32 = decompressed_crc32;
+                    }
+                    source = "decompressed";
+                    forget_evicted_maps();
                 }
                 
-                new_map.path = path_for_tmp(new_map.tmp_file.value());
-                
-                // Decompress it
-                try {
-                    actual_size = decompress_map_file(map_path.string().c_str(), new_map.path.string().c_str());
-                }
-                catch (std::exception &) {
-                    invalid("Failed to read map");
-                }
-                if(actual_size != size) {
-                    invalid("Size in map is incorrect");
-                }
-                
+                new_map.in_map_cache = true;
                 new_map.decompressed_size = size;
             }
             
@@ -652,8 +1223,20 @@ namespace Chimera {
             }
         }
         
-        // Calculate CRC32
-        get_map_entry(new_map.name.c_str())->crc32 = ~calculate_crc32_of_map_file(&new_map);
+        add_map_load_time(MapLoadStage::MAP_LOAD_STAGE_DECOMPRESSION, stage_start);
+        set_map_load_source(map_name_lowercase, source, new_map.decompressed_size);
+        stage_start = MapLoadClock::now();
+        
+        // Calculate CRC32 if we don't have it yet
+        if(!new_crc32.has_value()) {
+            new_crc32 = calculate_crc32_of_map_file(&new_map);
+        }
+        if(cache_crc32 && new_crc32.has_value()) {
+            set_cached_map_crc32(map_path, *new_crc32);
+        }
+        get_map_entry(new_map.name.c_str())->crc32 = new_crc32;
+        
+        add_map_load_time(MapLoadStage::MAP_LOAD_STAGE_CRC32, stage_start);
         
         // Done!
         return &loaded_maps.emplace_back(new_map);
@@ -662,6 +1245,11 @@ namespace Chimera {
     static bool retail_fallback = false;
     static charmander download_temp_file[1024];
     static charmander connect_command[1024];
+
+    // Set while waiting for the map being downloaded in the background to stop so the download can pick up where it left off
+    static bool map_download_waiting_for_prefetch = false;
+    static std::string map_download_pending_map;
+    static const charmander *map_download_pending_engine = nullptr;
     
     extern "C" int on_map_load_multiplayer(const charmander *map) noexcept;
 
@@ -673,14 +1261,95 @@ namespace Chimera {
     }
     
     extern "C" void do_map_loading_handling(charmander *map_path, const charmander *map_name) {
-        std::strcpy(map_path, load_map(map_name)->path.string().c_str());
+        auto *map = load_map(map_name);
+        std::strcpy(map_path, map->path.string().c_str());
+        hand_map_load_to_halo(map->name.c_str());
     }
     
     static void initiate_connection() {
         remove_preframe_event(initiate_connection);
         execute_script(connect_command);
     }
+
+    static const charmander *map_download_engine(bool retail_fallback) noexcept {
+        switch(game_engine()) {
+            case GameEngine::GAME_ENGINE_CUSTOM_EDITION:
+                return "halom";
+            case GameEngine::GAME_ENGINE_RETAIL:
+                return (custom_edition_maps_supported && !retail_fallback) ? "halom" : "halor";
+            case GameEngine::GAME_ENGINE_DEMO:
+                return "halod";
+            default:
+                return nullptr;
+        }
+    }
+
+    const charmander *get_map_download_engine() noexcept {
+        auto *engine = map_download_engine(false);
+        if(engine && std::strcmp(engine, "halor") == 0 && !download_retail_maps) {
+            return nullptr;
+        }
+        return engine;
+    }
+
+    std::filesystem::path get_map_download_path() {
+        return std::filesystem::path(get_chimera().get_path()) / "download.map";
+    }
+
+    std::filesystem::path get_map_prefetch_path() {
+        return std::filesystem::path(get_chimera().get_path()) / "prefetch.map";
+    }
+
+    bool map_download_in_progress() noexcept {
+        return map_downloader != nullptr || map_download_waiting_for_prefetch;
+    }
+
+    std::unique_ptr<HACMapDownloader> create_map_downloader(const charmander *map, const std::filesystem::path &path, const charmander *engine) {
+        auto downloader = std::make_unique<HACMapDownloader>(map, path.string().c_str(), engine);
+        downloader->set_preferred_server_node(get_chimera().get_ini()->get_value_long("memory.download_preferred_node"));
+        downloader->set_segment_count(get_chimera().get_ini()->get_value_long("memory.download_segments").value_or(4));
+        downloader->set_mirror_cache_file((std::filesystem::path(get_chimera().get_path()) / "download_mirrors.txt").string());
+        return downloader;
+    }
+
+    std::unique_ptr<DownloadDecompression> create_download_decompression(HACMapDownloader &downloader, const std::filesystem::path &path) {
+        // Only if it'll have somewhere to go when it's done
+        if(map_cache_enabled() && get_chimera().get_ini()->get_value_bool("memory.decompress_downloads").value_or(true)) {
+            return std::make_unique<DownloadDecompression>(downloader, path);
+        }
+        return nullptr;
+    }
+
+    void install_downloaded_map(const charmander *map, const std::filesystem::path &download_path, DownloadDecompression *decompression) noexcept {
+        charmander to_path[MAX_PATH];
+        std::snprintf(to_path, sizeof(to_path), "%s\\maps\\%s.map", get_chimera().get_path(), map);
+
+        std::error_code ec;
+        std::filesystem::rename(download_path, to_path, ec);
+        if(ec) {
+            return;
+        }
+
+        // Now it won't have to be decompressed when it loads
+        if(decompression) {
+            decompression->add_to_cache(to_path, maps_to_keep_in_map_cache());
+        }
+
+        add_map_to_map_list(map);
+        resync_map_list();
+    }
     
+    static void start_map_download(const charmander *map, const charmander *engine) {
+        // Start downloading (determine where to download to and start!)
+        auto path = get_map_download_path();
+        map_downloader = create_map_downloader(map, path, engine);
+        map_downloader->dispatch();
+
+        // Decompress it as it downloads
+        download_decompression = create_download_decompression(*map_downloader, path);
+        std::snprintf(download_temp_file, sizeof(download_temp_file), "%s", path.string().c_str());
+    }
+
     static void download_frame() {
         charmander output[128] = {};
 
@@ -690,6 +1359,18 @@ namespace Chimera {
         std::int16_t height = 240 - y;
 
         ColorARGB color { 1.0F, 1.0F, 1.0F, 1.0F };
+        bool decompressing = false;
+
+        // Once the background download lets go of what it downloaded, take it and keep going
+        if(map_download_waiting_for_prefetch) {
+            if(is_map_prefetch_stopping()) {
+                apply_text("Connecting to repo...", x, y, width, height, color, download_font, FontAlignment::ALIGN_CENTER, TextAnchor::ANCHOR_CENTER);
+                return;
+            }
+            map_download_waiting_for_prefetch = false;
+            take_map_prefetch(get_map_download_path());
+            start_map_download(map_download_pending_map.c_str(), map_download_pending_engine);
+        }
 
         if(server_type() == ServerType::SERVER_NONE) {
             map_downloader->cancel();
@@ -724,21 +1405,29 @@ namespace Chimera {
                 else {
                     std::snprintf(download_speed_buffer, sizeof(download_speed_buffer), "%zu kB/s", download_speed);
                 }
+
+                // And how long until it's done at that speed
+                auto seconds_remaining = map_downloader->get_seconds_remaining();
+                if(seconds_remaining.has_value()) {
+                    auto length = std::strlen(download_speed_buffer);
+                    std::snprintf(download_speed_buffer + length, sizeof(download_speed_buffer) - length, " (%zu:%02zu)", *seconds_remaining / 60, *seconds_remaining % 60);
+                }
                 apply_text(download_speed_buffer, x + 450, y, 150, height, color, download_font, FontAlignment::ALIGN_RIGHT, TextAnchor::ANCHOR_CENTER);
 
                 break;
             }
             case HACMapDownloader::DownloadStage::DOWNLOAD_STAGE_COMPLETE: {
+                // It's usually only a moment behind the download
+                if(download_decompression && !download_decompression->is_finished()) {
+                    std::snprintf(output, sizeof(output), "Decompressing map...");
+                    decompressing = true;
+                    break;
+                }
+
                 std::snprintf(output, sizeof(output), "Reconnecting...");
                 console_output("Download complete. Reconnecting...");
 
-                charmander to_path[MAX_PATH];
-                std::snprintf(to_path, sizeof(to_path), "%s\\maps\\%s.map", get_chimera().get_path(), map_downloader->get_map().c_str());
-
-                std::filesystem::rename(download_temp_file, to_path);
-
-                add_map_to_map_list(map_downloader->get_map().c_str());
-                resync_map_list();
+                install_downloaded_map(map_downloader->get_map().c_str(), download_temp_file, download_decompression.get());
 
                 auto &latest_connection = get_latest_connection();
                 std::snprintf(connect_command, sizeof(connect_command), "connect \"%s:%u\" \"%s\"", latest_connection.address, latest_connection.port, latest_connection.password);
@@ -764,6 +1453,7 @@ namespace Chimera {
                 else {
                     std::snprintf(output, sizeof(output), "Retrying on retail Halo PC repo...");
                     std::string map_name_temp = map_downloader->get_map().c_str();
+                    download_decompression.reset();
                     delete map_downloader.release();
                     retail_fallback = true;
                     on_map_load_multiplayer(map_name_temp.c_str());
@@ -777,7 +1467,8 @@ namespace Chimera {
             apply_text(output, x, y, width, height, color, download_font, FontAlignment::ALIGN_CENTER, TextAnchor::ANCHOR_CENTER);
         }
 
-        if(!map_downloader || map_downloader->is_finished()) {
+        if(!map_downloader || (map_downloader->is_finished() && !decompressing)) {
+            download_decompression.reset();
             delete map_downloader.release();
             remove_preframe_event(download_frame);
             get_chimera().get_signature("server_join_progress_text_sig").rollback();
@@ -793,26 +1484,20 @@ namespace Chimera {
             c = std::tolower(c);
         }
 
-        // Does it exist?
+        // Anything being downloaded in the background stops so this gets all of the bandwidth (if it finished, it'll be kept, and
+        // if it's this map, we'll pick up where it left off)
+        bool resume_prefetch = stop_map_prefetch(name_lowercase_copy.c_str());
+
+        // Does it exist? If so, start loading it now while Halo is still busy
         if(get_map_entry(map)) {
+            start_background_map_load(map);
             return 0;
         }
 
         // Determine what we're downloading from
-        const charmander *game_engine_str;
-        switch(game_engine()) {
-            case GameEngine::GAME_ENGINE_CUSTOM_EDITION:
-                game_engine_str = "halom";
-                break;
-            case GameEngine::GAME_ENGINE_RETAIL:
-                game_engine_str = (custom_edition_maps_supported && !retail_fallback) ? "halom" : "halor";
-                break;
-            case GameEngine::GAME_ENGINE_DEMO:
-                game_engine_str = "halod";
-                break;
-            default:
-                game_engine_str = nullptr;
-                return 1;
+        const charmander *game_engine_str = map_download_engine(retail_fallback);
+        if(!game_engine_str) {
+            return 1;
         }
 
         // Can we even do this?
@@ -840,15 +1525,17 @@ namespace Chimera {
         overwrite(esrb_text_sig.data() + 5, static_cast<std::int16_t>(0x7FFF));
         overwrite(esrb_text_sig.data() + 5 + 7, static_cast<std::int16_t>(0x7FFF));
 
-        // Start downloading (determine where to download to and start!)
-        charmander path[MAX_PATH];
-        std::snprintf(path, sizeof(path), "%s\\download.map", get_chimera().get_path());
-        map_downloader = std::make_unique<HACMapDownloader>(name_lowercase_copy.c_str(), path, game_engine_str);
-        map_downloader->set_preferred_server_node(get_chimera().get_ini()->get_value_long("memory.download_preferred_node"));
-        map_downloader->dispatch();
+        // Start downloading, unless we have to wait for the background download to stop first
+        if(resume_prefetch) {
+            map_download_waiting_for_prefetch = true;
+            map_download_pending_map = name_lowercase_copy;
+            map_download_pending_engine = game_engine_str;
+        }
+        else {
+            start_map_download(name_lowercase_copy.c_str(), game_engine_str);
+        }
 
         // Add callbacks so we can check every frame the status
-        std::snprintf(download_temp_file, sizeof(download_temp_file), "%s\\download.map", get_chimera().get_path());
         add_preframe_event(download_frame);
         return 1;
     }
@@ -903,11 +1590,10 @@ namespace Chimera {
             }
             
             // Copy it in?
-            for(auto &md : metadata) {
-                if(md.origin == origin && file_offset == md.offset && size <= md.size) {
-                    std::memcpy(output, md.data, size);
-                    return 1;
-                }
+            auto *md = metadata.find(*origin, file_offset);
+            if(md && size <= md->size) {
+                std::memcpy(output, md->data, size);
+                return 1;
             }
             
             // If we don't have it precached, read from disk
@@ -948,37 +1634,27 @@ namespace Chimera {
         }
 
         else {
-            // Check if we're a tmp file
-            auto file_name_str = file_name.stem().string();
-            auto *file_name_cstr = file_name_str.c_str();
-            if(std::strncmp(file_name_cstr, tmp_format, 4) == 0) {
-                for(auto &i : loaded_maps) {
-                    if(i.tmp_file.has_value()) {
-                        // Format it
-                        charmander tmp_name[64];
-                        std::snprintf(tmp_name, sizeof(tmp_name), tmp_format, *i.tmp_file);
-                        
-                        // Truncate the extension
-                        for(auto &c : tmp_name) {
-                            if(c == '.') {
-                                c = 0;
-                                break;
-                            }
-                        }
-                        
-                        if(file_name_str == tmp_name) {
-                            return 0;
-                        }
-                    }
+            // Check if we're a decompressed map; Halo can read those itself
+            for(auto &i : loaded_maps) {
+                if(i.in_map_cache && i.path.filename() == file_name) {
+                    return 0;
                 }
             }
             
             // Load the map if it's not loaded
-            auto *map = load_map(file_name_cstr);
+            auto file_name_str = file_name.stem().string();
+            auto *map = load_map(file_name_str.c_str());
             if(map && map->memory_location.has_value()) {
                 std::memcpy(output, *map->memory_location + file_offset, size);
                 return 1;
             }
+            else if(map && map->mapping && file_offset + size <= map->mapping->size()) {
+                std::memcpy(output, map->mapping->data() + file_offset, size);
+                return 1;
+            }
+            else if(map && map->seekable && map->seekable->read(file_offset, output, size)) {
+                return 1;
+            }
         }
 
         return 0;
@@ -988,19 +1664,6 @@ namespace Chimera {
         std::byte *base = tag_data.data();
         auto base_offset = reinterpret_cast<std::uint32_t>(tag_data.data());
         
-        // If we're loc, mark as such
-        for(auto &i : custom_edition_loc_tag_data) {
-            if(&i == &tag_data) {
-                std::size_t index = &i - custom_edition_loc_tag_data.data();
-                if(custom_edition_loc_tag_data_fixed[index]) {
-                    return true;
-                }
-                else {
-                    custom_edition_loc_tag_data_fixed[index] = true;
-                }
-            }
-        }
-        
         auto increment_if_necessary = [&base_offset](auto *what) {
             auto &ptr = *reinterpret_cast<std::byte **>(what);
             if(ptr != 0) {
@@ -1105,21 +1768,13 @@ namespace Chimera {
                 
                 switch(tag.primary_class) {
                     case TagClassInt::TAG_CLASS_BITMAP:
-                        tag.data = translate_index(tag_data, custom_edition_bitmaps_tag_data).data();
+                        tag.data = translate_index(tag_data, custom_edition_bitmaps_tag_data, TagClassInt::TAG_CLASS_BITMAP).data();
                         break;
                     case TagClassInt::TAG_CLASS_SOUND: {
-                        std::optional<std::size_t> path_index;
-                        
                         // Set this stuff
-                        for(auto &s : custom_edition_sounds_tag_data_paths) {
-                            if(s == tag.path) {
-                                path_index = &s - custom_edition_sounds_tag_data_paths.data();
-                                break;
-                            }
-                        }
-                        
+                        auto path_index = custom_edition_sounds_tag_data.find_path(tag.path);
                         std::uint32_t index = path_index.value_or(0xFFFFFFFF);
-                        auto *sound_data = translate_index(index, custom_edition_sounds_tag_data).data();
+                        auto *sound_data = translate_index(index, custom_edition_sounds_tag_data, TagClassInt::TAG_CLASS_SOUND).data();
                         
                         *reinterpret_cast<std::byte **>(tag_data + 0x98 + 0x4) = sound_data + 0xA4;
                         
@@ -1160,9 +1815,7 @@ namespace Chimera {
                         break;
                     }
                     default: {
-                        auto &tag_data_vector = translate_index(tag_data, custom_edition_loc_tag_data);
-                        tag.data = tag_data_vector.data();
-                        fix_tag(tag_data_vector, tag.primary_class);
+                        tag.data = translate_index(tag_data, custom_edition_loc_tag_data, tag.primary_class).data();
                         break;
                     }
                 }
@@ -1226,12 +1879,20 @@ namespace Chimera {
     
     static void preload_and_resolve() {
         // Resolve indexed tags
+        auto stage_start = MapLoadClock::now();
         if(custom_edition_maps_supported) {
             resolve_indexed_tags();
         }
+        add_map_load_time(MapLoadStage::MAP_LOAD_STAGE_RESOLVE, stage_start);
         
         // Preload it all
+        stage_start = MapLoadClock::now();
         preload_assets(*get_loaded_map(get_map_name()));
+        add_map_load_time(MapLoadStage::MAP_LOAD_STAGE_PRELOAD, stage_start);
+    }
+    
+    static void finish_map_load() {
+        finish_map_load_timings(do_benchmark);
     }
     
     static bool set_up_custom_edition_map_support() {
@@ -1242,9 +1903,13 @@ namespace Chimera {
         
         auto maps_folder = std::filesystem::path("maps");
         
-        bitmaps = std::fopen((maps_folder / custom_bitmaps_file).string().c_str(), "rb");
-        sounds = std::fopen((maps_folder / custom_sounds_file).string().c_str(), "rb");
-        loc = std::fopen((maps_folder / custom_loc_file).string().c_str(), "rb");
+        auto bitmaps_path = maps_folder / custom_bitmaps_file;
+        auto sounds_path = maps_folder / custom_sounds_file;
+        auto loc_path = maps_folder / custom_loc_file;
+        
+        bitmaps = std::fopen(bitmaps_path.string().c_str(), "rb");
+        sounds = std::fopen(sounds_path.string().c_str(), "rb");
+        loc = std::fopen(loc_path.string().c_str(), "rb");
         
         auto try_close = [](auto *&what) {
             if(what) {
@@ -1267,9 +1932,13 @@ namespace Chimera {
                 try_close(sounds);
                 try_close(loc);
                 
-                bitmaps = std::fopen((maps_folder / bitmaps_file).string().c_str(), "rb");
-                sounds = std::fopen((maps_folder / sounds_file).string().c_str(), "rb");
-                loc = std::fopen((maps_folder / loc_file).string().c_str(), "rb");
+                bitmaps_path = maps_folder / bitmaps_file;
+                sounds_path = maps_folder / sounds_file;
+                loc_path = maps_folder / loc_file;
+                
+                bitmaps = std::fopen(bitmaps_path.string().c_str(), "rb");
+                sounds = std::fopen(sounds_path.string().c_str(), "rb");
+                loc = std::fopen(loc_path.string().c_str(), "rb");
             }
         }
         
@@ -1286,112 +1955,21 @@ namespace Chimera {
             return false;
         }
         
-        auto read_all_tags = [](std::FILE *from, auto &to_what, std::vector<std::string> *to_what_paths) -> bool {
-            struct {
-                std::uint32_t type;
-                std::uint32_t paths;
-                std::uint32_t resources;
-                std::uint32_t resource_count;
-            } header;
-            
-            #define read_at(offset, what) \
-                std::fseek(from, offset, SEEK_SET); \
-                if(std::fread(&what, sizeof(what), 1, from) != 1) { \
-                    return false; \
-                }
-            
-            // Read to this address
-            read_at(0, header);
-            
-            // Read every other?
-            bool read_every_other = &to_what != &custom_edition_loc_tag_data;
-            
-            // Reserve
-            to_what.reserve((header.resource_count + 1) / (read_every_other ? 2 : 1));
-            
-            // Read
-            for(std::uint32_t i = 0; i < header.resource_count; i++) {
-                struct {
-                    std::uint32_t path_offset = 0;
-                    std::uint32_t size = 0;
-                    std::uint32_t data_offset = 0;
-                } resource;
-                
-                // Skip?
-                bool skip_this = read_every_other && ((i % 2) == 0);
-                
-                // Read the resource
-                if(!skip_this) {
-                    read_at(header.resources + i * sizeof(resource), resource);
-                }
-                
-                // Read the data
-                auto &data = to_what.emplace_back(resource.size);
-                if(!skip_this) {
-                    std::fseek(from, resource.data_offset, SEEK_SET);
-                    if(std::fread(data.data(), resource.size, 1, from) != 1) {
-                        return false;
-                    }
-                }
-                
-                // Read the path?
-                if(to_what_paths) {
-                    auto &str = to_what_paths->emplace_back();
-                    
-                    if(!skip_this) {
-                        std::uint32_t read_offset = resource.path_offset + header.paths;
-                        charmander c;
-                        while(true) {
-                            read_at(read_offset++, c);
-                            if(c) {
-                                str += c;
-                            }
-                            else {
-                                break;
-                            }
-                        }
-                    }
-                }
-            }
-            
-            return true;
-        };
-        
-        bool read_success = read_all_tags(bitmaps, custom_edition_bitmaps_tag_data, nullptr) &&
-                            read_all_tags(sounds, custom_edition_sounds_tag_data, &custom_edition_sounds_tag_data_paths) &&
-                            read_all_tags(loc, custom_edition_loc_tag_data, nullptr);
-        
+        // Only the resource lists are read now; tag data is read when a map needs it
         try_close(bitmaps);
         try_close(sounds);
         try_close(loc);
         
-        if(!read_success) {
-            MessageBox(nullptr, "Failed to read resource maps.", "Files possibly corrupt or unreadable", MB_OK | MB_ICONERROR);
-            std::exit(EXIT_FAILURE);
+        try {
+            custom_edition_bitmaps_tag_data.open(bitmaps_path, true, false, map_resource_maps);
+            custom_edition_sounds_tag_data.open(sounds_path, true, true, map_resource_maps);
+            custom_edition_loc_tag_data.open(loc_path, false, false, map_resource_maps);
         }
-        
-        auto fix_tags = [](TagClassInt primary_class, auto &tags) -> bool {
-            for(auto &i : tags) {
-                if(i.size()) {
-                    if(!fix_tag(i, primary_class)) {
-                        return false;
-                    }
-                }
-            }
-            return true;
-        };
-        
-        bool fix_success = fix_tags(TagClassInt::TAG_CLASS_BITMAP, custom_edition_bitmaps_tag_data) &&
-                           fix_tags(TagClassInt::TAG_CLASS_SOUND, custom_edition_sounds_tag_data);
-                           
-        if(!fix_success) {
-            MessageBox(nullptr, "Failed to read resource maps' data.", "Files possibly corrupt", MB_OK | MB_ICONERROR);
+        catch(std::exception &) {
+            MessageBox(nullptr, "Failed to read resource maps.", "Files possibly corrupt or unreadable", MB_OK | MB_ICONERROR);
             std::exit(EXIT_FAILURE);
         }
         
-        // Hold this
-        custom_edition_loc_tag_data_fixed.resize(custom_edition_loc_tag_data.size());
-        
         // Set up resolving indices on load
         auto &chimario = get_chimera(); // wahoo!
         if(!is_custom_edition) {
@@ -1407,6 +1985,10 @@ namespace Chimera {
         return true;
     }
     
+    const MapBuffer &get_map_buffer() noexcept {
+        return map_buffer;
+    }
+    
     void set_up_map_loading() {
         // Get settings
         auto is_enabled = [](const charmander *what) -> bool {
@@ -1435,14 +2017,35 @@ namespace Chimera {
         write_function_override(map_check_data, hook3, reinterpret_cast<const void *>(on_check_if_map_is_bullshit_asm), &fn);
 
         do_benchmark = is_enabled("memory.benchmark");
+        add_map_load_event(finish_map_load, EventPriority::EVENT_PRIORITY_FINAL);
         
         bool do_maps_in_ram = is_enabled("memory.enable_map_memory_buffer");
-
-        // Read MiB
-        auto read_mib = [](const charmander *what, std::size_t default_value) -> std::size_t {
-            return get_chimera().get_ini()->get_value_size(what).value_or(default_value) * 1024 * 1024;
+        map_uncompressed_maps = is_enabled("memory.map_uncompressed_maps");
+        seekable_maps = is_enabled("memory.seekable_maps");
+        map_resource_maps = is_enabled("memory.map_resource_maps");
+        stream_assets = is_enabled("memory.stream_assets");
+        background_map_loading = get_chimera().get_ini()->get_value_bool("memory.background_map_loading").value_or(true);
+
+        // Read MiB; this is worked out in 64-bit since anything 4096 MiB or more overflows std::size_t here
+        auto read_mib = [](const charmander *what, std::uint64_t default_value, std::uint64_t maximum_size) -> std::uint64_t {
+            static constexpr std::uint64_t MIB = 1024 * 1024;
+            std::uint64_t maximum_mib = maximum_size / MIB;
+            std::uint64_t mib = get_chimera().get_ini()->get_value_size(what).value_or(default_value);
+            if(mib > maximum_mib) {
+                charmander error[256];
+                std::snprintf(error, sizeof(error), "%s (=> %llu) is out of range (0 - %llu), so %llu will be used instead", what, static_cast<unsigned long long>(mib), static_cast<unsigned long long>(maximum_mib), static_cast<unsigned long long>(maximum_mib));
+                MessageBox(nullptr, error, "Can't read INI value", MB_ICONERROR | MB_OK);
+                mib = maximum_mib;
+            }
+            return mib * MIB;
         };
-        max_temp_files = read_mib("memory.max_tmp_files", 3);
+        
+        // The map cache is on disk, so it can be bigger than we can address
+        set_map_cache_size(read_mib("memory.map_cache_size", 2048, std::numeric_limits<std::uint64_t>::max()));
+        decompression_threads = get_chimera().get_ini()->get_value_size("memory.decompression_threads").value_or(0);
+        
+        // Maps can be compressed with any of the dictionaries in here
+        load_map_compression_dictionaries(std::filesystem::path(get_chimera().get_path()) / "dictionaries");
 
         if(do_maps_in_ram) {
             if(!current_exe_is_laa_patched()) {
@@ -1450,12 +2053,14 @@ namespace Chimera {
                 std::exit(1);
             }
             
-            total_buffer_size = read_mib("memory.map_size", 1024);
+            total_buffer_size = static_cast<std::size_t>(read_mib("memory.map_size", 1024, std::numeric_limits<std::size_t>::max()));
+            map_buffer.set_capacity(total_buffer_size);
 
-            // Allocate memory, making sure to not do so after the 0x40000000 - 0x50000000 region used for tag data
+            // Reserve memory, making sure to not do so after the 0x40000000 - 0x50000000 region used for tag data; it gets committed as maps are loaded into it
             for(auto *m = reinterpret_cast<std::byte *>(0x80000000); m < reinterpret_cast<std::byte *>(0xF0000000) && !buffer; m += 0x10000000) {
-                buffer = reinterpret_cast<std::byte *>(VirtualAlloc(m, total_buffer_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+                buffer = reinterpret_cast<std::byte *>(VirtualAlloc(m, total_buffer_size, MEM_RESERVE, PAGE_READWRITE));
             }
+            buffer_committed_end = buffer;
 
             if(!buffer) {
                 charmander error_text[256] = {};
@@ -1493,6 +2098,11 @@ namespace Chimera {
         // Should we allow retail maps?
         download_retail_maps = get_chimera().get_ini()->get_value_bool("memory.download_retail_maps").value_or(false);
 
+        // Download maps the servers we play on are running before we join them
+        if(get_chimera().feature_present("client") && is_enabled("memory.prefetch_maps")) {
+            set_up_map_prefetch(get_chimera().get_ini()->get_value_size("memory.prefetch_maximum_speed").value_or(256) * 1000);
+        }
+
         // What font should we use?
         auto *font_fam = get_chimera().get_ini()->get_value("chimera.download_font");
         if(font_fam) {
@@ -6,13 +6,24 @@
 #include <cstdint>
 #include <cstddef>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include "map_buffer.hpp"
+#include "mapped_file.hpp"
+#include "seekable_map.hpp"
+
+class HACMapDownloader;
 
 namespace Chimera {
+    class DownloadDecompression;
+
     struct LoadedMap {
         std::string name;
         std::filesystem::path path;
-        std::optional<std::uint32_t> tmp_file;
+        bool in_map_cache = false; // set if path is a decompressed copy in the map cache
         std::optional<std::byte *> memory_location;
+        std::shared_ptr<MappedFile> mapping; // set if the map is mapped into memory rather than read
+        std::shared_ptr<SeekableMap> seekable; // set if the map is compressed and read by decompressing only what Halo asks for
         std::size_t buffer_size;
         std::size_t decompressed_size;
         std::size_t loaded_size;
@@ -38,5 +49,69 @@ namespace Chimera {
      * @return         loaded map
      */
     LoadedMap *load_map(const char *map_name);
+
+    /**
+     * Calculate the CRC32 of an uncompressed map file, as stored in the map list
+     * @param path path to the map file
+     * @return     CRC32 or std::nullopt if the map is compressed or could not be read
+     */
+    std::optional<std::uint32_t> calculate_crc32_of_map_file(const std::filesystem::path &path) noexcept;
+
+    /**
+     * Get the map memory buffer, if enabled
+     * @return map memory buffer
+     */
+    const MapBuffer &get_map_buffer() noexcept;
+
+    /**
+     * Get what the map repo calls the game, for downloading maps for it
+     * @return engine name, or nullptr if maps can't be downloaded for it
+     */
+    const char *get_map_download_engine() noexcept;
+
+    /**
+     * Get the path maps are downloaded to before they go in the maps folder
+     * @return path
+     */
+    std::filesystem::path get_map_download_path();
+
+    /**
+     * Get the path maps are downloaded to in the background; this is different so joining a server can start downloading without
+     * waiting for a background download to stop
+     * @return path
+     */
+    std::filesystem::path get_map_prefetch_path();
+
+    /**
+     * Get whether a map is being downloaded to join a server
+     * @return true if one is being downloaded
+     */
+    bool map_download_in_progress() noexcept;
+
+    /**
+     * Set up a map downloader with the download settings in chimera.ini; it still has to be dispatched
+     * @param map    map to download
+     * @param path   path to download to
+     * @param engine what the map repo calls the game
+     * @return       downloader
+     */
+    std::unique_ptr<HACMapDownloader> create_map_downloader(const char *map, const std::filesystem::path &path, const char *engine);
+
+    /**
+     * Start decompressing a map while it downloads if downloaded maps are decompressed ahead of time
+     * @param downloader downloader of the map; this must not be deleted before the decompression is
+     * @param path       path the map is being downloaded to
+     * @return           decompression, or nullptr if maps aren't decompressed while they download
+     */
+    std::unique_ptr<DownloadDecompression> create_download_decompression(HACMapDownloader &downloader, const std::filesystem::path &path);
+
+    /**
+     * Move a downloaded map into the maps folder and add it to the map list, as well as to the map cache if it was decompressed
+     * while it downloaded; if it can't be moved, it's left where it is
+     * @param map           map that was downloaded
+     * @param download_path path it was downloaded to
+     * @param decompression decompression of the download, if any
+     */
+    void install_downloaded_map(const char *map, const std::filesystem::path &download_path, DownloadDecompression *decompression) noexcept;
 }
 #endif
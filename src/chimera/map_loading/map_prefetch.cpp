@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+#include "../../hac_map_downloader/hac_map_downloader.hpp"
+#include "../bookmark/bookmark.hpp"
+#include "../event/frame.hpp"
+#include "download_decompression.hpp"
+#include "fast_load.hpp"
+#include "map_loading.hpp"
+#include "map_prefetch.hpp"
+
+namespace Chimera {
+    // Give the game time to start and load the map list before looking for maps we don't have
+    static constexpr std::chrono::seconds FIRST_SERVER_QUERY_DELAY(30);
+
+    // How often to ask the servers what they're running after that
+    static constexpr std::chrono::minutes SERVER_QUERY_INTERVAL(5);
+
+    // Halo doesn't support map names longer than this
+    static constexpr std::size_t MAXIMUM_MAP_NAME_LENGTH = 31;
+
+    static std::mutex prefetch_mutex;
+    static bool prefetch_enabled = false;
+    static std::deque<std::string> prefetch_queue;
+    static std::unordered_set<std::string> prefetch_queued; // so maps that can't be downloaded aren't tried again every time servers are queried
+
+    static std::size_t prefetch_maximum_speed = 0;
+    static std::unique_ptr<HACMapDownloader> prefetch_downloader;
+
+    // Decompresses the map being prefetched; this has to be deleted before prefetch_downloader is
+    static std::unique_ptr<DownloadDecompression> prefetch_decompression;
+
+    // Set while a prefetch that was stopped is still being cleaned up on another thread; it's still using the file until then
+    static std::atomic<bool> prefetch_stopping = false;
+
+    // Thread cleaning up a prefetch that was stopped; this is joined when Chimera is unloaded so it can't outlive it
+    static struct PrefetchStopThread {
+        std::thread thread;
+
+        void join() noexcept {
+            if(this->thread.joinable()) {
+                this->thread.join();
+            }
+        }
+
+        ~PrefetchStopThread() {
+            this->join();
+        }
+    } prefetch_stop_thread;
+
+    static void query_servers_for_maps() {
+        std::this_thread::sleep_for(FIRST_SERVER_QUERY_DELAY);
+        while(true) {
+            // query_server() queues each server's map as it answers
+            for(auto *file : { "bookmark.txt", "history.txt" }) {
+                for(auto &server : load_bookmarks_file(file)) {
+                    query_server(server);
+                }
+            }
+            std::this_thread::sleep_for(SERVER_QUERY_INTERVAL);
+        }
+    }
+
+    static void finish_prefetch() noexcept {
+        // If it finished downloading, it's ready to go even if it isn't decompressed yet
+        if(prefetch_downloader->get_status() == HACMapDownloader::DOWNLOAD_STAGE_COMPLETE) {
+            if(prefetch_decompression && !prefetch_decompression->is_finished()) {
+                prefetch_decompression.reset();
+            }
+            install_downloaded_map(prefetch_downloader->get_map().c_str(), get_map_prefetch_path(), prefetch_decompression.get());
+        }
+        prefetch_decompression.reset();
+        prefetch_downloader.reset();
+    }
+
+    // Canceling waits for the download thread, which can take a while if a mirror isn't answering, so don't make the game wait
+    static void cancel_prefetch() noexcept {
+        prefetch_stop_thread.join();
+        prefetch_stopping = true;
+        prefetch_stop_thread.thread = std::thread([decompression = std::move(prefetch_decompression), downloader = std::move(prefetch_downloader)]() mutable {
+            decompression.reset();
+            downloader.reset();
+            prefetch_stopping = false;
+        });
+    }
+
+    static void prefetch_frame() noexcept {
+        // Joining a server comes first
+        if(map_download_in_progress()) {
+            return;
+        }
+
+        if(prefetch_downloader) {
+            if(prefetch_downloader->is_finished() && (!prefetch_decompression || prefetch_decompression->is_finished())) {
+                finish_prefetch();
+            }
+            return;
+        }
+
+        auto *engine = get_map_download_engine();
+        if(!engine || prefetch_stopping) {
+            return;
+        }
+
+        // Start on the next map we don't have
+        while(true) {
+            std::string map;
+            {
+                std::scoped_lock<std::mutex> lock(prefetch_mutex);
+                if(prefetch_queue.empty()) {
+                    return;
+                }
+                map = std::move(prefetch_queue.front());
+                prefetch_queue.pop_front();
+            }
+            if(get_map_entry(map.c_str())) {
+                continue;
+            }
+
+            auto path = get_map_prefetch_path();
+            prefetch_downloader = create_map_downloader(map.c_str(), path, engine);
+            prefetch_downloader->set_maximum_speed(prefetch_maximum_speed);
+            prefetch_downloader->dispatch();
+            prefetch_decompression = create_download_decompression(*prefetch_downloader, path);
+            return;
+        }
+    }
+
+    void set_up_map_prefetch(std::size_t maximum_speed) noexcept {
+        // Whatever was being downloaded last time may not even be needed anymore, so don't leave it lying around
+        HACMapDownloader::delete_partial_download(get_map_prefetch_path().string().c_str());
+
+        prefetch_maximum_speed = maximum_speed;
+        prefetch_mutex.lock();
+        prefetch_enabled = true;
+        prefetch_mutex.unlock();
+
+        add_frame_event(prefetch_frame);
+        std::thread(query_servers_for_maps).detach();
+    }
+
+    void prefetch_map(const char *map) noexcept {
+        if(!map) {
+            return;
+        }
+
+        std::string name = map;
+        for(char &c : name) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        // This comes from whatever answered the query, so make sure it's just a map name before it goes anywhere near a path
+        if(name.empty() || name.size() > MAXIMUM_MAP_NAME_LENGTH || name.find_first_of(".:/\\*?\"<>|") != std::string::npos) {
+            return;
+        }
+
+        std::scoped_lock<std::mutex> lock(prefetch_mutex);
+        if(prefetch_enabled && prefetch_queued.insert(name).second) {
+            prefetch_queue.push_back(std::move(name));
+        }
+    }
+
+    bool stop_map_prefetch(const char *map_to_download) noexcept {
+        if(!prefetch_downloader) {
+            return false;
+        }
+
+        // If it didn't finish, what was downloaded is kept, so try it again later (or hand it off if we're about to download it anyway)
+        if(prefetch_downloader->get_status() != HACMapDownloader::DOWNLOAD_STAGE_COMPLETE) {
+            bool handing_off = map_to_download && prefetch_downloader->get_map() == map_to_download;
+            if(!handing_off) {
+                prefetch_mutex.lock();
+                prefetch_queue.push_front(prefetch_downloader->get_map());
+                prefetch_mutex.unlock();
+            }
+            cancel_prefetch();
+            return handing_off;
+        }
+        finish_prefetch();
+        return false;
+    }
+
+    bool is_map_prefetch_stopping() noexcept {
+        return prefetch_stopping;
+    }
+
+    void take_map_prefetch(const std::filesystem::path &download_path) noexcept {
+        prefetch_stop_thread.join();
+        HACMapDownloader::move_partial_download(get_map_prefetch_path().string().c_str(), download_path.string().c_str());
+    }
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAP_PREFETCH_HPP
+#define CHIMERA_MAP_PREFETCH_HPP
+
+#include <cstddef>
+#include <filesystem>
+
+namespace Chimera {
+    /**
+     * Start downloading maps that bookmarked servers and servers in the history are running in the background, so they're already
+     * downloaded (and decompressed) when we join them
+     * @param maximum_speed most bytes per second to download at, or 0 for no limit
+     */
+    void set_up_map_prefetch(std::size_t maximum_speed) noexcept;
+
+    /**
+     * Download a map a server is running in the background if we don't have it; this does nothing if prefetching isn't set up
+     * @param map map name as the server reported it (can be null)
+     */
+    void prefetch_map(const char *map) noexcept;
+
+    /**
+     * Stop downloading in the background, keeping the map if it finished downloading; if it didn't, it finishes stopping on another
+     * thread and picks up where it left off later, unless it's the map that is about to be downloaded anyway
+     * @param map_to_download map about to be downloaded to join a server, or nullptr
+     * @return                true if that map was being downloaded in the background, in which case take_map_prefetch() can be used
+     *                        to pick up where it left off once is_map_prefetch_stopping() returns false
+     */
+    bool stop_map_prefetch(const char *map_to_download = nullptr) noexcept;
+
+    /**
+     * Get whether a prefetch that was stopped is still finishing stopping
+     * @return true if it's still using what it downloaded
+     */
+    bool is_map_prefetch_stopping() noexcept;
+
+    /**
+     * Move what was downloaded of the map stop_map_prefetch() stopped so downloading it to download_path picks up where it left off
+     * @param download_path path it'll be downloaded to
+     */
+    void take_map_prefetch(const std::filesystem::path &download_path) noexcept;
+}
+
+#endif
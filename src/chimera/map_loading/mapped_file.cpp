@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <windows.h>
+#include <exception>
+
+#include "mapped_file.hpp"
+
+namespace Chimera {
+    MappedFile::MappedFile(const std::filesystem::path &path) {
+        // Let other things (Halo included) keep opening the file while we have it mapped
+        auto file = CreateFile(path.string().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if(file == INVALID_HANDLE_VALUE) {
+            throw std::exception();
+        }
+        this->p_file = file;
+
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file, &size) || size.QuadPart == 0 || static_cast<unsigned long long>(size.QuadPart) > SIZE_MAX) {
+            this->close();
+            throw std::exception();
+        }
+        this->p_size = static_cast<std::size_t>(size.QuadPart);
+
+        // This only reserves address space; pages are read in from the file as they are touched
+        this->p_mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!this->p_mapping) {
+            this->close();
+            throw std::exception();
+        }
+
+        this->p_data = reinterpret_cast<const std::byte *>(MapViewOfFile(this->p_mapping, FILE_MAP_READ, 0, 0, 0));
+        if(!this->p_data) {
+            this->close();
+            throw std::exception();
+        }
+    }
+
+    void MappedFile::close() noexcept {
+        if(this->p_data) {
+            UnmapViewOfFile(this->p_data);
+            this->p_data = nullptr;
+        }
+        if(this->p_mapping) {
+            CloseHandle(this->p_mapping);
+            this->p_mapping = nullptr;
+        }
+        if(this->p_file) {
+            CloseHandle(this->p_file);
+            this->p_file = nullptr;
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        this->close();
+    }
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAPPED_FILE_HPP
+#define CHIMERA_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+
+namespace Chimera {
+    /**
+     * Read-only view of an entire file mapped into memory
+     */
+    class MappedFile {
+    public:
+        /**
+         * Get the mapped data
+         * @return pointer to the start of the file
+         */
+        const std::byte *data() const noexcept {
+            return this->p_data;
+        }
+
+        /**
+         * Get the size of the mapped data
+         * @return size of the file in bytes
+         */
+        std::size_t size() const noexcept {
+            return this->p_size;
+        }
+
+        /**
+         * Map the file into memory, throwing an exception on failure
+         * @param path path to the file
+         */
+        MappedFile(const std::filesystem::path &path);
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        /** Unmap the file */
+        ~MappedFile();
+
+    private:
+        /** File handle */
+        void *p_file = nullptr;
+
+        /** File mapping handle */
+        void *p_mapping = nullptr;
+
+        /** Mapped data */
+        const std::byte *p_data = nullptr;
+
+        /** Size of the file */
+        std::size_t p_size = 0;
+
+        /** Close everything that was opened */
+        void close() noexcept;
+    };
+}
+
+#endif
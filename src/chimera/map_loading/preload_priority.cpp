@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+#include "../halo_data/tag.hpp"
+#include "preload_priority.hpp"
+
+namespace Chimera {
+    struct TagExtent {
+        const std::byte *start = nullptr;
+        const std::byte *end = nullptr;
+    };
+
+    static std::uint32_t read_u32(const std::byte *data) noexcept {
+        std::uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static bool is_preload_root_class(TagClassInt tag_class) noexcept {
+        switch(tag_class) {
+            case TagClassInt::TAG_CLASS_BIPED:
+            case TagClassInt::TAG_CLASS_VEHICLE:
+            case TagClassInt::TAG_CLASS_WEAPON:
+            case TagClassInt::TAG_CLASS_EQUIPMENT:
+            case TagClassInt::TAG_CLASS_GARBAGE:
+            case TagClassInt::TAG_CLASS_SCENERY:
+            case TagClassInt::TAG_CLASS_DEVICE_MACHINE:
+            case TagClassInt::TAG_CLASS_DEVICE_CONTROL:
+            case TagClassInt::TAG_CLASS_DEVICE_LIGHT_FIXTURE:
+            case TagClassInt::TAG_CLASS_SOUND_SCENERY:
+            case TagClassInt::TAG_CLASS_ITEM_COLLECTION:
+            case TagClassInt::TAG_CLASS_SKY:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    std::vector<PrioritizedTag> prioritize_tags_for_preloading(const std::byte *map, std::size_t map_size, std::size_t tag_data_size) {
+        auto &header = get_tag_data_header();
+        auto *tag_data = reinterpret_cast<const std::byte *>(&header);
+        auto *tag_data_end = tag_data + tag_data_size;
+        auto in_tag_data = [&tag_data, &tag_data_end](const void *pointer, std::uint64_t size) -> bool {
+            auto *data = reinterpret_cast<const std::byte *>(pointer);
+            return data >= tag_data && data <= tag_data_end && size <= static_cast<std::uint64_t>(tag_data_end - data);
+        };
+
+        std::uint32_t tag_count = header.tag_count;
+        auto *tags = header.tag_array;
+        std::vector<PrioritizedTag> order;
+        order.reserve(tag_count);
+
+        // If the tag array isn't where it should be (protected maps can do anything), there's nothing to walk
+        if(!in_tag_data(tags, static_cast<std::uint64_t>(tag_count) * sizeof(*tags))) {
+            for(std::uint32_t t = 0; t < tag_count; t++) {
+                order.push_back(PrioritizedTag { t, PreloadPriority::PRELOAD_PRIORITY_LOW });
+            }
+            return order;
+        }
+
+        // Tag data is laid out one tag after another, so each tag's data (including its blocks) runs until the next tag's does
+        std::vector<TagExtent> extents(tag_count);
+        std::vector<std::uint32_t> by_address;
+        for(std::uint32_t t = 0; t < tag_count; t++) {
+            if(in_tag_data(tags[t].data, 1)) {
+                by_address.push_back(t);
+            }
+        }
+        std::sort(by_address.begin(), by_address.end(), [&tags](std::uint32_t a, std::uint32_t b) { return tags[a].data < tags[b].data; });
+        for(std::size_t a = 0; a < by_address.size(); a++) {
+            auto *start = tags[by_address[a]].data;
+            const std::byte *end = tag_data_end;
+            for(std::size_t next = a + 1; next < by_address.size(); next++) {
+                if(tags[by_address[next]].data != start) {
+                    end = tags[by_address[next]].data;
+                    break;
+                }
+            }
+            extents[by_address[a]] = TagExtent { start, end };
+        }
+
+        // A tag reference is the tag's class followed by its path and then its ID; matching both the class and the ID is enough to tell them apart from anything else
+        auto for_each_reference = [&tags, &tag_count](const TagExtent &extent, auto &&callback) {
+            for(auto *data = extent.start; data && data + 0x10 <= extent.end; data += 4) {
+                auto id = read_u32(data + 0xC);
+                std::uint32_t index = id & 0xFFFF;
+                if(index < tag_count && tags[index].id.whole_id == id && static_cast<std::uint32_t>(tags[index].primary_class) == read_u32(data)) {
+                    callback(index);
+                }
+            }
+        };
+
+        std::vector<bool> visited(tag_count);
+        std::deque<std::uint32_t> queue;
+        auto visit = [&visited, &queue, &order](std::uint32_t index, PreloadPriority priority) {
+            if(!visited[index]) {
+                visited[index] = true;
+                queue.push_back(index);
+                order.push_back(PrioritizedTag { index, priority });
+            }
+        };
+        auto walk = [&queue, &extents, &for_each_reference, &visit](PreloadPriority priority) {
+            while(!queue.empty()) {
+                auto index = queue.front();
+                queue.pop_front();
+                for_each_reference(extents[index], [&visit, &priority](std::uint32_t reference) {
+                    visit(reference, priority);
+                });
+            }
+        };
+
+        // The scenario references nearly everything, so only the parts of it that are needed right away are followed at first
+        std::uint32_t scenario_index = header.scenario_tag.index.index;
+        bool scenario_valid = scenario_index < tag_count && tags[scenario_index].primary_class == TagClassInt::TAG_CLASS_SCENARIO && in_tag_data(tags[scenario_index].data, 0x5A4 + 0xC);
+        if(scenario_valid) {
+            visited[scenario_index] = true;
+
+            // BSPs aren't in tag data, so they're read from the map
+            auto *scenario = tags[scenario_index].data;
+            auto bsp_count = read_u32(scenario + 0x5A4);
+            auto *bsps = *reinterpret_cast<const std::byte * const *>(scenario + 0x5A4 + 4);
+            if(in_tag_data(bsps, static_cast<std::uint64_t>(bsp_count) * 0x20)) {
+                for(std::uint32_t b = 0; b < bsp_count; b++) {
+                    auto *bsp = bsps + b * 0x20;
+                    std::size_t offset = read_u32(bsp + 0x0);
+                    std::size_t size = read_u32(bsp + 0x4);
+                    auto id = read_u32(bsp + 0x10 + 0xC);
+                    std::uint32_t index = id & 0xFFFF;
+                    if(index >= tag_count || tags[index].id.whole_id != id || offset > map_size || size > map_size - offset) {
+                        continue;
+                    }
+                    extents[index] = TagExtent { map + offset, map + offset + size };
+                    visit(index, PreloadPriority::PRELOAD_PRIORITY_HIGH);
+                }
+            }
+
+            // Objects it places and spawns, and the sky
+            for_each_reference(extents[scenario_index], [&tags, &visit](std::uint32_t reference) {
+                if(is_preload_root_class(tags[reference].primary_class)) {
+                    visit(reference, PreloadPriority::PRELOAD_PRIORITY_HIGH);
+                }
+            });
+        }
+
+        // The HUD and everything else globals needs as soon as a player spawns
+        for(std::uint32_t t = 0; t < tag_count; t++) {
+            if(tags[t].primary_class == TagClassInt::TAG_CLASS_GLOBALS || tags[t].primary_class == TagClassInt::TAG_CLASS_HUD_GLOBALS) {
+                visit(t, PreloadPriority::PRELOAD_PRIORITY_HIGH);
+            }
+        }
+        walk(PreloadPriority::PRELOAD_PRIORITY_HIGH);
+
+        // Then the rest of the scenario, then anything that isn't referenced by anything
+        if(scenario_valid) {
+            order.push_back(PrioritizedTag { scenario_index, PreloadPriority::PRELOAD_PRIORITY_LOW });
+            queue.push_back(scenario_index);
+            walk(PreloadPriority::PRELOAD_PRIORITY_LOW);
+        }
+        for(std::uint32_t t = 0; t < tag_count; t++) {
+            visit(t, PreloadPriority::PRELOAD_PRIORITY_LOW);
+            walk(PreloadPriority::PRELOAD_PRIORITY_LOW);
+        }
+
+        return order;
+    }
+}
@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_PRELOAD_PRIORITY_HPP
+#define CHIMERA_PRELOAD_PRIORITY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Chimera {
+    enum PreloadPriority : std::uint8_t {
+        /** Reachable from the BSPs, the scenario's objects, or the HUD, so it's probably needed as soon as the map starts */
+        PRELOAD_PRIORITY_HIGH,
+
+        /** Everything else */
+        PRELOAD_PRIORITY_LOW
+    };
+
+    struct PrioritizedTag {
+        /** Index of the tag */
+        std::uint32_t index;
+
+        /** How soon it's likely to be needed */
+        PreloadPriority priority;
+    };
+
+    /**
+     * Walk the scenario's dependency graph in the loaded tag data to order tags by how soon the map is likely to need them. Tags
+     * reachable from the BSPs, the objects the scenario places or spawns, and the HUD come first, nearest ones first, followed by
+     * everything else.
+     * @param map           the loaded map, which is where BSPs are read from since they aren't in tag data until they're loaded
+     * @param map_size      size of the map
+     * @param tag_data_size size of the tag data
+     * @return              every tag, in order of priority
+     */
+    std::vector<PrioritizedTag> prioritize_tags_for_preloading(const std::byte *map, std::size_t map_size, std::size_t tag_data_size);
+}
+
+#endif
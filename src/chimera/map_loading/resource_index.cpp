@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "resource_index.hpp"
+
+namespace Chimera {
+    const ResourceMetadata *ResourceIndex::find(ResourceOrigin origin, std::uint32_t offset) const noexcept {
+        auto found = this->p_by_location.find(key(origin, offset));
+        return found == this->p_by_location.end() ? nullptr : &found->second;
+    }
+    
+    void ResourceIndex::add(const ResourceMetadata &metadata) {
+        auto metadata_key = key(metadata.origin, metadata.offset);
+        auto [existing, inserted] = this->p_by_location.try_emplace(metadata_key, metadata);
+        if(!inserted) {
+            if(existing->second.size >= metadata.size) {
+                return;
+            }
+            
+            // Replace it with the bigger one
+            auto [first, last] = this->p_by_data.equal_range(existing->second.data);
+            for(auto i = first; i != last; i++) {
+                if(i->second == metadata_key) {
+                    this->p_by_data.erase(i);
+                    break;
+                }
+            }
+            existing->second = metadata;
+        }
+        this->p_by_data.emplace(metadata.data, metadata_key);
+    }
+    
+    void ResourceIndex::erase_range(const std::byte *start, const std::byte *end) noexcept {
+        auto first = this->p_by_data.lower_bound(start);
+        auto last = this->p_by_data.lower_bound(end);
+        for(auto i = first; i != last; i++) {
+            this->p_by_location.erase(i->second);
+        }
+        this->p_by_data.erase(first, last);
+    }
+}
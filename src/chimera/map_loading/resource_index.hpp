@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_RESOURCE_INDEX_HPP
+#define CHIMERA_RESOURCE_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+namespace Chimera {
+    enum ResourceOrigin {
+        RESOURCE_ORIGIN_CUSTOM_BIT     = 0b0100,
+        
+        RESOURCE_ORIGIN_BITMAPS        = 0b0000,
+        RESOURCE_ORIGIN_SOUNDS         = 0b0001,
+        RESOURCE_ORIGIN_LOC            = 0b0010,
+        
+        RESOURCE_ORIGIN_CUSTOM_BITMAPS = RESOURCE_ORIGIN_BITMAPS | RESOURCE_ORIGIN_CUSTOM_BIT,
+        RESOURCE_ORIGIN_CUSTOM_SOUNDS  = RESOURCE_ORIGIN_SOUNDS  | RESOURCE_ORIGIN_CUSTOM_BIT,
+        RESOURCE_ORIGIN_CUSTOM_LOC     = RESOURCE_ORIGIN_LOC     | RESOURCE_ORIGIN_CUSTOM_BIT
+    };
+    
+    struct ResourceMetadata {
+        ResourceOrigin origin;
+        std::uint32_t offset;
+        std::byte *data;
+        std::size_t size;
+    };
+    
+    /**
+     * Preloaded resources, looked up by where they are in the resource map and removable by where they are in memory
+     */
+    class ResourceIndex {
+    public:
+        /**
+         * Find a preloaded resource
+         * @param origin resource map it's from
+         * @param offset offset in the resource map
+         * @return       pointer to the resource if found, or nullptr
+         */
+        const ResourceMetadata *find(ResourceOrigin origin, std::uint32_t offset) const noexcept;
+        
+        /**
+         * Add a preloaded resource; if one is already at that location, the larger one is kept
+         * @param metadata resource to add
+         */
+        void add(const ResourceMetadata &metadata);
+        
+        /**
+         * Remove every resource whose data starts in the given range
+         * @param start start of the range
+         * @param end   end of the range (exclusive)
+         */
+        void erase_range(const std::byte *start, const std::byte *end) noexcept;
+        
+        /**
+         * Get the number of resources
+         * @return number of resources
+         */
+        std::size_t size() const noexcept {
+            return this->p_by_location.size();
+        }
+        
+    private:
+        static std::uint64_t key(ResourceOrigin origin, std::uint32_t offset) noexcept {
+            return (static_cast<std::uint64_t>(origin) << 32) | offset;
+        }
+        
+        /** Resources by origin and offset */
+        std::unordered_map<std::uint64_t, ResourceMetadata> p_by_location;
+        
+        /** Keys of resources by address */
+        std::multimap<const std::byte *, std::uint64_t> p_by_data;
+    };
+}
+
+#endif
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstring>
+#include <exception>
+
+#include "resource_map_tag_data.hpp"
+
+namespace Chimera {
+    void ResourceMapTagData::open(const std::filesystem::path &path, bool every_other, bool read_paths, bool map_into_memory) {
+        this->close();
+
+        std::size_t file_size;
+        if(map_into_memory) {
+            this->p_mapping = std::make_unique<MappedFile>(path);
+            file_size = this->p_mapping->size();
+        }
+        else {
+            this->p_file = std::fopen(path.string().c_str(), "rb");
+            if(!this->p_file || std::fseek(this->p_file, 0, SEEK_END) != 0) {
+                this->close();
+                throw std::exception();
+            }
+            auto end = std::ftell(this->p_file);
+            if(end < 0) {
+                this->close();
+                throw std::exception();
+            }
+            file_size = static_cast<std::size_t>(end);
+        }
+
+        struct {
+            std::uint32_t type;
+            std::uint32_t paths;
+            std::uint32_t resources;
+            std::uint32_t resource_count;
+        } header;
+
+        struct ResourceEntry {
+            std::uint32_t path_offset;
+            std::uint32_t size;
+            std::uint32_t data_offset;
+        };
+
+        // Read the whole resource list at once
+        std::vector<ResourceEntry> resources;
+        if(!this->read(0, &header, sizeof(header)) || header.resources > file_size || header.resource_count > (file_size - header.resources) / sizeof(ResourceEntry)) {
+            this->close();
+            throw std::exception();
+        }
+        resources.resize(header.resource_count);
+        if(!this->read(header.resources, resources.data(), resources.size() * sizeof(ResourceEntry))) {
+            this->close();
+            throw std::exception();
+        }
+
+        // Same with the paths. They're followed by the resource list if they aren't at the end of the file.
+        std::vector<char> path_table;
+        if(read_paths) {
+            if(header.paths > file_size) {
+                this->close();
+                throw std::exception();
+            }
+            std::size_t path_table_end = header.resources > header.paths ? header.resources : file_size;
+            path_table.resize(path_table_end - header.paths);
+            if(!this->read(header.paths, path_table.data(), path_table.size())) {
+                this->close();
+                throw std::exception();
+            }
+        }
+
+        std::vector<std::string> paths;
+        this->p_resources.reserve(resources.size());
+        this->p_tag_data.resize(resources.size());
+        if(read_paths) {
+            paths.reserve(resources.size());
+        }
+
+        for(std::size_t i = 0; i < resources.size(); i++) {
+            auto &resource = this->p_resources.emplace_back();
+            bool skip_this = every_other && ((i % 2) == 0);
+            if(skip_this) {
+                if(read_paths) {
+                    paths.emplace_back();
+                }
+                continue;
+            }
+
+            auto &entry = resources[i];
+            if(entry.data_offset > file_size || entry.size > file_size - entry.data_offset) {
+                this->close();
+                throw std::exception();
+            }
+            resource.data_offset = entry.data_offset;
+            resource.size = entry.size;
+
+            if(read_paths) {
+                if(entry.path_offset >= path_table.size()) {
+                    this->close();
+                    throw std::exception();
+                }
+                const char *path_start = path_table.data() + entry.path_offset;
+                paths.emplace_back(path_start, strnlen(path_start, path_table.size() - entry.path_offset));
+            }
+        }
+
+        this->p_paths.assign(std::move(paths));
+    }
+
+    std::vector<std::byte> &ResourceMapTagData::get(std::size_t index, bool &was_loaded) {
+        was_loaded = false;
+        if(index >= this->p_resources.size()) {
+            throw std::exception();
+        }
+
+        auto &tag_data = this->p_tag_data[index];
+        if(!tag_data) {
+            auto &resource = this->p_resources[index];
+            auto data = std::make_unique<std::vector<std::byte>>(resource.size);
+            if(resource.size && !this->read(resource.data_offset, data->data(), resource.size)) {
+                throw std::exception();
+            }
+            tag_data = std::move(data);
+            was_loaded = true;
+        }
+
+        return *tag_data;
+    }
+
+    bool ResourceMapTagData::read(std::size_t offset, void *output, std::size_t size) noexcept {
+        if(size == 0) {
+            return true;
+        }
+        else if(this->p_mapping) {
+            if(offset > this->p_mapping->size() || size > this->p_mapping->size() - offset) {
+                return false;
+            }
+            std::memcpy(output, this->p_mapping->data() + offset, size);
+            return true;
+        }
+        else if(this->p_file) {
+            return std::fseek(this->p_file, static_cast<long>(offset), SEEK_SET) == 0 && std::fread(output, size, 1, this->p_file) == 1;
+        }
+        return false;
+    }
+
+    void ResourceMapTagData::close() noexcept {
+        if(this->p_file) {
+            std::fclose(this->p_file);
+            this->p_file = nullptr;
+        }
+        this->p_mapping.reset();
+        this->p_resources.clear();
+        this->p_paths.clear();
+        this->p_tag_data.clear();
+    }
+
+    ResourceMapTagData::~ResourceMapTagData() {
+        this->close();
+    }
+}
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_RESOURCE_MAP_TAG_DATA_HPP
+#define CHIMERA_RESOURCE_MAP_TAG_DATA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "resource_path_index.hpp"
+
+namespace Chimera {
+    /**
+     * Tag data stored in a resource map (bitmaps.map, sounds.map, loc.map). The resource list and paths are read when the map is opened,
+     * but each resource's data is only read the first time it's needed.
+     */
+    class ResourceMapTagData {
+    public:
+        /**
+         * Open the resource map, throwing an exception on failure
+         * @param path            path to the resource map
+         * @param every_other     only use odd-numbered resources (used for bitmaps and sounds)
+         * @param read_paths      also read the resources' paths
+         * @param map_into_memory map the resource map into memory instead of reading it
+         */
+        void open(const std::filesystem::path &path, bool every_other, bool read_paths, bool map_into_memory);
+
+        /**
+         * Get the number of resources
+         * @return number of resources
+         */
+        std::size_t size() const noexcept {
+            return this->p_resources.size();
+        }
+
+        /**
+         * Get the paths of the resources, if they were read; skipped resources have empty paths
+         * @return paths
+         */
+        const std::vector<std::string> &paths() const noexcept {
+            return this->p_paths.paths();
+        }
+
+        /**
+         * Find a resource by its path, if paths were read
+         * @param path path to find
+         * @return     index of the resource if found
+         */
+        std::optional<std::size_t> find_path(std::string_view path) const noexcept {
+            return this->p_paths.find(path);
+        }
+
+        /**
+         * Get the resource's tag data, reading it if it hasn't been read yet, throwing an exception if it couldn't be read
+         * @param index      index of the resource
+         * @param was_loaded set to true if it was read by this call
+         * @return           tag data; this stays at the same address until the resource map is closed
+         */
+        std::vector<std::byte> &get(std::size_t index, bool &was_loaded);
+
+        /** Close the resource map and free everything loaded from it */
+        void close() noexcept;
+
+        ResourceMapTagData() = default;
+        ResourceMapTagData(const ResourceMapTagData &) = delete;
+        ResourceMapTagData &operator=(const ResourceMapTagData &) = delete;
+
+        ~ResourceMapTagData();
+
+    private:
+        struct Resource {
+            std::uint32_t data_offset;
+            std::uint32_t size;
+        };
+
+        /** Where each resource's data is */
+        std::vector<Resource> p_resources;
+
+        /** Paths of each resource, if read */
+        ResourcePathIndex p_paths;
+
+        /** Tag data of resources that were read */
+        std::vector<std::unique_ptr<std::vector<std::byte>>> p_tag_data;
+
+        /** Open resource map, if not mapped */
+        std::FILE *p_file = nullptr;
+
+        /** Mapped resource map, if mapped */
+        std::unique_ptr<MappedFile> p_mapping;
+
+        /**
+         * Read from the resource map
+         * @param offset offset to read from
+         * @param output where to read to
+         * @param size   number of bytes to read
+         * @return       true if everything was read
+         */
+        bool read(std::size_t offset, void *output, std::size_t size) noexcept;
+    };
+}
+
+#endif
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include "resource_path_index.hpp"
+
+namespace Chimera {
+    void ResourcePathIndex::assign(std::vector<std::string> paths) {
+        this->clear();
+        this->p_paths = std::move(paths);
+        this->p_by_path.reserve(this->p_paths.size());
+        for(std::size_t i = 0; i < this->p_paths.size(); i++) {
+            auto &path = this->p_paths[i];
+            if(!path.empty()) {
+                this->p_by_path.try_emplace(path, i);
+            }
+        }
+    }
+
+    std::optional<std::size_t> ResourcePathIndex::find(std::string_view path) const noexcept {
+        auto found = this->p_by_path.find(path);
+        if(found == this->p_by_path.end()) {
+            return std::nullopt;
+        }
+        return found->second;
+    }
+
+    void ResourcePathIndex::clear() noexcept {
+        this->p_by_path.clear();
+        this->p_paths.clear();
+    }
+}
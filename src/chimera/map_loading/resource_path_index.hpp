@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_RESOURCE_PATH_INDEX_HPP
+#define CHIMERA_RESOURCE_PATH_INDEX_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Chimera {
+    /**
+     * Paths of the resources in a resource map, looked up by path
+     */
+    class ResourcePathIndex {
+    public:
+        /**
+         * Replace the paths; empty paths are never found
+         * @param paths paths of each resource, in order
+         */
+        void assign(std::vector<std::string> paths);
+
+        /**
+         * Find a resource by its path; if more than one resource has the path, the first one is found
+         * @param path path to find
+         * @return     index of the resource if found
+         */
+        std::optional<std::size_t> find(std::string_view path) const noexcept;
+
+        /**
+         * Get the paths of every resource
+         * @return paths
+         */
+        const std::vector<std::string> &paths() const noexcept {
+            return this->p_paths;
+        }
+
+        /** Remove every path */
+        void clear() noexcept;
+
+    private:
+        /** Paths of each resource */
+        std::vector<std::string> p_paths;
+
+        /** Indices of resources by path; the keys point to the strings in p_paths */
+        std::unordered_map<std::string_view, std::size_t> p_by_path;
+    };
+}
+
+#endif
@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <zstd.h>
+
+#include "../halo_data/map.hpp"
+#include "compression.hpp"
+#include "seekable_map.hpp"
+
+namespace Chimera {
+    // See zstd's contrib/seekable_format/zstd_seekable_compression_format.md
+    static constexpr std::uint32_t SKIPPABLE_FRAME_MAGIC = 0x184D2A5E;
+    static constexpr std::uint32_t SEEKABLE_MAGIC = 0x8F92EAB1;
+    static constexpr std::size_t SKIPPABLE_FRAME_HEADER_SIZE = 8;
+    static constexpr std::size_t SEEK_TABLE_FOOTER_SIZE = 9;
+    static constexpr std::uint8_t SEEK_TABLE_CHECKSUM_FLAG = 0x80;
+    static constexpr std::uint8_t SEEK_TABLE_RESERVED_BITS = 0x7C;
+
+    static constexpr std::size_t HEADER_SIZE = sizeof(MapHeader);
+
+    static std::uint32_t read_le32(const std::byte *data) noexcept {
+        return static_cast<std::uint32_t>(data[0]) | (static_cast<std::uint32_t>(data[1]) << 8) | (static_cast<std::uint32_t>(data[2]) << 16) | (static_cast<std::uint32_t>(data[3]) << 24);
+    }
+
+    static void write_le32(std::vector<std::byte> &data, std::uint32_t value) {
+        for(int i = 0; i < 4; i++) {
+            data.push_back(static_cast<std::byte>(value >> (i * 8)));
+        }
+    }
+
+    static bool read_at(std::FILE *f, std::size_t offset, std::byte *output, std::size_t size) noexcept {
+        return std::fseek(f, static_cast<long>(offset), SEEK_SET) == 0 && std::fread(output, size, 1, f) == 1;
+    }
+
+    std::vector<std::byte> make_map_seek_table(const std::vector<SeekTableEntry> &frames) {
+        std::vector<std::byte> table;
+        write_le32(table, SKIPPABLE_FRAME_MAGIC);
+        write_le32(table, static_cast<std::uint32_t>(frames.size() * 8 + SEEK_TABLE_FOOTER_SIZE));
+        for(auto &frame : frames) {
+            write_le32(table, frame.compressed_size);
+            write_le32(table, frame.decompressed_size);
+        }
+        write_le32(table, static_cast<std::uint32_t>(frames.size()));
+        table.push_back(std::byte {0});
+        write_le32(table, SEEKABLE_MAGIC);
+        return table;
+    }
+
+    bool is_seekable_map_file(const std::filesystem::path &path) noexcept {
+        try {
+            SeekableMap map(path, 0);
+            return true;
+        }
+        catch (std::exception &) {
+            return false;
+        }
+    }
+
+    SeekableMap::SeekableMap(const std::filesystem::path &path, std::size_t cached_frames) : p_cached_frames(std::max<std::size_t>(cached_frames, 1)) {
+        std::error_code ec;
+        std::uint64_t file_size = std::filesystem::file_size(path, ec);
+        if(ec || file_size < HEADER_SIZE + SKIPPABLE_FRAME_HEADER_SIZE + SEEK_TABLE_FOOTER_SIZE) {
+            throw std::exception();
+        }
+
+        this->p_file = std::fopen(path.string().c_str(), "rb");
+        if(!this->p_file) {
+            throw std::exception();
+        }
+
+        auto fail = [this]() {
+            std::fclose(this->p_file);
+            this->p_file = nullptr;
+            throw std::exception();
+        };
+
+        // Only compressed maps can have a seek table
+        std::byte compressed_header[HEADER_SIZE];
+        this->p_header.resize(HEADER_SIZE);
+        if(!read_at(this->p_file, 0, compressed_header, sizeof(compressed_header))) {
+            fail();
+        }
+        try {
+            decompress_map_header(compressed_header, this->p_header.data());
+        }
+        catch (std::exception &) {
+            fail();
+        }
+
+        // A compressed map's header holds the decompressed size and the dictionary it needs
+        auto &header = *reinterpret_cast<const MapHeader *>(compressed_header);
+        this->p_dictionary = header.get_compression_dictionary();
+        if(!has_map_compression_dictionary(this->p_dictionary)) {
+            fail();
+        }
+
+        // Find the seek table
+        std::byte footer[SEEK_TABLE_FOOTER_SIZE];
+        if(!read_at(this->p_file, file_size - sizeof(footer), footer, sizeof(footer)) || read_le32(footer + 5) != SEEKABLE_MAGIC) {
+            fail();
+        }
+        std::uint8_t descriptor = static_cast<std::uint8_t>(footer[4]);
+        if(descriptor & SEEK_TABLE_RESERVED_BITS) {
+            fail();
+        }
+        std::uint64_t frame_count = read_le32(footer);
+        std::uint64_t entry_size = (descriptor & SEEK_TABLE_CHECKSUM_FLAG) ? 12 : 8;
+        std::uint64_t table_size = frame_count * entry_size + SEEK_TABLE_FOOTER_SIZE;
+        if(table_size + SKIPPABLE_FRAME_HEADER_SIZE + HEADER_SIZE > file_size) {
+            fail();
+        }
+
+        std::uint64_t table_start = file_size - table_size - SKIPPABLE_FRAME_HEADER_SIZE;
+        std::vector<std::byte> table(table_size + SKIPPABLE_FRAME_HEADER_SIZE);
+        if(!read_at(this->p_file, table_start, table.data(), table.size()) || read_le32(table.data()) != SKIPPABLE_FRAME_MAGIC || read_le32(table.data() + 4) != table_size) {
+            fail();
+        }
+
+        // The frames have to cover everything between the header and the seek table
+        std::size_t compressed_offset = HEADER_SIZE;
+        std::size_t offset = HEADER_SIZE;
+        for(std::uint64_t f = 0; f < frame_count; f++) {
+            auto *entry = table.data() + SKIPPABLE_FRAME_HEADER_SIZE + f * entry_size;
+            std::size_t compressed_size = read_le32(entry);
+            std::size_t size = read_le32(entry + 4);
+            if(compressed_size > table_start - compressed_offset) {
+                fail();
+            }
+            if(size > 0) {
+                this->p_frames.push_back(Frame { compressed_offset, compressed_size, offset, size });
+            }
+            compressed_offset += compressed_size;
+            offset += size;
+        }
+
+        if(compressed_offset != table_start || offset != header.file_size) {
+            fail();
+        }
+        this->p_size = offset;
+    }
+
+    SeekableMap::~SeekableMap() {
+        if(this->p_file) {
+            std::fclose(this->p_file);
+        }
+        ZSTD_freeDCtx(this->p_context);
+    }
+
+    bool SeekableMap::read(std::size_t offset, std::byte *output, std::size_t size) noexcept {
+        std::scoped_lock<std::mutex> lock(this->p_mutex);
+        if(offset > this->p_size || size > this->p_size - offset) {
+            return false;
+        }
+
+        // The header is already decompressed
+        std::size_t end = offset + size;
+        if(offset < HEADER_SIZE) {
+            std::size_t header_end = std::min(end, HEADER_SIZE);
+            std::memcpy(output, this->p_header.data() + offset, header_end - offset);
+            output += header_end - offset;
+            offset = header_end;
+        }
+
+        // Decompress whatever frames this touches
+        auto frame = std::upper_bound(this->p_frames.begin(), this->p_frames.end(), offset, [](std::size_t position, const Frame &frame) { return position < frame.offset + frame.size; });
+        while(offset < end) {
+            if(frame == this->p_frames.end()) {
+                return false;
+            }
+            auto *data = this->decompressed_frame(frame - this->p_frames.begin());
+            if(!data) {
+                return false;
+            }
+            std::size_t copy_end = std::min(end, frame->offset + frame->size);
+            std::memcpy(output, data->data() + (offset - frame->offset), copy_end - offset);
+            output += copy_end - offset;
+            offset = copy_end;
+            frame++;
+        }
+
+        return true;
+    }
+
+    SeekableMap::Statistics SeekableMap::statistics() noexcept {
+        std::scoped_lock<std::mutex> lock(this->p_mutex);
+        return this->p_statistics;
+    }
+
+    const std::vector<std::byte> *SeekableMap::decompressed_frame(std::size_t frame) noexcept {
+        for(auto &c : this->p_cache) {
+            if(c.frame == frame) {
+                c.last_used = ++this->p_clock;
+                this->p_statistics.frame_cache_hits++;
+                return &c.data;
+            }
+        }
+
+        // Reuse the least recently used frame's memory if the cache is full
+        CachedFrame *cached;
+        if(this->p_cache.size() < this->p_cached_frames) {
+            cached = &this->p_cache.emplace_back();
+        }
+        else {
+            cached = &*std::min_element(this->p_cache.begin(), this->p_cache.end(), [](const CachedFrame &a, const CachedFrame &b) { return a.last_used < b.last_used; });
+        }
+
+        auto &f = this->p_frames[frame];
+        try {
+            this->p_compressed.resize(f.compressed_size);
+            cached->data.resize(f.size);
+        }
+        catch (std::exception &) {
+            cached->frame = SIZE_MAX;
+            return nullptr;
+        }
+
+        cached->frame = SIZE_MAX;
+        if(!this->p_context && !(this->p_context = ZSTD_createDCtx())) {
+            return nullptr;
+        }
+        if(!read_at(this->p_file, f.compressed_offset, this->p_compressed.data(), f.compressed_size)) {
+            return nullptr;
+        }
+        if(decompress_map_frame(this->p_context, this->p_dictionary, cached->data.data(), cached->data.size(), this->p_compressed.data(), this->p_compressed.size()) != f.size) {
+            return nullptr;
+        }
+
+        cached->frame = frame;
+        cached->last_used = ++this->p_clock;
+        this->p_statistics.frames_decompressed++;
+        return &cached->data;
+    }
+}
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_SEEKABLE_MAP_HPP
+#define CHIMERA_SEEKABLE_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+struct ZSTD_DCtx_s;
+
+namespace Chimera {
+    /**
+     * Size of a frame in the seek table
+     */
+    struct SeekTableEntry {
+        /** Size of the frame in the file */
+        std::uint32_t compressed_size;
+
+        /** Size of the frame once decompressed */
+        std::uint32_t decompressed_size;
+    };
+
+    /**
+     * Make a seek table to append to a compressed map. This uses zstd's seekable format: a skippable frame holding the size of each
+     * frame, so anything that can decompress the map still can.
+     * @param frames frames in the map, in order, not including the map header
+     * @return       seek table
+     */
+    std::vector<std::byte> make_map_seek_table(const std::vector<SeekTableEntry> &frames);
+
+    /**
+     * Check if the map is compressed and has a seek table, so it can be read without decompressing all of it
+     * @param path path to the map
+     * @return     true if the map can be opened as a SeekableMap
+     */
+    bool is_seekable_map_file(const std::filesystem::path &path) noexcept;
+
+    /**
+     * Compressed map that is read by decompressing only the frames that are needed
+     */
+    class SeekableMap {
+    public:
+        /** Default number of decompressed frames to keep */
+        static constexpr std::size_t DEFAULT_CACHED_FRAMES = 8;
+
+        struct Statistics {
+            /** Frames that had to be decompressed */
+            std::size_t frames_decompressed = 0;
+
+            /** Frames that were already decompressed */
+            std::size_t frame_cache_hits = 0;
+        };
+
+        /**
+         * Open the map, throwing an exception if it isn't a compressed map with a valid seek table
+         * @param path          path to the map
+         * @param cached_frames number of decompressed frames to keep
+         */
+        SeekableMap(const std::filesystem::path &path, std::size_t cached_frames = DEFAULT_CACHED_FRAMES);
+
+        SeekableMap(const SeekableMap &) = delete;
+        SeekableMap &operator=(const SeekableMap &) = delete;
+
+        ~SeekableMap();
+
+        /**
+         * Get the size of the map once decompressed
+         * @return size in bytes
+         */
+        std::size_t size() const noexcept {
+            return this->p_size;
+        }
+
+        /**
+         * Read part of the decompressed map; this is thread-safe
+         * @param offset offset in the decompressed map
+         * @param output where to read to
+         * @param size   number of bytes to read
+         * @return       true if everything was read
+         */
+        bool read(std::size_t offset, std::byte *output, std::size_t size) noexcept;
+
+        /**
+         * Get how many frames were decompressed
+         * @return statistics
+         */
+        Statistics statistics() noexcept;
+
+    private:
+        struct Frame {
+            std::size_t compressed_offset;
+            std::size_t compressed_size;
+            std::size_t offset;
+            std::size_t size;
+        };
+
+        struct CachedFrame {
+            std::size_t frame;
+            unsigned long long last_used;
+            std::vector<std::byte> data;
+        };
+
+        /** Decompressed map header */
+        std::vector<std::byte> p_header;
+
+        /** Frames, ordered by offset */
+        std::vector<Frame> p_frames;
+
+        /** Recently decompressed frames */
+        std::vector<CachedFrame> p_cache;
+
+        /** Maximum number of frames to cache */
+        std::size_t p_cached_frames;
+
+        /** Size of the decompressed map */
+        std::size_t p_size = 0;
+
+        /** ID of the dictionary the map was compressed with, or 0 if none */
+        std::uint32_t p_dictionary = 0;
+
+        /** Incremented every time a frame is used */
+        unsigned long long p_clock = 0;
+
+        /** The compressed map */
+        std::FILE *p_file = nullptr;
+
+        /** Compressed data of the frame being decompressed */
+        std::vector<std::byte> p_compressed;
+
+        /** Decompression context, made when the first frame is decompressed and reused for the rest */
+        ZSTD_DCtx_s *p_context = nullptr;
+
+        /** Statistics */
+        Statistics p_statistics;
+
+        /** Held while reading */
+        std::mutex p_mutex;
+
+        /**
+         * Get the decompressed frame, decompressing it if it isn't cached
+         * @param frame index of the frame
+         * @return      decompressed frame, or nullptr on failure
+         */
+        const std::vector<std::byte> *decompressed_frame(std::size_t frame) noexcept;
+    };
+}
+
+#endif
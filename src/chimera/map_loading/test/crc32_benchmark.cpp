@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../crc32.hpp"
+
+using crc32_fn = std::uint32_t (*)(std::uint32_t, const void *, std::size_t);
+
+int main(int argc, const char **argv) {
+    if(argc > 3) {
+        std::printf("Usage: %s [size in MiB] [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::size_t size = (argc > 1 ? std::stoul(argv[1]) : 64) * 1024 * 1024;
+    std::size_t iterations = argc > 2 ? std::stoul(argv[2]) : 5;
+
+    std::vector<std::uint8_t> data(size);
+    std::uint32_t seed = 0x12345678;
+    for(auto &b : data) {
+        seed = seed * 1103515245 + 12345;
+        b = static_cast<std::uint8_t>(seed >> 16);
+    }
+
+    struct Implementation {
+        const char *name;
+        crc32_fn fn;
+    };
+
+    std::vector<Implementation> implementations = { { "bytewise", crc32_bytewise }, { "slice-by-8", crc32_slice_by_8 } };
+    if(crc32_pclmul_supported()) {
+        implementations.push_back({ "pclmul", crc32_pclmul });
+    }
+
+    std::printf("crc32() is using %s\n", crc32_implementation());
+
+    for(auto &i : implementations) {
+        // Take the best run so one-off stalls don't skew the result
+        double best = 0.0;
+        std::uint32_t result = 0;
+        for(std::size_t n = 0; n < iterations; n++) {
+            auto start = std::chrono::steady_clock::now();
+            result = i.fn(0, data.data(), data.size());
+            auto end = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(end - start).count();
+            if(n == 0 || seconds < best) {
+                best = seconds;
+            }
+        }
+        std::printf("%-12s %08X %9.02f MiB/s\n", i.name, result, size / 1024.0 / 1024.0 / best);
+    }
+
+    return EXIT_SUCCESS;
+}
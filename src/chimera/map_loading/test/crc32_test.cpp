@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../crc32.hpp"
+
+using crc32_fn = std::uint32_t (*)(std::uint32_t, const void *, std::size_t);
+
+int main(int, const char **) {
+    struct Implementation {
+        const char *name;
+        crc32_fn fn;
+    };
+
+    std::vector<Implementation> implementations = { { "slice-by-8", crc32_slice_by_8 }, { "dispatch", crc32 } };
+    if(crc32_pclmul_supported()) {
+        implementations.push_back({ "pclmul", crc32_pclmul });
+    }
+    else {
+        std::printf("PCLMULQDQ is not supported on this CPU; skipping it\n");
+    }
+
+    std::size_t failures = 0;
+
+    // Standard check value
+    const char check[] = "123456789";
+    for(auto &i : implementations) {
+        auto result = i.fn(0, check, sizeof(check) - 1);
+        if(result != 0xCBF43926) {
+            std::printf("%s: check value is %08X, expected CBF43926\n", i.name, result);
+            failures++;
+        }
+    }
+
+    // Pseudorandom data
+    std::vector<std::uint8_t> data(64 * 1024 + 64);
+    std::uint32_t seed = 0x12345678;
+    for(auto &b : data) {
+        seed = seed * 1103515245 + 12345;
+        b = static_cast<std::uint8_t>(seed >> 16);
+    }
+
+    // Every alignment with a range of lengths around the block sizes, then some large ones
+    std::vector<std::size_t> lengths;
+    for(std::size_t l = 0; l <= 300; l++) {
+        lengths.push_back(l);
+    }
+    for(std::size_t l : { 1023, 1024, 1025, 4095, 4096, 4097, 65535, 65536 }) {
+        lengths.push_back(l);
+    }
+
+    for(std::size_t offset = 0; offset < 16; offset++) {
+        for(std::size_t length : lengths) {
+            if(offset + length > data.size()) {
+                continue;
+            }
+            for(std::uint32_t initial : { 0x00000000U, 0xFFFFFFFFU, 0xDEADBEEFU }) {
+                auto expected = crc32_bytewise(initial, data.data() + offset, length);
+                for(auto &i : implementations) {
+                    auto result = i.fn(initial, data.data() + offset, length);
+                    if(result != expected) {
+                        std::printf("%s: offset %zu, length %zu, initial %08X: got %08X, expected %08X\n", i.name, offset, length, initial, result, expected);
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+
+    // Chaining must match a single pass
+    for(auto &i : implementations) {
+        auto chained = i.fn(i.fn(0, data.data(), 1000), data.data() + 1000, data.size() - 1000);
+        auto expected = crc32_bytewise(0, data.data(), data.size());
+        if(chained != expected) {
+            std::printf("%s: chained CRC is %08X, expected %08X\n", i.name, chained, expected);
+            failures++;
+        }
+    }
+
+    // Combining the CRC32s of two halves must match a single pass
+    for(std::size_t split : { 0, 1, 15, 1000, 4096, 65535 }) {
+        auto first = crc32_bytewise(0, data.data(), split);
+        auto second = crc32_bytewise(0, data.data() + split, data.size() - split);
+        auto combined = crc32_combine(first, second, data.size() - split);
+        auto expected = crc32_bytewise(0, data.data(), data.size());
+        if(combined != expected) {
+            std::printf("combine: split at %zu is %08X, expected %08X\n", split, combined, expected);
+            failures++;
+        }
+    }
+
+    if(failures) {
+        std::printf("%zu failure%s\n", failures, failures == 1 ? "" : "s");
+        return EXIT_FAILURE;
+    }
+
+    std::printf("All tests passed (crc32() is using %s)\n", crc32_implementation());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "../resource_index.hpp"
+
+using namespace Chimera;
+
+template <typename Function> static double time_it(const Function &function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, const char **argv) {
+    if(argc > 3) {
+        std::printf("Usage: %s [asset count] [reads per asset]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Large maps reference several thousand bitmaps and sounds
+    std::size_t asset_count = argc > 1 ? std::stoul(argv[1]) : 6000;
+    std::size_t reads_per_asset = argc > 2 ? std::stoul(argv[2]) : 4;
+
+    // Make up some assets spread over bitmaps.map and sounds.map, with some requested more than once like shared bitmaps are
+    std::mt19937 random(1234);
+    std::vector<ResourceMetadata> assets;
+    // The data is never touched, so the addresses don't need to be real
+    std::uintptr_t cursor = 0x10000000;
+    for(std::size_t i = 0; i < asset_count; i++) {
+        auto origin = (random() % 3 == 0) ? ResourceOrigin::RESOURCE_ORIGIN_SOUNDS : ResourceOrigin::RESOURCE_ORIGIN_BITMAPS;
+        std::uint32_t offset = static_cast<std::uint32_t>(random() % (400 * 1024 * 1024));
+        std::size_t size = 1024 + random() % (256 * 1024);
+        assets.push_back(ResourceMetadata { origin, offset, reinterpret_cast<std::byte *>(cursor), size });
+        cursor += size;
+        if(random() % 8 == 0) {
+            assets.push_back(assets[random() % assets.size()]);
+        }
+    }
+
+    std::vector<std::size_t> reads;
+    for(std::size_t i = 0; i < assets.size() * reads_per_asset; i++) {
+        reads.push_back(random() % assets.size());
+    }
+
+    // Evicting a map from the buffer removes whatever was preloaded into where it was
+    auto *evict_start = assets[assets.size() / 2].data;
+    auto *evict_end = assets[assets.size() * 3 / 4].data;
+
+    std::printf("%zu assets, %zu reads\n", assets.size(), reads.size());
+
+    // The old way: a vector that's searched from the start every time
+    std::vector<ResourceMetadata> linear;
+    std::size_t linear_hits = 0;
+    double linear_add = time_it([&]() {
+        for(auto &a : assets) {
+            bool present = false;
+            for(auto &i : linear) {
+                if(i.origin == a.origin && i.offset == a.offset && i.size >= a.size) {
+                    present = true;
+                    break;
+                }
+            }
+            if(!present) {
+                linear.push_back(a);
+            }
+        }
+    });
+    double linear_find = time_it([&]() {
+        for(auto r : reads) {
+            auto &a = assets[r];
+            for(auto &md : linear) {
+                if(md.origin == a.origin && md.offset == a.offset && a.size <= md.size) {
+                    linear_hits++;
+                    break;
+                }
+            }
+        }
+    });
+    double linear_erase = time_it([&]() {
+        linear.erase(std::remove_if(linear.begin(), linear.end(), [&evict_start, &evict_end](const ResourceMetadata &md) { return md.data >= evict_start && md.data < evict_end; }), linear.end());
+    });
+
+    // The index
+    ResourceIndex index;
+    std::size_t index_hits = 0;
+    double index_add = time_it([&]() {
+        for(auto &a : assets) {
+            auto *present = index.find(a.origin, a.offset);
+            if(!present || present->size < a.size) {
+                index.add(a);
+            }
+        }
+    });
+    double index_find = time_it([&]() {
+        for(auto r : reads) {
+            auto &a = assets[r];
+            auto *md = index.find(a.origin, a.offset);
+            if(md && a.size <= md->size) {
+                index_hits++;
+            }
+        }
+    });
+    double index_erase = time_it([&]() {
+        index.erase_range(evict_start, evict_end);
+    });
+
+    std::printf("%-8s %12s %12s %12s\n", "", "preload", "lookups", "eviction");
+    std::printf("%-8s %9.03f ms %9.03f ms %9.03f ms\n", "linear", linear_add, linear_find, linear_erase);
+    std::printf("%-8s %9.03f ms %9.03f ms %9.03f ms\n", "index", index_add, index_find, index_erase);
+
+    // Make sure they agree
+    if(linear_hits != index_hits || linear.size() != index.size()) {
+        std::printf("Mismatch: %zu/%zu hits, %zu/%zu left after eviction\n", linear_hits, index_hits, linear.size(), index.size());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
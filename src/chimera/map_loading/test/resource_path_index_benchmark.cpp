@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+#include "../resource_path_index.hpp"
+
+using namespace Chimera;
+
+template <typename Function> static double time_it(const Function &function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, const char **argv) {
+    if(argc > 3) {
+        std::printf("Usage: %s [sound resource count] [indexed sound tag count]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // sounds.map has a few thousand sounds, and sound-heavy maps can reference most of them
+    std::size_t resource_count = argc > 1 ? std::stoul(argv[1]) : 5000;
+    std::size_t tag_count = argc > 2 ? std::stoul(argv[2]) : 3000;
+
+    // Make up paths like the ones in sounds.map. Every other resource is skipped, so its path is empty.
+    static const char *folders[] = { "sound\\sfx\\weapons\\", "sound\\sfx\\vehicles\\", "sound\\dialog\\marines\\", "sound\\sfx\\ambience\\", "sound\\sfx\\impulse\\" };
+    std::mt19937 random(1234);
+    std::vector<std::string> paths;
+    for(std::size_t i = 0; i < resource_count * 2; i++) {
+        if(i % 2 == 0) {
+            paths.emplace_back();
+        }
+        else {
+            paths.emplace_back(std::string(folders[random() % (sizeof(folders) / sizeof(*folders))]) + "sound_" + std::to_string(i));
+        }
+    }
+
+    // Make up a tag array. Most of the sounds are in sounds.map, but some aren't.
+    std::vector<std::string> tags;
+    for(std::size_t i = 0; i < tag_count; i++) {
+        if(random() % 20 == 0) {
+            tags.emplace_back("sound\\custom\\missing_" + std::to_string(i));
+        }
+        else {
+            tags.emplace_back(paths[(random() % resource_count) * 2 + 1]);
+        }
+    }
+
+    std::printf("%zu sound resources, %zu indexed sound tags\n", resource_count, tag_count);
+
+    // The old way: compare against every path until one matches
+    std::vector<std::optional<std::size_t>> linear_found;
+    double linear_resolve = time_it([&]() {
+        for(auto &t : tags) {
+            std::optional<std::size_t> path_index;
+            for(auto &s : paths) {
+                if(s == t.c_str()) {
+                    path_index = &s - paths.data();
+                    break;
+                }
+            }
+            linear_found.push_back(path_index);
+        }
+    });
+
+    // The index
+    ResourcePathIndex index;
+    std::vector<std::optional<std::size_t>> index_found;
+    double index_build = time_it([&]() {
+        index.assign(paths);
+    });
+    double index_resolve = time_it([&]() {
+        for(auto &t : tags) {
+            index_found.push_back(index.find(t.c_str()));
+        }
+    });
+
+    std::printf("%-8s %12s %12s\n", "", "build", "resolve");
+    std::printf("%-8s %12s %9.03f ms\n", "linear", "", linear_resolve);
+    std::printf("%-8s %9.03f ms %9.03f ms\n", "index", index_build, index_resolve);
+
+    // Make sure they agree
+    if(linear_found != index_found) {
+        std::printf("Mismatch between linear search and index\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,7 +1,13 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#include <deque>
+#include <memory>
 #include <thread>
 
 #define CURL_STATICLIB
@@ -10,16 +16,604 @@
 
 #include "hac_map_downloader.hpp"
 
+// Data the main connection holds before writing it
+static constexpr std::size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+// Segments smaller than this aren't worth another connection
+static constexpr std::size_t MINIMUM_SEGMENT_SIZE = 1024 * 1024;
+
+// Data each segment holds before writing it
+static constexpr std::size_t SEGMENT_BUFFER_SIZE = 256 * 1024;
+
+// Times a segment can fail before the download is given up on
+static constexpr unsigned int MAXIMUM_SEGMENT_ATTEMPTS = 5;
+
+// Number of nodes the repo has
+static constexpr unsigned int REPO_NODE_COUNT = 8;
+
+// How much to ask each mirror for to see how fast it is
+static constexpr std::size_t MIRROR_PROBE_SIZE = 64 * 1024;
+
+// How long to wait for the rest of the mirrors to answer once one has
+static constexpr std::chrono::milliseconds MIRROR_PROBE_GRACE(1000);
+
+// Seconds before mirrors are ranked again
+static constexpr long long MIRROR_CACHE_LIFETIME = 24 * 60 * 60;
+
+// How far back to look when working out how fast the download is going
+static constexpr std::chrono::seconds THROUGHPUT_WINDOW(5);
+
+// How often to note how much was downloaded for working out how fast the download is going
+static constexpr std::chrono::milliseconds THROUGHPUT_SAMPLE_INTERVAL(100);
+
+// How long to measure before giving a download speed
+static constexpr std::chrono::seconds THROUGHPUT_MINIMUM_SPAN(1);
+
+// If the download slows down to this fraction of the fastest it went, move to another mirror
+static constexpr double THROUGHPUT_COLLAPSE_FRACTION = 0.1;
+
+// Bytes before where each segment left off that are downloaded again to check the file didn't change when resuming
+static constexpr std::size_t RESUME_VERIFY_SIZE = 4096;
+
+struct ResumeSegment {
+    std::size_t offset;
+    std::size_t size;
+    std::size_t written;
+};
+
+// What a partially downloaded file is; this is saved next to it so the download can be resumed later
+struct ResumeState {
+    std::string url;
+    std::size_t total_size;
+    std::string validator;
+    std::vector<ResumeSegment> segments;
+};
+
+static std::string resume_file_path(const std::string &output_file) {
+    return output_file + ".resume";
+}
+
+static bool load_resume_state(const std::string &path, ResumeState &state) noexcept {
+    std::FILE *f = std::fopen(path.c_str(), "r");
+    if(!f) {
+        return false;
+    }
+
+    state = ResumeState {};
+    char line[1024];
+    while(std::fgets(line, sizeof(line), f)) {
+        line[std::strcspn(line, "\r\n")] = 0;
+        unsigned long long offset, size, written;
+        if(std::strncmp(line, "url=", 4) == 0) {
+            state.url = line + 4;
+        }
+        else if(std::strncmp(line, "size=", 5) == 0) {
+            state.total_size = std::strtoull(line + 5, nullptr, 10);
+        }
+        else if(std::strncmp(line, "validator=", 10) == 0) {
+            state.validator = line + 10;
+        }
+        else if(std::sscanf(line, "segment=%llu %llu %llu", &offset, &size, &written) == 3) {
+            state.segments.push_back(ResumeSegment { static_cast<std::size_t>(offset), static_cast<std::size_t>(size), static_cast<std::size_t>(written) });
+        }
+    }
+    std::fclose(f);
+
+    // The segments have to cover the file, in order
+    std::size_t expected_offset = 0;
+    for(auto &segment : state.segments) {
+        if(segment.offset != expected_offset || segment.written > segment.size) {
+            return false;
+        }
+        expected_offset += segment.size;
+    }
+    return !state.segments.empty() && expected_offset == state.total_size;
+}
+
+// How fast a mirror answered the last time mirrors were ranked
+struct MirrorCacheEntry {
+    long long time;
+    double seconds; // negative means it didn't answer
+    std::string mirror;
+};
+
+// Mirrors are remembered by the server rather than the whole URL, since that has the map in it
+static std::string mirror_cache_key(const std::string &url) {
+    auto host = url.find("://");
+    host = host == std::string::npos ? 0 : host + 3;
+    return url.substr(0, url.find_first_of("/?#", host));
+}
+
+static std::vector<MirrorCacheEntry> load_mirror_cache(const std::string &path, long long now) noexcept {
+    std::vector<MirrorCacheEntry> entries;
+    std::FILE *f = std::fopen(path.c_str(), "r");
+    if(!f) {
+        return entries;
+    }
+
+    // Anything too old to use is dropped so it doesn't pile up
+    char line[1024];
+    while(std::fgets(line, sizeof(line), f)) {
+        line[std::strcspn(line, "\r\n")] = 0;
+        long long time;
+        double seconds;
+        int mirror_offset = 0;
+        if(std::sscanf(line, "%lld %lf %n", &time, &seconds, &mirror_offset) < 2 || mirror_offset == 0 || line[mirror_offset] == 0 || now - time > MIRROR_CACHE_LIFETIME || now < time) {
+            continue;
+        }
+        entries.push_back(MirrorCacheEntry { time, seconds, line + mirror_offset });
+    }
+    std::fclose(f);
+    return entries;
+}
+
+static void save_mirror_cache(const std::string &path, const std::vector<MirrorCacheEntry> &entries) noexcept {
+    std::FILE *f = std::fopen(path.c_str(), "w");
+    if(!f) {
+        return;
+    }
+    for(auto &entry : entries) {
+        std::fprintf(f, "%lld %f %s\n", entry.time, entry.seconds, entry.mirror.c_str());
+    }
+    std::fclose(f);
+}
+
+static void forget_mirror(std::vector<MirrorCacheEntry> &entries, const std::string &mirror) {
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&mirror](const MirrorCacheEntry &entry) { return entry.mirror == mirror; }), entries.end());
+}
+
+static std::optional<std::string> header_value(const char *buffer, std::size_t size, const char *name) {
+    std::size_t name_length = std::strlen(name);
+    if(size <= name_length) {
+        return std::nullopt;
+    }
+    for(std::size_t i = 0; i < name_length; i++) {
+        if(std::tolower(buffer[i]) != name[i]) {
+            return std::nullopt;
+        }
+    }
+
+    // Headers aren't null terminated
+    std::string value(buffer + name_length, size - name_length);
+    auto first = value.find_first_not_of(" \t");
+    auto last = value.find_last_not_of(" \t\r\n");
+    return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+}
+
+struct RangeProbe {
+    /** Result of the request */
+    CURLcode result = CURLE_COULDNT_CONNECT;
+
+    /** The server answered with the range we asked for and the size of the file */
+    bool ranges = false;
+
+    /** Size of the file */
+    std::size_t total_size = 0;
+
+    /** ETag, or Last-Modified if there isn't one */
+    std::string validator;
+};
+
+// Ask for the first byte to find out the size, what version of the file it is, and whether we can ask for ranges at all; it gives
+// up if the download is canceled
+static RangeProbe probe_range(const char *url, const std::atomic<HACMapDownloader::DownloadStage> &status) {
+    struct Probe {
+        const std::atomic<HACMapDownloader::DownloadStage> *status;
+        std::size_t total_size = 0;
+        std::size_t received = 0;
+        std::string etag;
+        std::string last_modified;
+
+        static std::size_t header_callback(const char *buffer, std::size_t, std::size_t nitems, Probe *probe) {
+            std::optional<std::string> value;
+            if((value = header_value(buffer, nitems, "content-range:"))) {
+                unsigned long long first, last, total;
+                if(std::sscanf(value->c_str(), "bytes %llu-%llu/%llu", &first, &last, &total) == 3) {
+                    probe->total_size = total;
+                }
+            }
+            else if((value = header_value(buffer, nitems, "etag:"))) {
+                probe->etag = *value;
+            }
+            else if((value = header_value(buffer, nitems, "last-modified:"))) {
+                probe->last_modified = *value;
+            }
+            return nitems;
+        }
+
+        // If the server ignores the range, we'd be getting the whole map, so stop
+        static std::size_t write_callback(const char *, std::size_t, std::size_t nmemb, Probe *probe) {
+            probe->received += nmemb;
+            return probe->received > 1 ? 0 : nmemb;
+        }
+
+        static int progress_callback(Probe *probe, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+            return *probe->status == HACMapDownloader::DOWNLOAD_STAGE_CANCELING;
+        }
+    } probe;
+    probe.status = &status;
+
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_RANGE, "0-0");
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, Probe::header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &probe);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, Probe::write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &probe);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, Probe::progress_callback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &probe);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+
+    RangeProbe result;
+    result.result = curl_easy_perform(curl);
+    long response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_cleanup(curl);
+
+    result.ranges = result.result == CURLE_OK && response_code == 206 && probe.total_size > 0;
+    result.total_size = probe.total_size;
+    result.validator = probe.etag.empty() ? probe.last_modified : probe.etag;
+    return result;
+}
+
+// Writes are done on a thread of their own so the connections only wait on the disk if it falls behind; each connection fills one
+// buffer while the last one it filled is being written
+class HACMapDownloader::FileWriter {
+public:
+    /**
+     * Start the thread
+     * @param downloader downloader whose output file is written to
+     * @param buffers    number of buffers that can be waiting to be written before write() has to wait
+     */
+    FileWriter(HACMapDownloader *downloader, std::size_t buffers) : downloader(downloader), spare_buffers(buffers) {
+        this->thread = std::thread(&FileWriter::write_thread, this);
+    }
+
+    FileWriter(const FileWriter &) = delete;
+    FileWriter &operator=(const FileWriter &) = delete;
+
+    ~FileWriter() {
+        this->finish();
+        this->mutex.lock();
+        this->stopping = true;
+        this->mutex.unlock();
+        this->queued.notify_all();
+        this->thread.join();
+    }
+
+    /**
+     * Queue data to be written, swapping it for an empty buffer; the downloader's mutex must not be locked
+     * @param offset    where the data goes in the file
+     * @param data      data to write
+     * @param persisted incremented by the size of the data once it's written, with the downloader's mutex locked
+     * @return          false if a write failed
+     */
+    bool write(std::size_t offset, std::vector<std::byte> &data, std::size_t *persisted) {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        if(data.empty() || this->failed) {
+            return !this->failed;
+        }
+
+        // If everything is waiting to be written, then the disk is what's holding us up
+        if(this->spare_buffers.empty()) {
+            this->last_stalled = Clock::now();
+        }
+        this->written.wait(lock, [this]() { return !this->spare_buffers.empty() || this->failed; });
+        if(this->failed) {
+            return false;
+        }
+
+        auto empty = std::move(this->spare_buffers.back());
+        this->spare_buffers.pop_back();
+        this->queue.push_back(QueuedWrite { offset, std::move(data), persisted });
+        data = std::move(empty);
+        this->queued.notify_one();
+        return true;
+    }
+
+    /**
+     * Wait for everything queued to be written; the downloader's mutex must not be locked
+     * @return false if a write failed
+     */
+    bool finish() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->written.wait(lock, [this]() { return (this->queue.empty() && !this->writing) || this->failed; });
+        return !this->failed;
+    }
+
+    /**
+     * Get when a connection last had to wait for the disk to catch up
+     * @return time it last waited, or the clock's epoch if it never did
+     */
+    Clock::time_point get_last_stalled() {
+        std::scoped_lock<std::mutex> lock(this->mutex);
+        return this->last_stalled;
+    }
+
+    /**
+     * Read back part of the file that was already written
+     * @param offset where to read from
+     * @param output where to read to
+     * @param size   number of bytes to read
+     * @return       true if successful
+     */
+    bool read(std::size_t offset, std::byte *output, std::size_t size) {
+        std::scoped_lock<std::mutex> lock(this->file_mutex);
+        auto *file = this->downloader->output_file_handle;
+        return std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0 && std::fread(output, size, 1, file) == 1;
+    }
+
+private:
+    struct QueuedWrite {
+        std::size_t offset;
+        std::vector<std::byte> data;
+        std::size_t *persisted;
+    };
+
+    /** Downloader whose output file is written to */
+    HACMapDownloader *downloader;
+
+    /** Data waiting to be written, in order */
+    std::deque<QueuedWrite> queue;
+
+    /** Buffers to swap for ones being written */
+    std::vector<std::vector<std::byte>> spare_buffers;
+
+    /** Something is being written */
+    bool writing = false;
+
+    /** Something failed to be written */
+    bool failed = false;
+
+    /** The thread should stop once the queue is empty */
+    bool stopping = false;
+
+    /** When write() last had to wait for a buffer */
+    Clock::time_point last_stalled;
+
+    /** Mutex for the queue */
+    std::mutex mutex;
+
+    /** Held while the file is being used */
+    std::mutex file_mutex;
+
+    /** Notified when something is queued */
+    std::condition_variable queued;
+
+    /** Notified when something was written */
+    std::condition_variable written;
+
+    /** Thread doing the writing */
+    std::thread thread;
+
+    void write_thread() {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(true) {
+            this->queued.wait(lock, [this]() { return !this->queue.empty() || this->stopping; });
+            if(this->queue.empty()) {
+                return;
+            }
+            auto next = std::move(this->queue.front());
+            this->queue.pop_front();
+            this->writing = true;
+            lock.unlock();
+
+            // Flush it so anything reading the file can see it as soon as we say it's written
+            this->file_mutex.lock();
+            auto *file = this->downloader->output_file_handle;
+            bool success = std::fseek(file, static_cast<long>(next.offset), SEEK_SET) == 0 && std::fwrite(next.data.data(), next.data.size(), 1, file) == 1 && std::fflush(file) == 0;
+            this->file_mutex.unlock();
+
+            if(success) {
+                this->downloader->mutex.lock();
+                *next.persisted += next.data.size();
+                this->downloader->mutex.unlock();
+            }
+            next.data.clear();
+
+            lock.lock();
+            this->writing = false;
+            this->failed = this->failed || !success;
+            this->spare_buffers.push_back(std::move(next.data));
+            this->written.notify_all();
+        }
+    }
+};
+
+// Works out how fast the download is going from how much was downloaded over the last few seconds
+class HACMapDownloader::ThroughputWindow {
+public:
+    /**
+     * Note how much was downloaded so far
+     * @param downloaded bytes downloaded
+     */
+    void add(std::size_t downloaded) {
+        auto now = Clock::now();
+
+        // If we had to go back, what we had before doesn't tell us anything about how fast we're going now
+        if(!this->samples.empty() && downloaded < this->samples.back().second) {
+            this->samples.clear();
+        }
+        if(!this->samples.empty() && now - this->samples.back().first < THROUGHPUT_SAMPLE_INTERVAL) {
+            return;
+        }
+
+        // Keep one sample from before the window so there's always a full window to measure once we've been going that long
+        this->samples.emplace_back(now, downloaded);
+        while(this->samples.size() > 2 && now - this->samples[1].first >= THROUGHPUT_WINDOW) {
+            this->samples.pop_front();
+        }
+    }
+
+    /**
+     * Get how fast the download went over the window
+     * @param minimum_span how long we have to have been measuring
+     * @return             bytes per second, or std::nullopt if we haven't been measuring for long enough
+     */
+    std::optional<double> throughput(Clock::duration minimum_span) const {
+        if(this->samples.empty()) {
+            return std::nullopt;
+        }
+        auto &first = this->samples.front();
+        auto &last = this->samples.back();
+        auto span = last.first - first.first;
+        if(span < minimum_span || span <= Clock::duration::zero()) {
+            return std::nullopt;
+        }
+        return (last.second - first.second) / std::chrono::duration<double>(span).count();
+    }
+
+    /**
+     * Start measuring over again
+     */
+    void clear() noexcept {
+        this->samples.clear();
+    }
+
+private:
+    /** Bytes downloaded at each point in time, oldest first */
+    std::deque<std::pair<Clock::time_point, std::size_t>> samples;
+};
+
+struct HACMapDownloader::DownloadSegment {
+    /** Downloader this is a part of */
+    HACMapDownloader *downloader;
+
+    /** Offset of the segment in the file */
+    std::size_t offset;
+
+    /** Size of the segment */
+    std::size_t size;
+
+    /** How much was handed off to be written to the file so far */
+    std::size_t written = 0;
+
+    /** How much of that is actually in the file; the downloader's mutex must be locked to use this */
+    std::size_t persisted = 0;
+
+    /** Data received but not yet written */
+    std::vector<std::byte> buffer;
+
+    /** Number of times the segment was requested */
+    unsigned int attempts = 0;
+
+    /** Bytes left to compare with what's already in the file rather than write */
+    std::size_t verify = 0;
+
+    /** The data being verified didn't match the file */
+    bool mismatched = false;
+
+    /** The segment is being downloaded */
+    bool active = false;
+
+    /** CURL handle */
+    CURL *curl = nullptr;
+
+    /**
+     * Get how much of the segment was received
+     * @return bytes received
+     */
+    std::size_t received() const noexcept {
+        return this->written + this->buffer.size();
+    }
+
+    /**
+     * Hand the buffer off to be written to the segment's place in the file; the downloader's mutex must not be locked
+     * @return true if successful
+     */
+    bool flush() {
+        std::size_t size = this->buffer.size();
+        if(!this->downloader->writer->write(this->offset + this->written, this->buffer, &this->persisted)) {
+            return false;
+        }
+        this->written += size;
+        return true;
+    }
+};
+
+// Callback class
+class HACMapDownloader::HACMapDownloaderCallback {
+public:
+    // When we've received data, put it in here, handing it off to be written when there's enough
+    static size_t write_callback(const std::byte *ptr, std::size_t, std::size_t nmemb, HACMapDownloader *userdata) {
+        if(!receiving(userdata)) {
+            return 0;
+        }
+
+        userdata->buffer.insert(userdata->buffer.end(), ptr, ptr + nmemb);
+        if(userdata->buffer.size() >= WRITE_BUFFER_SIZE) {
+            std::size_t size = userdata->buffer.size();
+            if(!userdata->writer->write(userdata->buffer_offset, userdata->buffer, &userdata->contiguous_size)) {
+                return 0;
+            }
+            userdata->buffer_offset += size;
+        }
+
+        return nmemb;
+    }
+
+    // When a segment has received data, put it in its buffer, handing the buffer off to be written when it's full
+    static size_t segment_write_callback(const std::byte *ptr, std::size_t, std::size_t nmemb, HACMapDownloader::DownloadSegment *segment) {
+        auto *downloader = segment->downloader;
+
+        // If we're canceling or the server sent more than we asked for, stop
+        if(!receiving(downloader) || nmemb > segment->size - segment->received()) {
+            return 0;
+        }
+
+        // If we're resuming, the start of the data is what we should already have
+        std::size_t verify = std::min(segment->verify, nmemb);
+        if(verify > 0) {
+            std::byte existing[RESUME_VERIFY_SIZE];
+            if(!downloader->writer->read(segment->offset + segment->written, existing, verify) || std::memcmp(existing, ptr, verify) != 0) {
+                segment->mismatched = true;
+                return 0;
+            }
+            downloader->mutex.lock();
+            segment->persisted += verify;
+            downloader->mutex.unlock();
+            segment->written += verify;
+            segment->verify -= verify;
+            downloader->downloaded_size += verify;
+            ptr += verify;
+            nmemb -= verify;
+        }
+
+        segment->buffer.insert(segment->buffer.end(), ptr, ptr + nmemb);
+        downloader->downloaded_size += nmemb;
+        bool flushed = segment->buffer.size() < SEGMENT_BUFFER_SIZE || segment->flush();
+
+        return flushed ? nmemb + verify : 0;
+    }
+
+    // When progress has been made, record it here
+    static int progress_callback(HACMapDownloader *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t, curl_off_t) {
+        clientp->downloaded_size = static_cast<std::size_t>(dlnow);
+        clientp->total_size = static_cast<std::size_t>(dltotal);
+        clientp->update_throughput();
+        return 0;
+    }
+
+private:
+    // Note that data is coming in, returning false if we're canceling
+    static bool receiving(HACMapDownloader *downloader) noexcept {
+        auto status = HACMapDownloader::DOWNLOAD_STAGE_STARTING;
+        downloader->status.compare_exchange_strong(status, HACMapDownloader::DOWNLOAD_STAGE_DOWNLOADING);
+        return status != HACMapDownloader::DOWNLOAD_STAGE_CANCELING;
+    }
+};
+
 void HACMapDownloader::dispatch_thread_function(HACMapDownloader *downloader) {
-    // Set the URL
     CURLcode result;
 
-    // Determine the first repo to use
+    // Determine the repos to use
     downloader->mutex.lock();
     auto preferred_server_hold = downloader->preferred_server_node;
+    auto mirrors = downloader->urls;
     downloader->mutex.unlock();
-    bool preferred_failed = !preferred_server_hold.has_value();
-    unsigned int repo = preferred_server_hold.value_or(1);
 
     std::string map_formatted;
     for(char &c : downloader->map) {
@@ -32,44 +626,37 @@ void HACMapDownloader::dispatch_thread_function(HACMapDownloader *downloader) {
             map_formatted += code;
         }
     }
-    do {
-        char url[255];
-        std::snprintf(url, sizeof(url), "http://maps%u.halonet.net/halonet/locator.php?format=inv&map=%s&type=%s", repo, map_formatted.data(), downloader->game_engine.data());
-        curl_easy_setopt(downloader->curl, CURLOPT_URL, url);
-        downloader->download_started = Clock::now();
-
-        // Did we fail?
-        if((result = curl_easy_perform(downloader->curl)) != CURLE_OK) {
-            // Did our preferred one fail? If so, give up
-            if(preferred_failed && result != CURLcode::CURLE_COULDNT_RESOLVE_HOST) {
-                break;
-            }
 
-            if(preferred_server_hold.has_value()) {
-                if(preferred_failed) {
-                    repo++;
-                }
-                else {
-                    repo = 1;
-                    preferred_failed = true;
-                }
-            }
-            else {
-                repo++;
+    // Every node, starting with the preferred one
+    if(mirrors.empty()) {
+        unsigned int preferred = preferred_server_hold.value_or(1);
+        for(unsigned int repo = 0; repo <= REPO_NODE_COUNT; repo++) {
+            unsigned int node = repo == 0 ? preferred : repo;
+            if(repo != 0 && repo == preferred) {
+                continue;
             }
+            char url[255];
+            std::snprintf(url, sizeof(url), "http://maps%u.halonet.net/halonet/locator.php?format=inv&map=%s&type=%s", node, map_formatted.data(), downloader->game_engine.data());
+            mirrors.emplace_back(url);
         }
+    }
 
-        // Cancel?
-        downloader->mutex.lock();
-        if(downloader->status == DownloadStage::DOWNLOAD_STAGE_CANCELING) {
-            curl_easy_cleanup(downloader->curl);
-            downloader->curl = nullptr;
-            downloader->mutex.unlock();
-            return;
-        }
+    // Use whichever ones are fastest first
+    mirrors = rank_mirrors(downloader, mirrors);
+    ThroughputWindow throughput;
+    downloader->throughput = &throughput;
+    result = static_cast<CURLcode>(download_segmented(downloader, mirrors));
+    downloader->throughput = nullptr;
+
+    // Cancel?
+    downloader->mutex.lock();
+    if(downloader->status == DownloadStage::DOWNLOAD_STAGE_CANCELING) {
+        curl_easy_cleanup(downloader->curl);
+        downloader->curl = nullptr;
         downloader->mutex.unlock();
+        return;
     }
-    while(result != CURLcode::CURLE_OK);
+    downloader->mutex.unlock();
 
     // Note that we're extracting; clean up CURL
     downloader->mutex.lock();
@@ -78,9 +665,6 @@ void HACMapDownloader::dispatch_thread_function(HACMapDownloader *downloader) {
 
     // If we were successful, do it
     if(result == CURLcode::CURLE_OK) {
-        // Write the last data
-        std::fwrite(downloader->buffer.data(), downloader->buffer_used, 1, downloader->output_file_handle);
-        downloader->buffer_used = 0;
         downloader->buffer.clear();
 
         // Close the file handle
@@ -96,67 +680,588 @@ void HACMapDownloader::dispatch_thread_function(HACMapDownloader *downloader) {
     downloader->mutex.unlock();
 }
 
-void HACMapDownloader::set_preferred_server_node(const std::optional<unsigned int> &server) noexcept {
-    this->mutex.lock();
-    this->preferred_server_node = server;
-    this->mutex.unlock();
-}
+std::vector<std::string> HACMapDownloader::rank_mirrors(HACMapDownloader *downloader, const std::vector<std::string> &urls) {
+    if(urls.size() <= 1) {
+        return urls;
+    }
 
-std::size_t HACMapDownloader::get_download_speed() noexcept {
-    // If we haven't started, return 0
-    if(this->downloaded_size == 0) {
-        return 0.0;
+    downloader->mutex.lock();
+    auto cache_file = downloader->mirror_cache_file;
+    downloader->mutex.unlock();
+
+    // Use what we found last time if it's recent enough and has every mirror; negative means it didn't answer
+    std::vector<double> seconds(urls.size(), -1.0);
+    std::vector<bool> cached(urls.size());
+    auto now = static_cast<long long>(std::time(nullptr));
+    std::vector<MirrorCacheEntry> cache_entries;
+    if(cache_file.has_value()) {
+        cache_entries = load_mirror_cache(*cache_file, now);
+    }
+    for(std::size_t m = 0; m < urls.size(); m++) {
+        auto mirror = mirror_cache_key(urls[m]);
+        for(auto &entry : cache_entries) {
+            if(entry.mirror == mirror) {
+                seconds[m] = entry.seconds;
+                cached[m] = true;
+            }
+        }
     }
 
-    auto now = Clock::now();
-    auto difference = now - this->download_started;
-    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(difference).count();
+    // Otherwise, ask all of them for the start of the file at once and see how long they take
+    if(std::find(cached.begin(), cached.end(), false) != cached.end()) {
+        struct MirrorProbe {
+            std::size_t received = 0;
+            CURL *curl = nullptr;
+
+            // Servers that ignore the range would send the whole map, so stop once we have enough
+            static std::size_t write_callback(const char *, std::size_t, std::size_t nmemb, MirrorProbe *probe) {
+                probe->received += nmemb;
+                return probe->received >= MIRROR_PROBE_SIZE ? 0 : nmemb;
+            }
+        };
+
+        char range[64];
+        std::snprintf(range, sizeof(range), "0-%zu", MIRROR_PROBE_SIZE - 1);
+
+        std::vector<MirrorProbe> probes(urls.size());
+        CURLM *multi = curl_multi_init();
+        for(std::size_t m = 0; m < urls.size(); m++) {
+            auto &probe = probes[m];
+            probe.curl = curl_easy_init();
+            curl_easy_setopt(probe.curl, CURLOPT_URL, urls[m].c_str());
+            curl_easy_setopt(probe.curl, CURLOPT_RANGE, range);
+            curl_easy_setopt(probe.curl, CURLOPT_WRITEFUNCTION, MirrorProbe::write_callback);
+            curl_easy_setopt(probe.curl, CURLOPT_WRITEDATA, &probe);
+            curl_easy_setopt(probe.curl, CURLOPT_PRIVATE, &probe);
+            curl_easy_setopt(probe.curl, CURLOPT_FAILONERROR, 1);
+            curl_easy_setopt(probe.curl, CURLOPT_CONNECTTIMEOUT, 10L);
+            curl_easy_setopt(probe.curl, CURLOPT_TIMEOUT, 10L);
+            curl_multi_add_handle(multi, probe.curl);
+        }
+
+        // Once one answers, only wait a little longer for the rest since anything slower isn't worth using
+        auto start = Clock::now();
+        std::optional<Clock::time_point> first_answer;
+        int running = static_cast<int>(probes.size());
+        while(running > 0) {
+            curl_multi_perform(multi, &running);
 
-    // Don't divide by zero
-    if(ms <= 0) {
-        return 0.0;
+            CURLMsg *message;
+            int messages_left;
+            while((message = curl_multi_info_read(multi, &messages_left))) {
+                if(message->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                MirrorProbe *probe;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &probe);
+                auto result = message->data.result;
+                if(result == CURLE_OK || (result == CURLE_WRITE_ERROR && probe->received >= MIRROR_PROBE_SIZE)) {
+                    auto answered = Clock::now();
+                    seconds[probe - probes.data()] = std::chrono::duration<double>(answered - start).count();
+                    first_answer = first_answer.value_or(answered);
+                }
+            }
+
+            downloader->mutex.lock();
+            bool canceling = downloader->status == DOWNLOAD_STAGE_CANCELING;
+            downloader->mutex.unlock();
+            if(canceling || (first_answer.has_value() && Clock::now() - *first_answer > MIRROR_PROBE_GRACE)) {
+                break;
+            }
+
+            if(running > 0) {
+                curl_multi_wait(multi, nullptr, 0, 100, nullptr);
+            }
+        }
+
+        for(auto &probe : probes) {
+            curl_multi_remove_handle(multi, probe.curl);
+            curl_easy_cleanup(probe.curl);
+        }
+        curl_multi_cleanup(multi);
+
+        // Remember this for next time along with any other mirrors we know about, unless none of them answered, in which case it's
+        // probably our connection
+        if(first_answer.has_value() && cache_file.has_value()) {
+            for(std::size_t m = 0; m < urls.size(); m++) {
+                auto mirror = mirror_cache_key(urls[m]);
+                forget_mirror(cache_entries, mirror);
+                cache_entries.push_back(MirrorCacheEntry { now, seconds[m], mirror });
+            }
+            save_mirror_cache(*cache_file, cache_entries);
+        }
+    }
+
+    // Fastest first; ones that didn't answer are kept in the order we got them in case they work anyway
+    std::vector<std::size_t> order(urls.size());
+    for(std::size_t m = 0; m < order.size(); m++) {
+        order[m] = m;
     }
+    std::stable_sort(order.begin(), order.end(), [&seconds](std::size_t a, std::size_t b) {
+        if((seconds[a] < 0.0) != (seconds[b] < 0.0)) {
+            return seconds[b] < 0.0;
+        }
+        return seconds[a] >= 0.0 && seconds[a] < seconds[b];
+    });
 
-    return (this->downloaded_size) / ms;
+    std::vector<std::string> ranked;
+    for(auto m : order) {
+        ranked.push_back(urls[m]);
+    }
+    return ranked;
 }
 
-// Callback class
-class HACMapDownloader::HACMapDownloaderCallback {
-public:
-    // When we've received data, put it in here
-    static size_t write_callback(const std::byte *ptr, std::size_t, std::size_t nmemb, HACMapDownloader *userdata) {
-        userdata->mutex.lock();
+int HACMapDownloader::download_segmented(HACMapDownloader *downloader, const std::vector<std::string> &mirrors) {
+    // Use the first mirror that answers
+    std::size_t mirror = 0;
+    RangeProbe probe;
+    for(; mirror < mirrors.size(); mirror++) {
+        probe = probe_range(mirrors[mirror].c_str(), downloader->status);
+        if(probe.result == CURLE_OK || probe.result == CURLE_WRITE_ERROR) {
+            break;
+        }
 
-        // If we're canceling, stop
-        if(userdata->status == HACMapDownloader::DOWNLOAD_STAGE_CANCELING) {
-            userdata->mutex.unlock();
-            return 0;
+        downloader->mutex.lock();
+        bool canceling = downloader->status == DOWNLOAD_STAGE_CANCELING;
+        downloader->mutex.unlock();
+        if(canceling) {
+            return CURLE_ABORTED_BY_CALLBACK;
+        }
+    }
+    if(mirror == mirrors.size()) {
+        return mirrors.empty() ? CURLE_COULDNT_CONNECT : probe.result;
+    }
+
+    std::string url = mirrors[mirror];
+    std::vector<std::string> other_mirrors(mirrors.begin() + mirror + 1, mirrors.end());
+    auto resume_path = resume_file_path(downloader->output_file);
+    std::size_t total_size = probe.total_size;
+
+    // No ranges? Download it normally from the start, then, moving on to the next mirror if it fails
+    if(!probe.ranges) {
+        std::error_code ec;
+        std::filesystem::remove(resume_path, ec);
+        downloader->mutex.lock();
+        bool reopened = downloader->truncate_output_file();
+        downloader->mutex.unlock();
+        if(!reopened) {
+            return CURLE_WRITE_ERROR;
+        }
+        downloader->buffer.clear();
+        downloader->buffer_offset = 0;
+
+        CURLcode result;
+        {
+            FileWriter writer(downloader, 1);
+            downloader->writer = &writer;
+            curl_easy_setopt(downloader->curl, CURLOPT_URL, url.c_str());
+            result = curl_easy_perform(downloader->curl);
+
+            // Write whatever is left
+            bool written = writer.write(downloader->buffer_offset, downloader->buffer, &downloader->contiguous_size) && writer.finish();
+            if(result == CURLE_OK && !written) {
+                result = CURLE_WRITE_ERROR;
+            }
+            downloader->writer = nullptr;
+        }
+        if(result != CURLE_OK && result != CURLE_WRITE_ERROR && !other_mirrors.empty()) {
+            return download_segmented(downloader, other_mirrors);
+        }
+        return result;
+    }
+
+    // Pick up where a previous download of the same file left off if we can
+    ResumeState state;
+
+    // Note how much of each segment is in the file so far; the mutex must be locked
+    auto save_state = [&resume_path, &state](const std::vector<DownloadSegment> &segments) -> bool {
+        std::FILE *f = std::fopen(resume_path.c_str(), "w");
+        if(!f) {
+            return false;
+        }
+        std::fprintf(f, "url=%s\nsize=%zu\nvalidator=%s\n", state.url.c_str(), state.total_size, state.validator.c_str());
+        for(std::size_t s = 0; s < segments.size(); s++) {
+            state.segments[s].written = segments[s].persisted;
+            std::fprintf(f, "segment=%zu %zu %zu\n", state.segments[s].offset, state.segments[s].size, state.segments[s].written);
         }
+        return std::fclose(f) == 0;
+    };
 
-        userdata->status = HACMapDownloader::DOWNLOAD_STAGE_DOWNLOADING;
-        if(userdata->buffer_used + nmemb > userdata->buffer.size()) {
-            std::fwrite(userdata->buffer.data(), userdata->buffer_used, 1, userdata->output_file_handle);
-            std::fwrite(ptr, nmemb, 1, userdata->output_file_handle);
-            userdata->buffer_used = 0;
+    std::error_code ec;
+    bool resuming = load_resume_state(resume_path, state) && state.total_size == total_size && std::filesystem::file_size(downloader->output_file, ec) == total_size && !ec;
+
+    // Other mirrors of the same file can have different validators, so we have to rely on checking the ends of the segments
+    if(resuming && state.url == url) {
+        resuming = state.validator == probe.validator;
+    }
+    else if(resuming) {
+        resuming = std::find(mirrors.begin(), mirrors.end(), state.url) != mirrors.end();
+        state.url = url;
+        state.validator = probe.validator;
+    }
+
+    if(!resuming) {
+        std::size_t segment_count = std::clamp<std::size_t>(total_size / MINIMUM_SEGMENT_SIZE, 1, downloader->segment_count);
+        std::size_t segment_size = total_size / segment_count;
+        state = ResumeState { url, total_size, probe.validator, {} };
+        for(std::size_t s = 0; s < segment_count; s++) {
+            std::size_t offset = s * segment_size;
+            state.segments.push_back(ResumeSegment { offset, s + 1 == segment_count ? total_size - offset : segment_size, 0 });
+        }
+    }
+
+    std::vector<DownloadSegment> segments(state.segments.size());
+    std::size_t segments_left = 0;
+    downloader->mutex.lock();
+    downloader->total_size = total_size;
+    downloader->downloaded_size = 0;
+    for(std::size_t s = 0; s < segments.size(); s++) {
+        auto &segment = segments[s];
+        segment.downloader = downloader;
+        segment.offset = state.segments[s].offset;
+        segment.size = state.segments[s].size;
+        segment.written = state.segments[s].written;
+
+        // Download the end of what we have again to make sure it's the same file we had before
+        if(segment.written > 0 && segment.written < segment.size) {
+            segment.verify = std::min(segment.written, RESUME_VERIFY_SIZE);
+            segment.written -= segment.verify;
+        }
+        segment.persisted = segment.written;
+
+        downloader->downloaded_size += segment.written;
+        segments_left += segment.written < segment.size;
+    }
+
+    // Otherwise, allocate the whole file up front so each segment can be written where it goes
+    bool allocated = true;
+    if(!resuming) {
+        allocated = downloader->truncate_output_file() && std::fseek(downloader->output_file_handle, static_cast<long>(total_size - 1), SEEK_SET) == 0 && std::fputc(0, downloader->output_file_handle) != EOF && std::fflush(downloader->output_file_handle) == 0;
+    }
+    allocated = allocated && save_state(segments);
+    downloader->mutex.unlock();
+    if(!allocated) {
+        return CURLE_WRITE_ERROR;
+    }
+
+    auto writer = std::make_unique<FileWriter>(downloader, segments.size());
+    downloader->writer = writer.get();
+
+    CURLM *multi = curl_multi_init();
+    auto maximum_segment_speed = static_cast<curl_off_t>(std::max<std::size_t>(downloader->maximum_speed / segments.size(), 1));
+    auto request_segment = [&multi, &url, &downloader, &maximum_segment_speed](DownloadSegment &segment) {
+        char range[64];
+        std::snprintf(range, sizeof(range), "%zu-%zu", segment.offset + segment.received(), segment.offset + segment.size - 1);
+        if(!segment.curl) {
+            segment.curl = curl_easy_init();
+            curl_easy_setopt(segment.curl, CURLOPT_WRITEFUNCTION, HACMapDownloaderCallback::segment_write_callback);
+            curl_easy_setopt(segment.curl, CURLOPT_WRITEDATA, &segment);
+            curl_easy_setopt(segment.curl, CURLOPT_PRIVATE, &segment);
+            curl_easy_setopt(segment.curl, CURLOPT_FAILONERROR, 1);
+            curl_easy_setopt(segment.curl, CURLOPT_CONNECTTIMEOUT, 10L);
+
+            // If a segment stalls, try it again rather than wait on it forever
+            curl_easy_setopt(segment.curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(segment.curl, CURLOPT_LOW_SPEED_TIME, 15L);
+
+            // Each connection gets an even share of the speed limit
+            if(downloader->maximum_speed > 0) {
+                curl_easy_setopt(segment.curl, CURLOPT_MAX_RECV_SPEED_LARGE, maximum_segment_speed);
+            }
+        }
+        curl_easy_setopt(segment.curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(segment.curl, CURLOPT_RANGE, range);
+        segment.attempts++;
+        segment.active = true;
+        curl_multi_add_handle(multi, segment.curl);
+    };
+
+    // Switch to the next mirror that has a file of the same size, downloading the end of each segment again to make sure it's the
+    // same file; the mutex must not be locked
+    auto fail_over = [&]() -> bool {
+        while(!other_mirrors.empty() && downloader->status != DOWNLOAD_STAGE_CANCELING) {
+            auto next = other_mirrors.front();
+            other_mirrors.erase(other_mirrors.begin());
+            auto next_probe = probe_range(next.c_str(), downloader->status);
+            if(!next_probe.ranges || next_probe.total_size != total_size) {
+                continue;
+            }
+
+            auto previous_url = url;
+            url = next;
+            for(auto &segment : segments) {
+                if(segment.active) {
+                    curl_multi_remove_handle(multi, segment.curl);
+                    segment.active = false;
+                }
+                segment.flush();
+            }
+
+            // What's verified has to be in the file to be compared with
+            writer->finish();
+
+            downloader->mutex.lock();
+            state.url = url;
+            state.validator = next_probe.validator;
+            for(auto &segment : segments) {
+                if(segment.received() < segment.size) {
+                    // A segment that was still being verified only gets topped back up to RESUME_VERIFY_SIZE, as that's all the write callback can compare
+                    auto verify = std::min(segment.written, RESUME_VERIFY_SIZE - segment.verify);
+                    segment.written -= verify;
+                    segment.persisted -= verify;
+                    segment.verify += verify;
+                    segment.attempts = 0;
+                    downloader->downloaded_size -= verify;
+                }
+            }
+            downloader->mutex.unlock();
+
+            for(auto &segment : segments) {
+                if(segment.received() < segment.size) {
+                    request_segment(segment);
+                }
+            }
+
+            // How fast we thought that mirror was is clearly wrong now
+            downloader->mutex.lock();
+            auto cache_file = downloader->mirror_cache_file;
+            downloader->mutex.unlock();
+            if(cache_file.has_value()) {
+                auto cache_entries = load_mirror_cache(*cache_file, static_cast<long long>(std::time(nullptr)));
+                forget_mirror(cache_entries, mirror_cache_key(previous_url));
+                save_mirror_cache(*cache_file, cache_entries);
+            }
+            return true;
+        }
+        return false;
+    };
+
+    for(auto &segment : segments) {
+        if(segment.written < segment.size) {
+            segment.buffer.reserve(SEGMENT_BUFFER_SIZE);
+            request_segment(segment);
+        }
+    }
+
+    CURLcode final_result = CURLE_OK;
+    auto last_saved = Clock::now();
+    ThroughputWindow segment_throughput;
+    std::size_t measured_segments = 0;
+    double peak_throughput = 0.0;
+    bool failed_segment = false;
+    CURLcode last_failed_result = CURLE_OK;
+    while(segments_left > 0) {
+        int running;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg *message;
+        int messages_left;
+        while(final_result == CURLE_OK && (message = curl_multi_info_read(multi, &messages_left))) {
+            if(message->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            DownloadSegment *segment;
+            curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &segment);
+            auto segment_result = message->data.result;
+            curl_multi_remove_handle(multi, segment->curl);
+            segment->active = false;
+
+            bool flushed = segment->flush();
+            bool canceling = downloader->status == DOWNLOAD_STAGE_CANCELING;
+
+            if(!flushed || canceling || segment->mismatched) {
+                final_result = canceling ? CURLE_ABORTED_BY_CALLBACK : CURLE_WRITE_ERROR;
+            }
+            else if(segment->received() == segment->size) {
+                segments_left--;
+            }
+            // Only the segment that failed needs to be tried again, picking up where it left off
+            else if(segment->attempts < MAXIMUM_SEGMENT_ATTEMPTS) {
+                request_segment(*segment);
+            }
+            // If it keeps failing, the mirror is probably the problem
+            else if(!other_mirrors.empty()) {
+                failed_segment = true;
+                last_failed_result = segment_result;
+            }
+            else {
+                final_result = segment_result == CURLE_OK ? CURLE_PARTIAL_FILE : segment_result;
+            }
+        }
+
+        if(final_result != CURLE_OK) {
+            break;
+        }
+
+        if(downloader->status == DOWNLOAD_STAGE_CANCELING) {
+            final_result = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+
+        downloader->mutex.lock();
+
+        // Anything before the first segment that isn't all in the file can be read now
+        std::size_t contiguous = 0;
+        for(auto &segment : segments) {
+            contiguous = segment.offset + segment.persisted;
+            if(segment.persisted < segment.size) {
+                break;
+            }
+        }
+        downloader->contiguous_size = std::max(downloader->contiguous_size, contiguous);
+
+        // Note how far along we are every so often in case we're closed without getting to clean up
+        auto now = Clock::now();
+        if(now - last_saved > std::chrono::seconds(1)) {
+            save_state(segments);
+            last_saved = now;
+        }
+        downloader->mutex.unlock();
+
+        // Keep track of how fast each connection is going over the last few seconds so we can tell if the mirror slows to a crawl
+        // (unless we're holding it back ourselves, in which case how fast it goes says nothing about the mirror). Measuring starts
+        // over whenever a segment finishes, since there are fewer connections sharing the mirror, and whenever the connections had
+        // to wait on the disk, since then it's the disk that's slow.
+        downloader->update_throughput();
+        std::size_t active_segments = 0;
+        for(auto &segment : segments) {
+            active_segments += segment.active;
+        }
+        if(active_segments != measured_segments || now - writer->get_last_stalled() < THROUGHPUT_WINDOW) {
+            segment_throughput.clear();
+            measured_segments = active_segments;
+        }
+        segment_throughput.add(downloader->downloaded_size);
+
+        bool collapsed = false;
+        auto throughput = segment_throughput.throughput(THROUGHPUT_WINDOW);
+        if(throughput.has_value() && active_segments > 0 && downloader->maximum_speed == 0) {
+            double throughput_per_segment = *throughput / active_segments;
+            peak_throughput = std::max(peak_throughput, throughput_per_segment);
+            collapsed = throughput_per_segment < peak_throughput * THROUGHPUT_COLLAPSE_FRACTION;
+        }
+
+        if((failed_segment || collapsed) && !other_mirrors.empty()) {
+            if(!fail_over()) {
+                if(downloader->status == DOWNLOAD_STAGE_CANCELING) {
+                    final_result = CURLE_ABORTED_BY_CALLBACK;
+                    break;
+                }
+                final_result = failed_segment ? (last_failed_result == CURLE_OK ? CURLE_PARTIAL_FILE : last_failed_result) : CURLE_OK;
+                if(final_result != CURLE_OK) {
+                    break;
+                }
+            }
+            failed_segment = false;
+            downloader->throughput->clear();
+            segment_throughput.clear();
+            peak_throughput = 0.0;
+            continue;
+        }
+
+        if(segments_left > 0) {
+            curl_multi_wait(multi, nullptr, 0, 100, nullptr);
+        }
+    }
+
+    bool mismatched = false;
+    for(auto &segment : segments) {
+        if(segment.curl) {
+            curl_multi_remove_handle(multi, segment.curl);
+            curl_easy_cleanup(segment.curl);
+        }
+        mismatched = mismatched || segment.mismatched;
+    }
+    curl_multi_cleanup(multi);
+
+    // Keep what we have so the next attempt can resume it
+    if(final_result != CURLE_OK && !mismatched) {
+        for(auto &segment : segments) {
+            segment.flush();
+        }
+    }
+    bool written = writer->finish();
+    downloader->writer = nullptr;
+    writer.reset();
+
+    downloader->mutex.lock();
+    if(final_result == CURLE_OK) {
+        // Make sure everything made it to the file before calling it done
+        std::filesystem::remove(resume_path, ec);
+        if(!written || std::fflush(downloader->output_file_handle) != 0 || std::filesystem::file_size(downloader->output_file, ec) != total_size || ec) {
+            final_result = CURLE_WRITE_ERROR;
         }
         else {
-            std::copy(ptr, ptr + nmemb, userdata->buffer.data() + userdata->buffer_used);
-            userdata->buffer_used += nmemb;
+            downloader->contiguous_size = total_size;
         }
+    }
+    else if(!mismatched) {
+        save_state(segments);
+    }
+    downloader->mutex.unlock();
 
-        userdata->mutex.unlock();
-        return nmemb;
+    // What we had isn't what the server has now, so start over
+    if(mismatched) {
+        std::filesystem::remove(resume_path, ec);
+        other_mirrors.insert(other_mirrors.begin(), url);
+        return download_segmented(downloader, other_mirrors);
     }
 
-    // When progress has been made, record it here
-    static int progress_callback(HACMapDownloader *clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t, curl_off_t) {
-        clientp->mutex.lock();
-        clientp->downloaded_size = dlnow;
-        clientp->total_size = dltotal;
-        clientp->mutex.unlock();
-        return 0;
+    return final_result;
+}
+
+void HACMapDownloader::set_preferred_server_node(const std::optional<unsigned int> &server) noexcept {
+    this->mutex.lock();
+    this->preferred_server_node = server;
+    this->mutex.unlock();
+}
+
+std::size_t HACMapDownloader::get_download_speed() noexcept {
+    return this->download_speed / 1000;
+}
+
+std::optional<std::size_t> HACMapDownloader::get_seconds_remaining() noexcept {
+    std::size_t speed = this->download_speed;
+    std::size_t downloaded = this->downloaded_size;
+    std::size_t total = this->total_size;
+    if(speed == 0 || total == 0 || downloaded > total) {
+        return std::nullopt;
     }
-};
+    return (total - downloaded + speed - 1) / speed;
+}
+
+void HACMapDownloader::update_throughput() {
+    this->throughput->add(this->downloaded_size);
+    auto throughput = this->throughput->throughput(THROUGHPUT_MINIMUM_SPAN);
+    if(throughput.has_value()) {
+        this->download_speed = static_cast<std::size_t>(*throughput);
+    }
+}
+
+void HACMapDownloader::set_segment_count(unsigned int segments) noexcept {
+    this->mutex.lock();
+    this->segment_count = std::max(segments, 1U);
+    this->mutex.unlock();
+}
+
+void HACMapDownloader::set_urls(const std::vector<std::string> &urls) noexcept {
+    this->mutex.lock();
+    this->urls = urls;
+    this->mutex.unlock();
+}
+
+void HACMapDownloader::set_mirror_cache_file(const std::optional<std::string> &path) noexcept {
+    this->mutex.lock();
+    this->mirror_cache_file = path;
+    this->mutex.unlock();
+}
+
+void HACMapDownloader::set_maximum_speed(std::size_t bytes_per_second) noexcept {
+    this->mutex.lock();
+    this->maximum_speed = bytes_per_second;
+    this->mutex.unlock();
+}
 
 const std::string &HACMapDownloader::get_map() const noexcept {
     return this->map;
@@ -168,8 +1273,14 @@ void HACMapDownloader::cancel() noexcept {
         if(std::filesystem::exists(this->output_file)) {
             if(this->output_file_handle) {
                 std::fclose(this->output_file_handle);
+                this->output_file_handle = nullptr;
+            }
+
+            // Partial downloads that can be resumed are kept for next time
+            std::error_code ec;
+            if(!std::filesystem::exists(resume_file_path(this->output_file), ec)) {
+                std::filesystem::remove(this->output_file, ec);
             }
-            std::filesystem::remove(this->output_file);
         }
     }
     if(this->status == DOWNLOAD_STAGE_CANCELED) {
@@ -206,7 +1317,14 @@ void HACMapDownloader::dispatch() {
         return;
     }
 
-    this->output_file_handle = std::fopen(this->output_file.data(), "wb");
+    // Keep what's there if it's a partial download we can resume
+    std::error_code ec;
+    if(std::filesystem::exists(resume_file_path(this->output_file), ec)) {
+        this->output_file_handle = std::fopen(this->output_file.data(), "rb+");
+    }
+    if(!this->output_file_handle) {
+        this->output_file_handle = std::fopen(this->output_file.data(), "wb+");
+    }
 
     // If we failed to open, give up and close, unlocking the mutex
     if(!this->output_file_handle) {
@@ -235,16 +1353,23 @@ void HACMapDownloader::dispatch() {
     // 10 second timeout
     curl_easy_setopt(this->curl, CURLOPT_CONNECTTIMEOUT, 10L);
 
+    // Don't go faster than we're allowed to
+    if(this->maximum_speed > 0) {
+        curl_easy_setopt(this->curl, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(this->maximum_speed));
+    }
+
     // Set the download stage to starting
     this->status = HACMapDownloader::DOWNLOAD_STAGE_STARTING;
 
     // Hold 1 MiB of data in memory
-    this->buffer.insert(this->buffer.end(), 1024 * 1024, std::byte());
-    this->buffer_used = 0;
+    this->buffer.reserve(WRITE_BUFFER_SIZE);
+    this->buffer_offset = 0;
 
     // Set the number of bytes downloaded to 0
     this->downloaded_size = 0;
     this->total_size = 0;
+    this->download_speed = 0;
+    this->contiguous_size = 0;
 
     // Make the thread happen
     this->dispatch_thread = std::thread(HACMapDownloader::dispatch_thread_function, this);
@@ -254,24 +1379,37 @@ void HACMapDownloader::dispatch() {
 }
 
 HACMapDownloader::DownloadStage HACMapDownloader::get_status() noexcept {
-    this->mutex.lock();
-    auto return_value = this->status;
-    this->mutex.unlock();
-    return return_value;
+    return this->status;
 }
 
 std::size_t HACMapDownloader::get_downloaded_size() noexcept {
+    return this->downloaded_size;
+}
+
+std::size_t HACMapDownloader::get_contiguous_size(unsigned int *restarts) noexcept {
     this->mutex.lock();
-    std::size_t return_value = this->downloaded_size;
+    std::size_t return_value = this->contiguous_size;
+    if(restarts) {
+        *restarts = this->restarts;
+    }
     this->mutex.unlock();
     return return_value;
 }
 
 std::size_t HACMapDownloader::get_total_size() noexcept {
-    this->mutex.lock();
-    std::size_t return_value = this->total_size;
-    this->mutex.unlock();
-    return return_value;
+    return this->total_size;
+}
+
+bool HACMapDownloader::truncate_output_file() noexcept {
+    // Anything reading what we had has to start over
+    if(this->contiguous_size > 0) {
+        this->restarts++;
+        this->contiguous_size = 0;
+    }
+
+    // Failing over to another mirror reads back what was written to compare it, so this has to be readable, too
+    this->output_file_handle = std::freopen(this->output_file.data(), "wb+", this->output_file_handle);
+    return this->output_file_handle != nullptr;
 }
 
 bool HACMapDownloader::is_finished_no_mutex() const noexcept {
@@ -279,13 +1417,34 @@ bool HACMapDownloader::is_finished_no_mutex() const noexcept {
 }
 
 bool HACMapDownloader::is_finished() noexcept {
-    auto m = this->mutex.try_lock();
-    if(!m) {
+    return this->is_finished_no_mutex();
+}
+
+bool HACMapDownloader::move_partial_download(const char *from, const char *to) noexcept {
+    // If it can't be resumed, there's no point in keeping it, and whatever is at the destination is left alone
+    std::error_code ec;
+    if(!std::filesystem::exists(from, ec) || !std::filesystem::exists(resume_file_path(from), ec)) {
+        delete_partial_download(from);
         return false;
     }
-    bool finished = this->is_finished_no_mutex();
-    this->mutex.unlock();
-    return finished;
+
+    std::filesystem::remove(resume_file_path(to), ec);
+    std::filesystem::rename(from, to, ec);
+    if(!ec) {
+        std::filesystem::rename(resume_file_path(from), resume_file_path(to), ec);
+    }
+    if(ec) {
+        delete_partial_download(from);
+        delete_partial_download(to);
+        return false;
+    }
+    return true;
+}
+
+void HACMapDownloader::delete_partial_download(const char *output_file) noexcept {
+    std::error_code ec;
+    std::filesystem::remove(output_file, ec);
+    std::filesystem::remove(resume_file_path(output_file), ec);
 }
 
 HACMapDownloader::HACMapDownloader(const char *map, const char *output_file, const char *game_engine) : map(map), output_file(output_file), game_engine(game_engine) {
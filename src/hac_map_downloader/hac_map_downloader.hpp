@@ -3,12 +3,14 @@
 #ifndef HAC_MAP_DOWNLOADER_HPP
 #define HAC_MAP_DOWNLOADER_HPP
 
+#include <atomic>
 #include <mutex>
 #include <vector>
 #include <cstdlib>
 #include <chrono>
 #include <thread>
 #include <optional>
+#include <string>
 
 /**
  * Map downloading class
@@ -31,12 +33,12 @@ public:
     void dispatch();
 
     /**
-     * Abort the download
+     * Abort the download; what was downloaded is kept so the download can be resumed if the server supports it
      */
     void cancel() noexcept;
 
     /**
-     * Get the current download status
+     * Get the current download status; this doesn't wait on the download, so it can be called every frame
      * @return download status
      */
     DownloadStage get_status() noexcept;
@@ -47,6 +49,14 @@ public:
      */
     std::size_t get_downloaded_size() noexcept;
 
+    /**
+     * Get how much of the start of the file was downloaded and written to it with nothing missing, so it can be read while the rest
+     * is still downloading. If the download has to start over, this goes back to 0 and restarts is incremented.
+     * @param restarts set to the number of times the download started over, if not null
+     * @return         size in bytes
+     */
+    std::size_t get_contiguous_size(unsigned int *restarts = nullptr) noexcept;
+
     /**
      * Get the total size of the file. This can return 0 if the size is currently unknown.
      * @return file size bytes
@@ -60,11 +70,17 @@ public:
     bool is_finished() noexcept;
 
     /**
-     * Get the download speed in kilobytes per second
+     * Get how fast the download went over the last few seconds
      * @return download speed in kilobytes per second
      */
     std::size_t get_download_speed() noexcept;
 
+    /**
+     * Get how long the rest of the download will take at the speed it's going now
+     * @return seconds remaining, or std::nullopt if the speed or size isn't known yet
+     */
+    std::optional<std::size_t> get_seconds_remaining() noexcept;
+
     /**
      * Get the map name
      * @return map name
@@ -77,6 +93,47 @@ public:
      */
     void set_preferred_server_node(const std::optional<unsigned int> &server) noexcept;
 
+    /**
+     * Set the number of connections to download with. If the server supports range requests, the map is split into this many
+     * segments which are downloaded at the same time; otherwise, it's downloaded over one connection.
+     * @param segments number of segments (1 to download over one connection)
+     */
+    void set_segment_count(unsigned int segments) noexcept;
+
+    /**
+     * Download from these mirrors instead of the HaloNet repo's nodes (such as for testing)
+     * @param urls URLs of the mirrors, or none to use the repo
+     */
+    void set_urls(const std::vector<std::string> &urls) noexcept;
+
+    /**
+     * Set the file to remember how fast each mirror was in, so they don't all have to be tried again for a while
+     * @param path path to the file, or std::nullopt to not remember
+     */
+    void set_mirror_cache_file(const std::optional<std::string> &path) noexcept;
+
+    /**
+     * Limit how fast to download, such as to download in the background without getting in the way of anything else; this is shared
+     * between the connections
+     * @param bytes_per_second most bytes per second to download at, or 0 for no limit
+     */
+    void set_maximum_speed(std::size_t bytes_per_second) noexcept;
+
+    /**
+     * Move what was downloaded of a map that wasn't finished (and what's needed to resume it) so another download to that path
+     * picks up where it left off; this replaces anything already there
+     * @param from output file of the download that was stopped; it must not be in use anymore
+     * @param to   output file of the download that'll resume it
+     * @return     true if successful; if not, what was downloaded is deleted
+     */
+    static bool move_partial_download(const char *from, const char *to) noexcept;
+
+    /**
+     * Delete what was downloaded of a map that wasn't finished, along with what's needed to resume it
+     * @param output_file output file of the download that was stopped; it must not be in use anymore
+     */
+    static void delete_partial_download(const char *output_file) noexcept;
+
     HACMapDownloader(const char *map, const char *output_file, const char *game_engine);
     ~HACMapDownloader();
 
@@ -93,6 +150,18 @@ private:
     /** Preferred server to use */
     std::optional<unsigned int> preferred_server_node;
 
+    /** Number of segments to download at once */
+    unsigned int segment_count = 1;
+
+    /** Mirrors to use instead of the repo */
+    std::vector<std::string> urls;
+
+    /** File to remember how fast each mirror was in */
+    std::optional<std::string> mirror_cache_file;
+
+    /** Most bytes per second to download at, or 0 for no limit */
+    std::size_t maximum_speed = 0;
+
     /** Post! */
     std::string post_fields;
 
@@ -100,35 +169,56 @@ private:
     std::string game_engine;
 
     /** File to write to as we download */
-    std::FILE *output_file_handle;
+    std::FILE *output_file_handle = nullptr;
 
     /** How much was downloaded so far */
-    std::size_t downloaded_size = 0;
+    std::atomic<std::size_t> downloaded_size = 0;
 
     /** How much is left to download */
-    std::size_t total_size = 0;
+    std::atomic<std::size_t> total_size = 0;
+
+    /** Download speed over the last few seconds in bytes per second */
+    std::atomic<std::size_t> download_speed = 0;
+
+    /** How much of the start of the file was written with nothing missing */
+    std::size_t contiguous_size = 0;
+
+    /** Number of times the download started over after some of the file was written */
+    unsigned int restarts = 0;
 
     /** Current status of the download */
-    DownloadStage status = DOWNLOAD_STAGE_NOT_STARTED;
+    std::atomic<DownloadStage> status = DOWNLOAD_STAGE_NOT_STARTED;
 
-    /** Buffer for holding data */
+    /** Data received over the main connection but not yet written */
     std::vector<std::byte> buffer;
 
-    /** Amount of the buffer used */
-    std::size_t buffer_used;
+    /** Where the data in the buffer goes in the file */
+    std::size_t buffer_offset = 0;
 
     /** Clock to use */
     using Clock = std::chrono::steady_clock;
 
-    /** Time when the download started*/
-    Clock::time_point download_started;
-
     /** CURL handle */
     void *curl = nullptr;
 
     /** Callback class */
     class HACMapDownloaderCallback;
 
+    /** Byte range being downloaded over its own connection */
+    struct DownloadSegment;
+
+    /** Writes to the output file on its own thread */
+    class FileWriter;
+
+    /** Writer used for the download in progress */
+    FileWriter *writer = nullptr;
+
+    /** Keeps track of how fast the download is going */
+    class ThroughputWindow;
+
+    /** Throughput of the download in progress */
+    ThroughputWindow *throughput = nullptr;
+
     /** Dispatch thread that does map downloading */
     std::thread dispatch_thread;
 
@@ -138,6 +228,34 @@ private:
      */
     static void dispatch_thread_function(HACMapDownloader *downloader);
 
+    /**
+     * Order the mirrors by how quickly they send the start of the file, asking all of them at once
+     * @param downloader downloader reference
+     * @param urls       URLs of the mirrors, in the order to use them if they can't be ranked
+     * @return           URLs of the mirrors, fastest first
+     */
+    static std::vector<std::string> rank_mirrors(HACMapDownloader *downloader, const std::vector<std::string> &urls);
+
+    /**
+     * Download the map in segments if the server supports range requests, resuming a previous download of it if there is one, or
+     * over the main connection if not. If a mirror fails or slows down too much, the next one is used.
+     * @param downloader downloader reference
+     * @param mirrors    URLs of the mirrors, best first
+     * @return           CURLcode of the download
+     */
+    static int download_segmented(HACMapDownloader *downloader, const std::vector<std::string> &mirrors);
+
+    /**
+     * Note how much was downloaded so far and work out how fast the download is going; this is done by the dispatch thread
+     */
+    void update_throughput();
+
+    /**
+     * Open the output file again, discarding what was downloaded so far; the mutex must be locked
+     * @return true if successful
+     */
+    bool truncate_output_file() noexcept;
+
     /**
      * Check if finished without locking
      * @return true if finished
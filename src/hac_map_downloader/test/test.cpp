@@ -1,20 +1,51 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
 #include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "../hac_map_downloader.hpp"
 
 int main(int argc, const char **argv) {
-    if(argc != 4 && argc != 5) {
-        std::printf("Usage: %s <map name> <tmp file> <engine> [first-server]\n", argv[0]);
+    // Options come first
+    std::vector<const char *> arguments;
+    std::vector<std::string> urls;
+    std::optional<std::string> mirror_cache_file;
+    unsigned int segments = 1;
+    std::size_t maximum_speed = 0;
+    for(int i = 1; i < argc; i++) {
+        if(std::strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            urls.emplace_back(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            mirror_cache_file = argv[++i];
+        }
+        else if(std::strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            segments = std::stoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            maximum_speed = std::stoul(argv[++i]) * 1000;
+        }
+        else {
+            arguments.push_back(argv[i]);
+        }
+    }
+
+    if(arguments.size() != 3 && arguments.size() != 4) {
+        std::printf("Usage: %s [-u <url> ...] [-c <mirror cache>] [-s <segments>] [-l <kB/s>] <map name> <tmp file> <engine> [first-server]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    HACMapDownloader downloader(argv[1], argv[2], argv[3]);
+    HACMapDownloader downloader(arguments[0], arguments[1], arguments[2]);
 
     // Set a preferred server
-    if(argc > 4) {
-        downloader.set_preferred_server_node(std::stoi(argv[4]));
+    if(arguments.size() > 3) {
+        downloader.set_preferred_server_node(std::stoi(arguments[3]));
     }
+    downloader.set_urls(urls);
+    downloader.set_mirror_cache_file(mirror_cache_file);
+    downloader.set_segment_count(segments);
+    downloader.set_maximum_speed(maximum_speed);
     downloader.dispatch();
 
     for(;;) {
@@ -36,8 +67,14 @@ int main(int argc, const char **argv) {
                     std::snprintf(download_speed_buffer, sizeof(download_speed_buffer), "%zu kB/s", download_speed);
                 }
 
+                char eta_buffer[16] = "--:--";
+                auto seconds_remaining = downloader.get_seconds_remaining();
+                if(seconds_remaining.has_value()) {
+                    std::snprintf(eta_buffer, sizeof(eta_buffer), "%zu:%02zu", *seconds_remaining / 60, *seconds_remaining % 60);
+                }
+
                 char full_buffer[80];
-                std::snprintf(full_buffer, sizeof(full_buffer), "Progress: %7.02f / %7.02f MiB (%4.01f%%, %s)", dlnow / 1024.0F / 1024.0F, dltotal / 1024.0F / 1024.0F, static_cast<float>(dlnow) / dltotal * 100.0F, download_speed_buffer);
+                std::snprintf(full_buffer, sizeof(full_buffer), "Progress: %7.02f / %7.02f MiB (%4.01f%%, %s, %s left)", dlnow / 1024.0F / 1024.0F, dltotal / 1024.0F / 1024.0F, static_cast<float>(dlnow) / dltotal * 100.0F, download_speed_buffer, eta_buffer);
                 std::printf("%-80s\r", full_buffer);
                 break;
             }
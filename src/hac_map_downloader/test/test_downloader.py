@@ -0,0 +1,318 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Runs hac_map_downloader_test against local copies of test_server.py and checks what it asked them for (ctest runs each test):
+#
+#   python3 test_downloader.py <hac_map_downloader_test> <test>
+#
+# range      downloads in segments, each one asking for its own range
+# no_ranges  downloads from a server that ignores ranges in one go instead
+# drop       connections are closed partway through, and only what's left of those segments is asked for again
+# resume     a download that was killed picks up where it left off, checking the end of what it had first
+# resume_verify_drop
+#            connections are closed while checking the end of what it had, and it still picks up where it left off
+# resume_mismatch
+#            what it had doesn't match the end of what it had, so it starts over
+# resume_changed
+#            the file's validator changed, so it starts over
+# ranking    mirrors are asked for the start of the file at once, and the one that answers first is used; how fast each one
+#            answered is remembered, so they aren't asked again next time
+# failover   the mirror slows to a crawl partway through, so it moves to the next one, only asking it for what's left of each
+#            segment (plus the end of what it had to make sure it's the same file)
+# slow_tail  the last segment finishing on its own is slower than all of them together, but that isn't the mirror slowing down
+
+import argparse
+import os
+import re
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+SEGMENTS = 4
+SMALL_FILE_SIZE = 6 * 1024 * 1024
+
+# Failing over needs enough of a file for the speed to be measured before and after it slows down
+LARGE_FILE_SIZE = 12 * 1024 * 1024
+
+# How much of the end of each segment is downloaded again to check it when resuming (RESUME_VERIFY_SIZE)
+RESUME_VERIFY_SIZE = 4096
+
+class Server:
+    def __init__(self, file, *options, port=None):
+        if port is None:
+            with socket.socket() as s:
+                s.bind(("127.0.0.1", 0))
+                port = s.getsockname()[1]
+        self.port = port
+        self.url = "http://127.0.0.1:{}/".format(self.port)
+        server_script = os.path.join(os.path.dirname(os.path.abspath(__file__)), "test_server.py")
+        self.process = subprocess.Popen([sys.executable, server_script, file, "--port", str(self.port), *options], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+
+        # It says so once it's listening
+        self.process.stdout.readline()
+        self.log = None
+
+    def stop(self):
+        if self.log is None:
+            self.process.terminate()
+            self.log = self.process.communicate()[0]
+        return self.log
+
+    # Every range it was asked for, in order
+    def ranges(self):
+        return [(int(m.group(1)), int(m.group(2))) for m in re.finditer(r"^bytes=(\d+)-(\d+) ", self.stop(), re.MULTILINE)]
+
+class Test:
+    def __init__(self, program, directory):
+        self.program = program
+        self.directory = directory
+        self.failures = []
+        self.servers = []
+
+    def make_file(self, size):
+        self.data = os.urandom(size)
+        self.file = os.path.join(self.directory, "served.map")
+        with open(self.file, "wb") as f:
+            f.write(self.data)
+        self.output = os.path.join(self.directory, "download.map")
+
+    def serve(self, *options, port=None):
+        server = Server(self.file, *options, port=port)
+        self.servers.append(server)
+        return server
+
+    def download_arguments(self, urls, segments, options):
+        arguments = [self.program]
+        for url in urls:
+            arguments += ["-u", url]
+        return arguments + ["-s", str(segments), *options, "test", self.output, "custom"]
+
+    def download(self, urls, segments=SEGMENTS, options=()):
+        return subprocess.run(self.download_arguments(urls, segments, options), stdout=subprocess.DEVNULL, timeout=300).returncode
+
+    # Start downloading and kill it once it's partway through, returning how much of each segment it says it has
+    def download_and_kill(self, urls, segments=SEGMENTS, options=()):
+        process = subprocess.Popen(self.download_arguments(urls, segments, options), stdout=subprocess.DEVNULL)
+        try:
+            deadline = time.monotonic() + 60
+            while time.monotonic() < deadline and process.poll() is None:
+                time.sleep(0.25)
+
+                # Pause it so it isn't in the middle of saving it when it's read
+                process.send_signal(signal.SIGSTOP)
+                written = self.resume_state(segments)
+                if written is not None and sum(written) > len(self.data) // 3:
+                    return written
+                process.send_signal(signal.SIGCONT)
+            return None
+        finally:
+            process.kill()
+            process.wait()
+
+    def resume_state(self, segments=SEGMENTS):
+        try:
+            with open(self.output + ".resume") as f:
+                written = [int(m.group(1)) for m in re.finditer(r"^segment=\d+ \d+ (\d+)$", f.read(), re.MULTILINE)]
+                return written if len(written) == segments else None
+        except OSError:
+            return None
+
+    # Make a partial download of the file like one that was stopped with this much of each segment written
+    def make_partial(self, url, written, validator, corrupt=False):
+        partial = bytearray(len(self.data))
+        with open(self.output + ".resume", "w") as f:
+            f.write("url={}\nsize={}\nvalidator={}\n".format(url, len(self.data), validator))
+            for (first, last), w in zip(self.segments(len(written)), written):
+                partial[first:first + w] = self.data[first:first + w]
+                if corrupt and w > 0:
+                    partial[first + w - 1] ^= 0xFF
+                f.write("segment={} {} {}\n".format(first, last + 1 - first, w))
+        with open(self.output, "wb") as f:
+            f.write(partial)
+
+    def check(self, condition, failure):
+        if not condition:
+            self.failures.append(failure)
+
+    def check_download(self, returncode):
+        self.check(returncode == 0, "hac_map_downloader_test failed")
+        with open(self.output, "rb") as f:
+            self.check(f.read() == self.data, "the download doesn't match the file")
+        self.check(not os.path.exists(self.output + ".resume"), "the resume file was left behind")
+
+    # Where each segment is when nothing was downloaded yet
+    def segments(self, segments=SEGMENTS):
+        size = len(self.data) // segments
+        return [(s * size, (s + 1) * size - 1 if s + 1 < segments else len(self.data) - 1) for s in range(segments)]
+
+    # Ranges asked for that end where a segment ends (anything else is probing the server)
+    def segment_ranges(self, server, segments=SEGMENTS):
+        ends = { last for _, last in self.segments(segments) }
+        return [r for r in server.ranges() if r[1] in ends]
+
+    # Check that each segment picked up where it left off, less what's downloaded again to check it, and then picked up
+    # where each retry left off (if there are any)
+    def check_resumed(self, requested, written, retry_size=None):
+        for (first, last), w in zip(self.segments(), written):
+            starts = [start for start, end in requested if end == last]
+            resumed = first + w - min(w, RESUME_VERIFY_SIZE)
+            if first + w > last:
+                self.check(starts == [], "segment {}-{} was already done but was asked for from {}".format(first, last, starts))
+            elif retry_size is None:
+                self.check(starts == [resumed], "segment {}-{} should resume from {} but was asked for from {}".format(first, last, resumed, starts))
+            else:
+                self.check(len(starts) > 0 and starts == [resumed + retry_size * i for i in range(len(starts))], "segment {}-{} should resume from {} (and every {} bytes after that) but was asked for from {}".format(first, last, resumed, retry_size, starts))
+
+    def stop(self):
+        for server in self.servers:
+            server.stop()
+
+def test_range(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve()
+    test.check_download(test.download([server.url]))
+    requested = sorted(test.segment_ranges(server))
+    test.check(requested == test.segments(), "expected each segment to be asked for once, but got {}".format(requested))
+
+def test_no_ranges(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve("--no-ranges")
+    test.check_download(test.download([server.url]))
+    test.check(server.stop().count("GET") == 2, "expected one request to check for ranges and one for the file")
+
+def test_drop(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve("--drop-after", "300000", "--drop-count", "3")
+    test.check_download(test.download([server.url]))
+
+    # Each time a segment is dropped, it has to pick up another 300000 bytes in
+    requested = test.segment_ranges(server)
+    test.check(len(requested) == SEGMENTS + 3, "expected three retries, but got {}".format(requested))
+    for first, last in test.segments():
+        starts = [start for start, end in requested if end == last]
+        test.check(starts == [first + 300000 * i for i in range(len(starts))], "segment {}-{} was asked for from {}".format(first, last, starts))
+
+def test_resume(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve("--rate", "300000")
+    written = test.download_and_kill([server.url])
+    test.check(written is not None, "it never saved how far along it was")
+    if written is None:
+        return
+
+    # Same file at the same URL, but with a fresh log
+    server.stop()
+    server = test.serve(port=server.port)
+    test.check_download(test.download([server.url]))
+    test.check_resumed(test.segment_ranges(server), written)
+
+def test_resume_verify_drop(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve("--etag", "\"x\"", "--drop-after", "1000", "--drop-count", "2")
+    written = [300000, 500000, 700000, 900000]
+    test.make_partial(server.url, written, "\"x\"")
+    test.check_download(test.download([server.url]))
+    requested = test.segment_ranges(server)
+    test.check(len(requested) == SEGMENTS + 2, "expected two retries, but got {}".format(requested))
+    test.check_resumed(requested, written, retry_size=1000)
+
+def test_resume_mismatch(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve("--etag", "\"x\"")
+    test.make_partial(server.url, [300000, 500000, 700000, 900000], "\"x\"", corrupt=True)
+    test.check_download(test.download([server.url]))
+    requested = test.segment_ranges(server)
+    test.check(sorted(requested[-SEGMENTS:]) == test.segments(), "expected it to start over, but got {}".format(requested))
+
+def test_resume_changed(test):
+    test.make_file(SMALL_FILE_SIZE)
+    server = test.serve("--etag", "\"y\"")
+    test.make_partial(server.url, [300000, 500000, 700000, 900000], "\"x\"")
+    test.check_download(test.download([server.url]))
+    requested = sorted(test.segment_ranges(server))
+    test.check(requested == test.segments(), "expected it to start over, but got {}".format(requested))
+
+def test_ranking(test):
+    test.make_file(SMALL_FILE_SIZE)
+    cache = os.path.join(test.directory, "mirrors.txt")
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        closed = "http://127.0.0.1:{}/".format(s.getsockname()[1])
+    slow = test.serve("--delay", "3")
+    fast = test.serve()
+    test.check_download(test.download([closed, slow.url, fast.url], options=["-c", cache]))
+    test.check(test.segment_ranges(slow) == [], "segments were downloaded from the slow mirror")
+    test.check(sorted(test.segment_ranges(fast)) == test.segments(), "segments weren't all downloaded from the fast mirror")
+
+    # Only the one that answered in time should have a time
+    with open(cache) as f:
+        seconds = { m.group(2) : float(m.group(1)) for m in re.finditer(r"^\d+ (\S+) (\S+)$", f.read(), re.MULTILINE) }
+    answered = sorted(url for url in seconds if seconds[url] >= 0.0)
+    test.check(len(seconds) == 3 and answered == [fast.url.rstrip("/")], "expected only the fast mirror to have answered, but got {}".format(seconds))
+
+    # Next time, it shouldn't even ask the slow one (checking the logs stopped them, so start them again)
+    slow = test.serve("--delay", "3", port=slow.port)
+    fast = test.serve(port=fast.port)
+    test.check_download(test.download([slow.url, fast.url], options=["-c", cache]))
+    test.check("GET" not in slow.stop(), "the slow mirror was asked again even though it was remembered")
+    test.check(sorted(test.segment_ranges(fast)) == test.segments(), "segments weren't all downloaded from the fast mirror the second time")
+
+def test_failover(test):
+    test.make_file(LARGE_FILE_SIZE)
+    fast = test.serve("--rate", "200000", "--collapse-after", str(LARGE_FILE_SIZE // 2))
+    slow = test.serve("--delay", "0.3")
+    test.check_download(test.download([fast.url, slow.url]))
+
+    # Each segment should have been moved over once, and not from the start
+    requested = test.segment_ranges(slow)
+    segments = test.segments()
+    test.check(len(requested) > 0, "it never failed over")
+    test.check(len(requested) == len({ last for _, last in requested }), "segments were downloaded from the second mirror more than once: {}".format(sorted(requested)))
+    for first, last in requested:
+        test.check((first, last) not in segments, "segment {}-{} was downloaded from the start again".format(first, last))
+
+def test_slow_tail(test):
+    # Every segment but the first is almost done, so the first one goes on alone for a while at the same speed
+    test.make_file(LARGE_FILE_SIZE)
+    segments = 12
+    fast = test.serve("--rate", "50000", "--etag", "\"x\"")
+    slow = test.serve("--delay", "1", "--etag", "\"x\"")
+    test.make_partial(fast.url, [0] + [last + 1 - first - 600000 for first, last in test.segments(segments)[1:]], "\"x\"")
+    test.check_download(test.download([fast.url, slow.url], segments=segments))
+    requested = test.segment_ranges(slow, segments)
+    test.check(requested == [], "it failed over even though the mirror didn't slow down: {}".format(requested))
+
+TESTS = {
+    "range": test_range,
+    "no_ranges": test_no_ranges,
+    "drop": test_drop,
+    "resume": test_resume,
+    "resume_verify_drop": test_resume_verify_drop,
+    "resume_mismatch": test_resume_mismatch,
+    "resume_changed": test_resume_changed,
+    "ranking": test_ranking,
+    "failover": test_failover,
+    "slow_tail": test_slow_tail,
+}
+
+parser = argparse.ArgumentParser(description="Test hac_map_downloader_test against test_server.py")
+parser.add_argument("test_program", help="path to hac_map_downloader_test")
+parser.add_argument("test", choices=TESTS.keys(), help="test to run")
+args = parser.parse_args()
+
+with tempfile.TemporaryDirectory() as directory:
+    test = Test(os.path.abspath(args.test_program), directory)
+    try:
+        TESTS[args.test](test)
+    finally:
+        test.stop()
+
+if test.failures:
+    for failure in test.failures:
+        print("FAILED: {}".format(failure))
+    sys.exit(1)
+
+print("Passed: {}".format(args.test))
@@ -0,0 +1,128 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Stand-in for the map repo to test hac_map_downloader_test against, serving one file for every request:
+#
+#   python3 test_server.py <file> [--port 8000] [--no-ranges] [--drop-after <bytes>] [--drop-count <n>]
+#   hac_map_downloader_test -u http://127.0.0.1:8000/ -s 4 <map> download.map custom
+#
+# --drop-after closes the connection after sending that many bytes of a response, the first --drop-count times, to test
+# recovering from transfers that fail partway through. Run the test program again afterwards to test resuming; --etag changes
+# the file's validator so resuming has to start over.
+#
+# Run more than one with different --delay and --rate values and pass each one's URL with -u to test ranking mirrors, and use
+# --collapse-after on the fastest one to test moving to another mirror partway through. test_downloader.py does all of this
+# (ctest runs it) and checks what was asked for.
+
+import argparse
+import email.utils
+import http.server
+import os
+import re
+import threading
+import time
+
+parser = argparse.ArgumentParser(description="Serve a file like the map repo does")
+parser.add_argument("file", help="file to serve")
+parser.add_argument("--port", type=int, default=8000, help="port to listen on")
+parser.add_argument("--no-ranges", action="store_true", help="ignore Range headers like a server that doesn't support them")
+parser.add_argument("--drop-after", type=int, default=None, help="close connections after sending this many bytes")
+parser.add_argument("--drop-count", type=int, default=1, help="number of connections to close early")
+parser.add_argument("--etag", default=None, help="ETag to send (default: based on the file's size and modification time)")
+parser.add_argument("--no-validators", action="store_true", help="don't send an ETag or Last-Modified")
+parser.add_argument("--delay", type=float, default=0.0, help="seconds to wait before answering each request")
+parser.add_argument("--rate", type=int, default=None, help="bytes per second to send each response at")
+parser.add_argument("--collapse-after", type=int, default=None, help="send at 16 KiB/s once this many bytes were sent in total")
+args = parser.parse_args()
+
+with open(args.file, "rb") as f:
+    data = f.read()
+
+modified = os.path.getmtime(args.file)
+etag = args.etag if args.etag is not None else "\"{:x}-{:x}\"".format(len(data), int(modified))
+last_modified = email.utils.formatdate(modified, usegmt=True)
+
+lock = threading.Lock()
+drops_left = args.drop_count if args.drop_after is not None else 0
+bytes_sent = 0
+
+CHUNK_SIZE = 16 * 1024
+COLLAPSED_RATE = 16 * 1024
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def send_body(self, body):
+        global bytes_sent
+
+        for offset in range(0, len(body), CHUNK_SIZE):
+            chunk = body[offset:offset + CHUNK_SIZE]
+            with lock:
+                collapsed = args.collapse_after is not None and bytes_sent >= args.collapse_after
+                bytes_sent += len(chunk)
+            rate = COLLAPSED_RATE if collapsed else args.rate
+            self.wfile.write(chunk)
+            if rate:
+                time.sleep(len(chunk) / rate)
+
+    def do_GET(self):
+        global drops_left
+
+        time.sleep(args.delay)
+
+        first = 0
+        last = len(data) - 1
+        status = 200
+        range_header = self.headers.get("Range")
+        if range_header and not args.no_ranges:
+            match = re.fullmatch(r"bytes=(\d+)-(\d*)", range_header.strip())
+            if not match or int(match.group(1)) >= len(data):
+                self.send_response(416)
+                self.send_header("Content-Range", "bytes */{}".format(len(data)))
+                self.send_header("Content-Length", "0")
+                self.end_headers()
+                return
+            first = int(match.group(1))
+            if match.group(2):
+                last = min(int(match.group(2)), last)
+            status = 206
+
+        body = data[first:last + 1]
+        self.send_response(status)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        if not args.no_validators:
+            self.send_header("ETag", etag)
+            self.send_header("Last-Modified", last_modified)
+        if status == 206:
+            self.send_header("Content-Range", "bytes {}-{}/{}".format(first, last, len(data)))
+        elif not args.no_ranges:
+            self.send_header("Accept-Ranges", "bytes")
+        self.end_headers()
+
+        with lock:
+            drop = drops_left > 0 and len(body) > args.drop_after
+            if drop:
+                drops_left -= 1
+
+        try:
+            if drop:
+                self.send_body(body[:args.drop_after])
+                self.wfile.flush()
+                self.close_connection = True
+                self.connection.shutdown(2)
+            else:
+                self.send_body(body)
+        except (BrokenPipeError, ConnectionResetError):
+            self.close_connection = True
+
+    def log_message(self, format, *log_args):
+        # One at a time so lines from different connections don't run together
+        with lock:
+            print("{} {}".format(self.headers.get("Range", "-"), format % log_args), flush=True)
+
+server = http.server.ThreadingHTTPServer(("127.0.0.1", args.port), Handler)
+print("Serving {} ({} bytes) on port {}".format(args.file, len(data), args.port), flush=True)
+try:
+    server.serve_forever()
+except KeyboardInterrupt:
+    pass
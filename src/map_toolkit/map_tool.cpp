@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "../chimera/map_loading/compression.hpp"
+#include "../chimera/map_loading/crc32.hpp"
+#include "../chimera/map_loading/seekable_map.hpp"
+#include "map_toolkit.hpp"
+
+using namespace Chimera;
+
+static int usage(const char *program) {
+    std::printf("Usage: %s <command> [options] <arguments>\n\n", program);
+    std::printf("Commands:\n");
+    std::printf("  decompress <input> <output>  Decompress a map\n");
+    std::printf("  compress <input> <output>    Compress a map in independent frames\n");
+    std::printf("  verify <map> [map ...]       Check each map's CRC32 against its header\n");
+    std::printf("  benchmark <directory>        Time reading, decompressing, and checksumming maps\n");
+    std::printf("  train <output> <map> [...]   Train a dictionary from the tag data of maps\n");
+    std::printf("  compare <directory>          Compare compressing maps with and without the dictionary\n\n");
+    std::printf("Options:\n");
+    std::printf("  -t <threads>                 Threads to use (default: 0 = all hardware threads)\n");
+    std::printf("  -l <level>                   zstd level to compress with (default: 19)\n");
+    std::printf("  -f <MiB>                     Decompressed size of each frame when compressing (default: %zu)\n", DEFAULT_COMPRESSION_FRAME_SIZE / 1024 / 1024);
+    std::printf("  -D <dictionary>              Dictionary to compress with; can be given more than once to decompress\n");
+    std::printf("                               maps compressed with any of them (compress uses the first one)\n");
+    std::printf("  -s <KiB>                     Maximum size of a trained dictionary (default: %zu)\n", DEFAULT_DICTIONARY_SIZE / 1024);
+    return EXIT_FAILURE;
+}
+
+static double mib(std::size_t size) noexcept {
+    return size / 1024.0 / 1024.0;
+}
+
+int main(int argc, const char **argv) {
+    if(argc < 2) {
+        return usage(argv[0]);
+    }
+
+    std::string command = argv[1];
+    std::size_t threads = 0;
+    int compression_level = 19;
+    std::size_t frame_size = DEFAULT_COMPRESSION_FRAME_SIZE;
+    std::size_t dictionary_size = DEFAULT_DICTIONARY_SIZE;
+    std::uint32_t dictionary_id = 0;
+    std::vector<const char *> arguments;
+
+    for(int i = 2; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if(std::strcmp(argv[i], "-t") == 0 && has_value) {
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if(std::strcmp(argv[i], "-l") == 0 && has_value) {
+            compression_level = std::atoi(argv[++i]);
+        }
+        else if(std::strcmp(argv[i], "-f") == 0 && has_value) {
+            frame_size = std::strtoul(argv[++i], nullptr, 10) * 1024 * 1024;
+        }
+        else if(std::strcmp(argv[i], "-D") == 0 && has_value) {
+            auto id = load_map_compression_dictionary(argv[++i]);
+            if(id == 0) {
+                std::fprintf(stderr, "%s is not a zstd dictionary\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            if(dictionary_id == 0) {
+                dictionary_id = id;
+            }
+        }
+        else if(std::strcmp(argv[i], "-s") == 0 && has_value) {
+            dictionary_size = std::strtoul(argv[++i], nullptr, 10) * 1024;
+        }
+        else if(argv[i][0] == '-') {
+            return usage(argv[0]);
+        }
+        else {
+            arguments.push_back(argv[i]);
+        }
+    }
+
+    using clock = std::chrono::steady_clock;
+
+    if(command == "decompress" && arguments.size() == 2) {
+        try {
+            auto start = clock::now();
+            std::size_t size = decompress_map_file(arguments[0], arguments[1], threads);
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            std::printf("Decompressed %s to %.02f MiB in %.03f seconds\n", arguments[0], mib(size), seconds);
+        }
+        catch(std::exception &) {
+            std::fprintf(stderr, "Failed to decompress %s\n", arguments[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    else if(command == "compress" && arguments.size() == 2) {
+        try {
+            auto start = clock::now();
+            std::size_t size = compress_map_file(arguments[0], arguments[1], compression_level, frame_size, threads, dictionary_id);
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+            std::printf("Compressed %s to %.02f MiB in %.03f seconds\n", arguments[0], mib(size), seconds);
+        }
+        catch(std::exception &) {
+            std::fprintf(stderr, "Failed to compress %s\n", arguments[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    else if(command == "verify" && !arguments.empty()) {
+        bool all_match = true;
+        for(auto *path : arguments) {
+            try {
+                auto info = read_map_file_info(path);
+                if(!has_map_compression_dictionary(info.compression_dictionary)) {
+                    std::fprintf(stderr, "%s: needs dictionary %u (-D)\n", path, info.compression_dictionary);
+                    all_match = false;
+                    continue;
+                }
+                std::uint32_t crc32;
+                read_map_file(path, threads, &crc32);
+                const char *seekable = is_seekable_map_file(path) ? " (seekable)" : "";
+                if(crc32 == info.header_crc32) {
+                    std::printf("%s: %08X OK%s\n", path, crc32, seekable);
+                }
+                else {
+                    std::printf("%s: %08X MISMATCHED (header says %08X)%s\n", path, crc32, info.header_crc32, seekable);
+                    all_match = false;
+                }
+            }
+            catch(std::exception &) {
+                std::fprintf(stderr, "%s: failed to read map\n", path);
+                all_match = false;
+            }
+        }
+        return all_match ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    else if(command == "benchmark" && arguments.size() == 1) {
+        std::vector<std::filesystem::path> maps;
+        std::error_code ec;
+        for(auto &entry : std::filesystem::directory_iterator(arguments[0], ec)) {
+            if(entry.is_regular_file() && entry.path().extension() == ".map") {
+                maps.push_back(entry.path());
+            }
+        }
+        if(ec || maps.empty()) {
+            std::fprintf(stderr, "No maps found in %s\n", arguments[0]);
+            return EXIT_FAILURE;
+        }
+        std::sort(maps.begin(), maps.end());
+
+        std::printf("crc32() is using %s\n", crc32_implementation());
+
+        // Only parts of the map are checksummed, so throughput would be misleading for CRC32
+        std::printf("%-32s %10s %10s %12s %10s %8s\n", "Map", "File MiB", "Map MiB", "Read MiB/s", "CRC32 ms", "CRC32");
+
+        std::size_t total_size = 0;
+        double total_read_seconds = 0.0;
+        double total_crc32_seconds = 0.0;
+        bool all_read = true;
+        for(auto &path : maps) {
+            try {
+                auto result = benchmark_map_file(path, threads);
+                auto size = result.info.decompressed_size;
+                std::printf("%-32s %10.02f %10.02f %12.02f %10.03f %08X\n", path.filename().string().c_str(), mib(result.info.file_size), mib(size), mib(size) / result.read_seconds, result.crc32_seconds * 1000.0, result.crc32);
+                total_size += size;
+                total_read_seconds += result.read_seconds;
+                total_crc32_seconds += result.crc32_seconds;
+            }
+            catch(std::exception &) {
+                std::fprintf(stderr, "%s: failed to read map\n", path.string().c_str());
+                all_read = false;
+            }
+        }
+
+        if(total_size > 0) {
+            std::printf("%-32s %10s %10.02f %12.02f %10.03f\n", "Total", "", mib(total_size), mib(total_size) / total_read_seconds, total_crc32_seconds * 1000.0);
+        }
+        return all_read ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    else if(command == "train" && arguments.size() >= 2) {
+        std::vector<std::filesystem::path> maps(arguments.begin() + 1, arguments.end());
+        try {
+            auto start = clock::now();
+            auto dictionary = train_map_compression_dictionary(maps, dictionary_size, threads);
+            double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+            std::FILE *f = std::fopen(arguments[0], "wb");
+            bool written = f && std::fwrite(dictionary.data(), dictionary.size(), 1, f) == 1;
+            if(f) {
+                std::fclose(f);
+            }
+            if(!written) {
+                std::fprintf(stderr, "Failed to write %s\n", arguments[0]);
+                return EXIT_FAILURE;
+            }
+            std::printf("Trained %s (%.02f KiB, ID %u) from %zu map(s) in %.03f seconds\n", arguments[0], dictionary.size() / 1024.0, add_map_compression_dictionary(dictionary.data(), dictionary.size()), maps.size(), seconds);
+        }
+        catch(std::exception &) {
+            std::fprintf(stderr, "Failed to train a dictionary\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    else if(command == "compare" && arguments.size() == 1) {
+        if(dictionary_id == 0) {
+            std::fprintf(stderr, "compare needs a dictionary (-D)\n");
+            return EXIT_FAILURE;
+        }
+
+        std::vector<std::filesystem::path> maps;
+        std::error_code ec;
+        for(auto &entry : std::filesystem::directory_iterator(arguments[0], ec)) {
+            if(entry.is_regular_file() && entry.path().extension() == ".map") {
+                maps.push_back(entry.path());
+            }
+        }
+        if(ec || maps.empty()) {
+            std::fprintf(stderr, "No maps found in %s\n", arguments[0]);
+            return EXIT_FAILURE;
+        }
+        std::sort(maps.begin(), maps.end());
+
+        std::printf("%-32s %10s %10s %10s %8s %8s %12s %12s\n", "Map", "Map MiB", "zstd MiB", "Dict MiB", "Ratio", "Dict", "MiB/s", "Dict MiB/s");
+
+        std::size_t total_size = 0;
+        std::size_t total_compressed = 0;
+        std::size_t total_dictionary_compressed = 0;
+        double total_seconds = 0.0;
+        double total_dictionary_seconds = 0.0;
+        bool all_read = true;
+        for(auto &path : maps) {
+            try {
+                auto result = benchmark_map_compression(path, dictionary_id, compression_level, frame_size, threads);
+                auto size = result.info.decompressed_size;
+                std::printf("%-32s %10.02f %10.02f %10.02f %8.03f %8.03f %12.02f %12.02f\n", path.filename().string().c_str(), mib(size), mib(result.compressed_size), mib(result.dictionary_compressed_size), static_cast<double>(size) / result.compressed_size, static_cast<double>(size) / result.dictionary_compressed_size, mib(size) / result.decompress_seconds, mib(size) / result.dictionary_decompress_seconds);
+                total_size += size;
+                total_compressed += result.compressed_size;
+                total_dictionary_compressed += result.dictionary_compressed_size;
+                total_seconds += result.decompress_seconds;
+                total_dictionary_seconds += result.dictionary_decompress_seconds;
+            }
+            catch(std::exception &) {
+                std::fprintf(stderr, "%s: failed to compress map\n", path.string().c_str());
+                all_read = false;
+            }
+        }
+
+        if(total_size > 0) {
+            std::printf("%-32s %10.02f %10.02f %10.02f %8.03f %8.03f %12.02f %12.02f\n", "Total", mib(total_size), mib(total_compressed), mib(total_dictionary_compressed), static_cast<double>(total_size) / total_compressed, static_cast<double>(total_size) / total_dictionary_compressed, mib(total_size) / total_seconds, mib(total_size) / total_dictionary_seconds);
+        }
+        return all_read ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    else {
+        return usage(argv[0]);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+# SPDX-License-Identifier: GPL-3.0-only
+
+# Shares the decompression and CRC32 code with Chimera so map packs can be processed (and benchmarked) outside of Halo
+add_library(chimera_map_toolkit STATIC
+    src/chimera/map_loading/compression.cpp
+    src/chimera/map_loading/crc32.c
+    src/chimera/map_loading/map_crc32.cpp
+    src/chimera/map_loading/seekable_map.cpp
+    src/map_toolkit/map_toolkit.cpp
+)
+
+find_package(Threads REQUIRED)
+
+# The bundled zstd is built for Windows, so native builds use the system's (the API used here is stable, so the bundled header works with either)
+if(WIN32)
+    set(CHIMERA_MAP_TOOLKIT_ZSTD ${CMAKE_CURRENT_SOURCE_DIR}/ext/zstd/lib/libzstd.a)
+else()
+    find_library(CHIMERA_MAP_TOOLKIT_ZSTD NAMES zstd libzstd.so.1)
+    if(NOT CHIMERA_MAP_TOOLKIT_ZSTD)
+        message(FATAL_ERROR "zstd is required to build the map toolkit")
+    endif()
+endif()
+
+target_include_directories(chimera_map_toolkit PRIVATE ${CMAKE_CURRENT_SOURCE_DIR}/ext/zstd/include)
+target_link_libraries(chimera_map_toolkit ${CHIMERA_MAP_TOOLKIT_ZSTD} Threads::Threads)
+
+add_executable(chimera_map_tool
+    src/map_toolkit/map_tool.cpp
+)
+
+target_link_libraries(chimera_map_tool chimera_map_toolkit)
+
+if(WIN32)
+    set_target_properties(chimera_map_tool PROPERTIES LINK_FLAGS "-m32 -static-libgcc -static-libstdc++ -static -lwinpthread")
+endif()
+
+# CRC32 correctness test and benchmark; these only depend on crc32.c, so they're built natively, too (run the test with ctest)
+add_executable(crc32_test
+    src/chimera/map_loading/crc32.c
+    src/chimera/map_loading/test/crc32_test.cpp
+)
+
+add_executable(crc32_benchmark
+    src/chimera/map_loading/crc32.c
+    src/chimera/map_loading/test/crc32_benchmark.cpp
+)
+
+add_test(NAME crc32_test COMMAND crc32_test)
+
+# Resource metadata lookup benchmark; it checks its lookups against a plain search, so ctest runs a small one as a test
+add_executable(resource_index_benchmark
+    src/chimera/map_loading/resource_index.cpp
+    src/chimera/map_loading/test/resource_index_benchmark.cpp
+)
+
+add_test(NAME resource_index_benchmark COMMAND resource_index_benchmark 500 2)
+
+# Sound path lookup benchmark; this checks itself the same way
+add_executable(resource_path_index_benchmark
+    src/chimera/map_loading/resource_path_index.cpp
+    src/chimera/map_loading/test/resource_path_index_benchmark.cpp
+)
+
+add_test(NAME resource_path_index_benchmark COMMAND resource_path_index_benchmark 500 300)
+
+if(WIN32)
+    set_target_properties(crc32_test crc32_benchmark resource_index_benchmark resource_path_index_benchmark PROPERTIES LINK_FLAGS "-m32 -static-libgcc -static-libstdc++ -static")
+endif()
@@ -0,0 +1,269 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <zstd.h>
+
+#include "../chimera/map_loading/compression.hpp"
+#include "../chimera/map_loading/crc32.hpp"
+#include "../chimera/map_loading/map_crc32.hpp"
+#include "map_toolkit.hpp"
+
+// The bundled zstd only ships zstd.h, so declare the dictionary builder here (it's part of zstd's stable API)
+extern "C" std::size_t ZDICT_trainFromBuffer(void *dict_buffer, std::size_t dict_buffer_capacity, const void *samples_buffer, const std::size_t *samples_sizes, unsigned sample_count);
+
+namespace Chimera {
+    union AnyMapHeader {
+        MapHeader fv_header;
+        MapHeaderDemo demo_header;
+    };
+
+    static bool is_full_version_header(const AnyMapHeader &header) noexcept {
+        return header.fv_header.head == MapHeader::HEAD_LITERAL && header.fv_header.foot == MapHeader::FOOT_LITERAL;
+    }
+
+    static bool is_demo_header(const AnyMapHeader &header) noexcept {
+        return header.demo_header.head == MapHeaderDemo::HEAD_LITERAL && header.demo_header.foot == MapHeaderDemo::FOOT_LITERAL;
+    }
+
+    MapFileInfo read_map_file_info(const std::filesystem::path &path) {
+        AnyMapHeader header;
+        std::FILE *f = std::fopen(path.string().c_str(), "rb");
+        if(!f) {
+            throw std::exception();
+        }
+        bool header_read = std::fread(&header, sizeof(header), 1, f) == 1;
+        std::fclose(f);
+        if(!header_read) {
+            throw std::exception();
+        }
+
+        MapFileInfo info = {};
+        info.file_size = std::filesystem::file_size(path);
+        info.decompressed_size = info.file_size;
+
+        // Compressed maps always use the full version header layout, even for demo maps
+        if(is_full_version_header(header)) {
+            auto &fv_header = header.fv_header;
+            info.name = std::string(fv_header.name, strnlen(fv_header.name, sizeof(fv_header.name)));
+            info.engine = fv_header.engine_type;
+            info.header_crc32 = fv_header.crc32;
+            switch(fv_header.engine_type) {
+                case CacheFileEngine::CACHE_FILE_RETAIL:
+                case CacheFileEngine::CACHE_FILE_CUSTOM_EDITION:
+                    break;
+                case CacheFileEngine::CACHE_FILE_RETAIL_COMPRESSED:
+                case CacheFileEngine::CACHE_FILE_CUSTOM_EDITION_COMPRESSED:
+                case CacheFileEngine::CACHE_FILE_DEMO_COMPRESSED:
+                    info.compressed = true;
+                    info.decompressed_size = fv_header.file_size;
+                    info.compression_dictionary = fv_header.get_compression_dictionary();
+                    break;
+                default:
+                    throw std::exception();
+            }
+        }
+        else if(is_demo_header(header) && header.demo_header.engine_type == CacheFileEngine::CACHE_FILE_DEMO) {
+            auto &demo_header = header.demo_header;
+            info.name = std::string(demo_header.name, strnlen(demo_header.name, sizeof(demo_header.name)));
+            info.engine = demo_header.engine_type;
+            info.header_crc32 = demo_header.crc32;
+        }
+        else {
+            throw std::exception();
+        }
+
+        return info;
+    }
+
+    std::vector<std::byte> read_map_file(const std::filesystem::path &path, std::size_t threads, std::uint32_t *map_crc32) {
+        auto info = read_map_file_info(path);
+        std::vector<std::byte> map(info.decompressed_size);
+
+        // Compressed maps are checksummed as they're decompressed
+        if(info.compressed) {
+            std::optional<std::uint32_t> crc;
+            std::size_t actual_size = decompress_map_file(path.string().c_str(), map.data(), map.size(), threads, map_crc32 ? &crc : nullptr);
+            if(actual_size != map.size() || (map_crc32 && !crc.has_value())) {
+                throw std::exception();
+            }
+            if(map_crc32) {
+                *map_crc32 = *crc;
+            }
+            return map;
+        }
+
+        std::FILE *f = std::fopen(path.string().c_str(), "rb");
+        if(!f) {
+            throw std::exception();
+        }
+        bool read = std::fread(map.data(), map.size(), 1, f) == 1;
+        std::fclose(f);
+        if(!read) {
+            throw std::exception();
+        }
+
+        if(map_crc32) {
+            *map_crc32 = calculate_map_data_crc32(map.data(), map.size());
+        }
+        return map;
+    }
+
+    /**
+     * Find the tag data of a decompressed map, throwing an exception if it's invalid
+     * @param map             decompressed map
+     * @param size            size of the map
+     * @param tag_data_offset set to the offset of the tag data
+     * @param tag_data_size   set to the size of the tag data
+     * @return                engine of the map
+     */
+    static CacheFileEngine find_tag_data(const std::byte *map, std::size_t size, std::size_t &tag_data_offset, std::size_t &tag_data_size) {
+        AnyMapHeader header;
+        if(size < sizeof(header)) {
+            throw std::exception();
+        }
+        std::memcpy(&header, map, sizeof(header));
+
+        CacheFileEngine engine;
+        if(is_demo_header(header) && header.demo_header.engine_type == CacheFileEngine::CACHE_FILE_DEMO) {
+            engine = header.demo_header.engine_type;
+            tag_data_offset = header.demo_header.tag_data_offset;
+            tag_data_size = header.demo_header.tag_data_size;
+        }
+        else if(is_full_version_header(header)) {
+            engine = header.fv_header.engine_type;
+            tag_data_offset = header.fv_header.tag_data_offset;
+            tag_data_size = header.fv_header.tag_data_size;
+        }
+        else {
+            throw std::exception();
+        }
+
+        if(tag_data_offset > size || tag_data_size > size - tag_data_offset) {
+            throw std::exception();
+        }
+        return engine;
+    }
+
+    std::uint32_t calculate_map_data_crc32(const std::byte *map, std::size_t size) {
+        std::size_t tag_data_offset;
+        std::size_t tag_data_size;
+        auto engine = find_tag_data(map, size, tag_data_offset, tag_data_size);
+
+        auto crc = calculate_map_crc32(map + tag_data_offset, tag_data_size, tag_data_offset, tag_data_address_for_engine(engine), [&map, &size](std::uint32_t &running_crc, std::size_t offset, std::size_t region_size) -> bool {
+            if(offset > size || region_size > size - offset) {
+                return false;
+            }
+            running_crc = crc32(running_crc, map + offset, region_size);
+            return true;
+        });
+        if(!crc.has_value()) {
+            throw std::exception();
+        }
+
+        return ~*crc;
+    }
+
+    MapBenchmark benchmark_map_file(const std::filesystem::path &path, std::size_t threads) {
+        using clock = std::chrono::steady_clock;
+
+        MapBenchmark benchmark = {};
+        benchmark.info = read_map_file_info(path);
+
+        // Checksum separately from reading so the two can be compared
+        auto read_start = clock::now();
+        auto map = read_map_file(path, threads);
+        auto read_end = clock::now();
+        benchmark.crc32 = calculate_map_data_crc32(map.data(), map.size());
+        auto crc32_end = clock::now();
+
+        benchmark.read_seconds = std::chrono::duration<double>(read_end - read_start).count();
+        benchmark.crc32_seconds = std::chrono::duration<double>(crc32_end - read_end).count();
+        return benchmark;
+    }
+
+    std::vector<std::byte> train_map_compression_dictionary(const std::vector<std::filesystem::path> &maps, std::size_t dictionary_size, std::size_t threads) {
+        // Tag data is what maps have the most of in common. Training time grows with the amount of samples, so spread them out if there are a lot of maps.
+        static constexpr std::size_t SAMPLE_SIZE = 16 * 1024;
+        static constexpr std::size_t MAX_SAMPLE_DATA = 128 * 1024 * 1024;
+        if(maps.empty()) {
+            throw std::exception();
+        }
+        std::size_t sample_data_per_map = MAX_SAMPLE_DATA / maps.size();
+
+        std::vector<std::byte> samples;
+        std::vector<std::size_t> sample_sizes;
+        for(auto &path : maps) {
+            auto map = read_map_file(path, threads);
+            std::size_t tag_data_offset;
+            std::size_t tag_data_size;
+            find_tag_data(map.data(), map.size(), tag_data_offset, tag_data_size);
+
+            std::size_t stride = std::max<std::size_t>((tag_data_size / sample_data_per_map) * SAMPLE_SIZE, SAMPLE_SIZE);
+            for(std::size_t offset = 0; offset < tag_data_size; offset += stride) {
+                std::size_t size = std::min(SAMPLE_SIZE, tag_data_size - offset);
+                auto *sample = map.data() + tag_data_offset + offset;
+                samples.insert(samples.end(), sample, sample + size);
+                sample_sizes.push_back(size);
+            }
+        }
+
+        std::vector<std::byte> dictionary(dictionary_size);
+        auto result = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+        if(ZSTD_isError(result)) {
+            throw std::exception();
+        }
+        dictionary.resize(result);
+        return dictionary;
+    }
+
+    MapCompressionBenchmark benchmark_map_compression(const std::filesystem::path &path, std::uint32_t dictionary_id, int compression_level, std::size_t frame_size, std::size_t threads) {
+        using clock = std::chrono::steady_clock;
+
+        MapCompressionBenchmark benchmark = {};
+        benchmark.info = read_map_file_info(path);
+
+        // Everything is done with files in the temp folder since that's how maps are compressed and decompressed
+        auto temp_path = [&path](const char *suffix) {
+            return std::filesystem::temp_directory_path() / ("chimera_map_tool_" + path.stem().string() + suffix);
+        };
+        struct TempFiles {
+            std::vector<std::filesystem::path> paths;
+            ~TempFiles() {
+                std::error_code ec;
+                for(auto &p : this->paths) {
+                    std::filesystem::remove(p, ec);
+                }
+            }
+        } temp_files = { { temp_path(".map"), temp_path("_compressed.map"), temp_path("_dictionary.map") } };
+        auto &decompressed = temp_files.paths[0];
+        auto &compressed = temp_files.paths[1];
+        auto &dictionary_compressed = temp_files.paths[2];
+
+        // Start from the decompressed map
+        auto source = path;
+        if(benchmark.info.compressed) {
+            decompress_map_file(path.string().c_str(), decompressed.string().c_str(), threads);
+            source = decompressed;
+        }
+
+        benchmark.compressed_size = compress_map_file(source.string().c_str(), compressed.string().c_str(), compression_level, frame_size, threads);
+        benchmark.dictionary_compressed_size = compress_map_file(source.string().c_str(), dictionary_compressed.string().c_str(), compression_level, frame_size, threads, dictionary_id);
+
+        auto time_decompression = [&benchmark, &threads](const std::filesystem::path &map) {
+            std::vector<std::byte> output(benchmark.info.decompressed_size);
+            auto start = clock::now();
+            if(decompress_map_file(map.string().c_str(), output.data(), output.size(), threads) != output.size()) {
+                throw std::exception();
+            }
+            return std::chrono::duration<double>(clock::now() - start).count();
+        };
+        benchmark.decompress_seconds = time_decompression(compressed);
+        benchmark.dictionary_decompress_seconds = time_decompression(dictionary_compressed);
+        return benchmark;
+    }
+}
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef CHIMERA_MAP_TOOLKIT_HPP
+#define CHIMERA_MAP_TOOLKIT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../chimera/halo_data/map.hpp"
+
+namespace Chimera {
+    struct MapFileInfo {
+        /** Name of the map in its header */
+        std::string name;
+
+        /** Engine in the header */
+        CacheFileEngine engine;
+
+        /** The map is compressed */
+        bool compressed;
+
+        /** Size of the file */
+        std::size_t file_size;
+
+        /** Size of the map once decompressed */
+        std::size_t decompressed_size;
+
+        /** CRC32 stored in the header (inverted, as stored in the map list) */
+        std::uint32_t header_crc32;
+
+        /** ID of the dictionary the map was compressed with, or 0 if none */
+        std::uint32_t compression_dictionary;
+    };
+
+    /**
+     * Read the map's header, throwing an exception if it isn't a map
+     * @param path path to the map
+     * @return     information about the map
+     */
+    MapFileInfo read_map_file_info(const std::filesystem::path &path);
+
+    /**
+     * Read the map into memory, decompressing it if needed, throwing an exception on failure
+     * @param path      path to the map
+     * @param threads   number of threads to use for multi-frame maps (0 = use all hardware threads)
+     * @param map_crc32 if set, the map's CRC32 (inverted, as stored in the map list) is calculated and stored here
+     * @return          decompressed map
+     */
+    std::vector<std::byte> read_map_file(const std::filesystem::path &path, std::size_t threads = 0, std::uint32_t *map_crc32 = nullptr);
+
+    /**
+     * Calculate the CRC32 of a decompressed map the way Halo does, throwing an exception if it's invalid
+     * @param map  decompressed map
+     * @param size size of the map
+     * @return     CRC32 of the map (inverted, as stored in the map list)
+     */
+    std::uint32_t calculate_map_data_crc32(const std::byte *map, std::size_t size);
+
+    struct MapBenchmark {
+        /** Information about the map */
+        MapFileInfo info;
+
+        /** Time it took to read (and decompress) the map */
+        double read_seconds;
+
+        /** Time it took to checksum the decompressed map */
+        double crc32_seconds;
+
+        /** CRC32 of the map (inverted, as stored in the map list) */
+        std::uint32_t crc32;
+    };
+
+    /**
+     * Time reading, decompressing, and checksumming the map, throwing an exception on failure
+     * @param path    path to the map
+     * @param threads number of threads to use for multi-frame maps (0 = use all hardware threads)
+     * @return        results
+     */
+    MapBenchmark benchmark_map_file(const std::filesystem::path &path, std::size_t threads = 0);
+
+    /** Default maximum size of a trained dictionary */
+    constexpr std::size_t DEFAULT_DICTIONARY_SIZE = 112 * 1024;
+
+    /**
+     * Train a zstd dictionary from the tag data of the maps, throwing an exception on failure
+     * @param maps            maps to train from
+     * @param dictionary_size maximum size of the dictionary
+     * @param threads         number of threads to use for decompressing multi-frame maps (0 = use all hardware threads)
+     * @return                dictionary
+     */
+    std::vector<std::byte> train_map_compression_dictionary(const std::vector<std::filesystem::path> &maps, std::size_t dictionary_size = DEFAULT_DICTIONARY_SIZE, std::size_t threads = 0);
+
+    struct MapCompressionBenchmark {
+        /** Information about the map */
+        MapFileInfo info;
+
+        /** Size of the map compressed without a dictionary */
+        std::size_t compressed_size;
+
+        /** Time it took to decompress the map compressed without a dictionary */
+        double decompress_seconds;
+
+        /** Size of the map compressed with the dictionary */
+        std::size_t dictionary_compressed_size;
+
+        /** Time it took to decompress the map compressed with the dictionary */
+        double dictionary_decompress_seconds;
+    };
+
+    /**
+     * Compress the map with and without a dictionary and time decompressing each, throwing an exception on failure
+     * @param path              path to the map
+     * @param dictionary_id     ID of a loaded dictionary
+     * @param compression_level zstd compression level to use
+     * @param frame_size        amount of decompressed data to store in each frame
+     * @param threads           number of threads to use (0 = use all hardware threads)
+     * @return                  results
+     */
+    MapCompressionBenchmark benchmark_map_compression(const std::filesystem::path &path, std::uint32_t dictionary_id, int compression_level, std::size_t frame_size, std::size_t threads = 0);
+}
+
+#endif